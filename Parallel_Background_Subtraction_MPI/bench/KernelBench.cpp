@@ -0,0 +1,103 @@
+// bench/KernelBench.cpp
+
+#include "KernelBench.h"
+#include "SyntheticVideo.h"
+#include "../mpi_processing/BandExchange.h"
+#include "../../core/FrameKernels.h"
+#include "../../core/MaskStream.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <mpi.h>
+
+namespace Bench {
+
+    // Best-of-N milliseconds of fn(); collective kernels are fenced by barriers
+    // and report the slowest rank
+    static double timeKernel(const std::function<void()>& fn, int iterations, bool collective) {
+        fn();
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < iterations; ++i) {
+            if (collective) MPI_Barrier(MPI_COMM_WORLD);
+            auto t0 = std::chrono::steady_clock::now();
+            fn();
+            double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (collective)
+                MPI_Allreduce(MPI_IN_PLACE, &dt, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            best = std::min(best, dt);
+        }
+        return best * 1e3;
+    }
+
+    std::vector<KernelResult> runKernelBench(int width, int height, int iterations) {
+        // A mid-clip frame and the clean background as the reference
+        SyntheticSpec spec;
+        spec.width = width;
+        spec.height = height;
+        spec.motion = 0.1;
+        SyntheticScene scene(spec);
+        cv::Mat bgr, gray, bg, mask, bits;
+        scene.render(spec.frames / 2, bgr);
+        SyntheticSpec still = spec;
+        still.motion = 0.0;
+        still.noise = 0.0;
+        cv::Mat bgBgr;
+        SyntheticScene(still).render(0, bgBgr);
+        cv::cvtColor(bgBgr, bg, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+
+        cv::Mat acc = cv::Mat::zeros(height, width, CV_32S);
+        cv::Mat sum = cv::Mat::zeros(height, width, CV_64F);
+        const double pixels = static_cast<double>(width) * height;
+
+        std::vector<KernelResult> results;
+        auto add = [&](const std::string& name, const std::function<void()>& fn, bool collective) {
+            double ms = timeKernel(fn, iterations, collective);
+            results.push_back({ name, ms, pixels / (ms * 1e3) });
+        };
+
+        add("cvtColor BGR2GRAY", [&] { cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY); }, false);
+        add("accumulateGrayBGR", [&] { accumulateGrayBGR(bgr, acc); }, false);
+        add("accumulateGray", [&] { accumulateGray(gray, acc); }, false);
+        add("flushAccumulator", [&] { flushAccumulator(acc, sum); }, false);
+        add("slideWindow (enter + leave)", [&] { slideWindow(gray, bg, acc); }, false);
+        cv::Mat windowBg;
+        add("windowMean", [&] { windowMean(acc, 125, windowBg); }, false);
+        add("thresholdDiff", [&] { thresholdDiff(gray, bg, 30.0, mask); }, false);
+        add("thresholdDiffPacked", [&] { thresholdDiffPacked(gray, bg, 30.0, bits); }, false);
+        uint32_t hist[256] = {};
+        add("diffHistogram (any # thresholds)", [&] { diffHistogram(gray, bg, hist); }, false);
+        EncodedMask encoded;
+        add("encodeMask (.msk frame)", [&] { encodeMask(mask, encoded); }, false);
+        add("encodePackedMask (.msk frame)", [&] { encodePackedMask(bits, width, encoded); }, false);
+
+        int initialized = 0;
+        MPI_Initialized(&initialized);
+        if (initialized) {
+            int size = 1;
+            MPI_Comm_size(MPI_COMM_WORLD, &size);
+            cv::Mat padded = cv::Mat::zeros(BandExchange::bandRows(height, size) * size, width, CV_32S);
+            cv::Mat band, reduced(height, width, CV_64F);
+            add("reduce-scatter u32 (" + std::to_string(size) + " ranks)",
+                [&] { BandExchange::reduceScatter(padded, band, MPI_UINT32_T, MPI_COMM_WORLD); }, true);
+            add("MPI_Reduce f64 (" + std::to_string(size) + " ranks)", [&] {
+                MPI_Reduce(sum.ptr<double>(), reduced.ptr<double>(), height * width,
+                           MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+            }, true);
+        }
+        return results;
+    }
+
+    void printKernelResults(const std::vector<KernelResult>& results, std::ostream& out) {
+        out << std::left << std::setw(34) << "kernel" << std::right
+            << std::setw(12) << "ms/frame" << std::setw(12) << "Mpix/s" << "\n";
+        for (const auto& r : results)
+            out << std::left << std::setw(34) << r.name << std::right << std::fixed
+                << std::setprecision(3) << std::setw(12) << r.msPerFrame
+                << std::setprecision(1) << std::setw(12) << r.mpixPerSecond << "\n";
+        out << "Kernel ISA: " << kernelIsa() << "\n";
+    }
+
+} // namespace Bench
@@ -0,0 +1,30 @@
+// bench/KernelBench.h
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    // Timing of one kernel over one frame
+    struct KernelResult {
+        std::string name;
+        double msPerFrame;      // best of the timed iterations
+        double mpixPerSecond;   // frame pixels / msPerFrame
+    };
+
+    /**
+     * Times the per-frame kernels on a synthetic width x height frame:
+     * gray conversion, fused gray+accumulate, accumulator flush,
+     * absdiff/threshold (byte and bit-packed) and, when MPI is initialized,
+     * the uint32 reduce-scatter and the double MPI_Reduce across all ranks.
+     * Every kernel runs once untimed, then `iterations` timed times.
+     */
+    std::vector<KernelResult> runKernelBench(int width, int height, int iterations);
+
+    // Fixed-width table, one kernel per line
+    void printKernelResults(const std::vector<KernelResult>& results, std::ostream& out);
+
+} // namespace Bench
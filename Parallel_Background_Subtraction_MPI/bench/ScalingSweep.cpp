@@ -0,0 +1,177 @@
+// bench/ScalingSweep.cpp
+
+#include "ScalingSweep.h"
+#include "../../core/VideoProcessor.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace Bench {
+
+    // File stem of the outputs of one configuration
+    static std::string runTag(const RunConfig& c) {
+        return "bench_" + c.backend + "_" + std::to_string(c.ranks) + "x" + std::to_string(c.threads);
+    }
+
+    static std::string readFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<RunConfig> sweepConfigs(const SweepOptions& opts) {
+        std::vector<RunConfig> configs{ { "seq", 1, 1 } };
+        for (int t : opts.threads)
+            if (t > 1) configs.push_back({ "omp", 1, t });
+        for (int r : opts.ranks)
+            if (r > 1) configs.push_back({ "mpi", r, 1 });
+        for (int r : opts.ranks)
+            for (int t : opts.threads)
+                if (r > 1 && t > 1) configs.push_back({ "hybrid", r, t });
+        return configs;
+    }
+
+    // Runs a program with the given arguments (no shell, so paths are passed
+    // verbatim) and collects its stdout and stderr into log. Returns the raw
+    // wait status, or -1 if the program could not be started.
+    static int runCaptured(const std::vector<std::string>& args, std::string& log) {
+        std::vector<char*> argv;
+        for (const auto& a : args)
+            argv.push_back(const_cast<char*>(a.c_str()));
+        argv.push_back(nullptr);
+
+        int fds[2];
+        if (pipe(fds) != 0)
+            return -1;
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addclose(&actions, fds[0]);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+        posix_spawn_file_actions_addclose(&actions, fds[1]);
+        pid_t pid;
+        int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+        if (rc != 0) {
+            close(fds[0]);
+            return -1;
+        }
+
+        char buf[512];
+        for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) != 0;) {
+            if (n > 0)
+                log.append(buf, static_cast<size_t>(n));
+            else if (errno != EINTR)
+                break;
+        }
+        close(fds[0]);
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0)
+            if (errno != EINTR)
+                return -1;
+        return status;
+    }
+
+    // Runs one bg_subtract invocation and returns its reported total run time
+    static double runOnce(const std::string& video, const RunConfig& c, const SweepOptions& opts) {
+        const std::string tag = runTag(c);
+        std::vector<std::string> args;
+        if (c.backend == "mpi" || c.backend == "hybrid")
+            args.insert(args.end(), { opts.launcher, "-n", std::to_string(c.ranks) });
+        args.insert(args.end(), { opts.binary, video, tag + "_bg.png", tag + "_fg.mp4",
+                                  "--backend", c.backend, "--motion-csv", "output/" + tag + ".csv" });
+        if (c.backend == "omp" || c.backend == "hybrid")
+            args.insert(args.end(), { "--threads", std::to_string(c.threads) });
+        args.insert(args.end(), opts.extraArgs.begin(), opts.extraArgs.end());
+
+        std::string log;
+        int status = runCaptured(args, log);
+
+        const std::string marker = "Total run time: ";
+        size_t at = log.rfind(marker);
+        if (status != 0 || at == std::string::npos) {
+            std::ostringstream cmd;
+            for (const auto& a : args)
+                cmd << (cmd.tellp() > 0 ? " " : "") << a;
+            throw std::runtime_error("Benchmark run failed: " + cmd.str() + "\n" + log);
+        }
+        return std::stod(log.substr(at + marker.size()));
+    }
+
+    std::vector<RunResult> runSweep(const std::string& video, const SweepOptions& opts) {
+        const VideoMeta meta = readVideoMeta(video);
+        if (meta.totalFrames <= 0)
+            throw std::runtime_error("Benchmark video has no frames: " + video);
+        std::filesystem::create_directories("output");
+
+        std::vector<RunResult> results;
+        std::string refBg, refCsv;
+        double baseline = 0.0;
+        for (const RunConfig& c : sweepConfigs(opts)) {
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < std::max(opts.repeats, 1); ++i)
+                best = std::min(best, runOnce(video, c, opts));
+
+            // Mask videos are lossy and encoded per segment, so masks are
+            // compared through their exact per-frame foreground counts
+            const std::string tag = runTag(c);
+            std::string bg = readFile("output/" + tag + "_bg.png");
+            std::string csv = readFile("output/" + tag + ".csv");
+            if (results.empty()) {
+                baseline = best;
+                refBg = bg;
+                refCsv = csv;
+            }
+
+            RunResult r;
+            r.config = c;
+            r.seconds = best;
+            r.fps = meta.totalFrames / best;
+            r.speedup = baseline / best;
+            r.efficiency = r.speedup / (c.ranks * c.threads);
+            r.identical = !bg.empty() && bg == refBg && csv == refCsv;
+            results.push_back(r);
+        }
+        return results;
+    }
+
+    void printSweep(const std::vector<RunResult>& results, std::ostream& out) {
+        out << std::left << std::setw(8) << "backend" << std::right
+            << std::setw(7) << "ranks" << std::setw(9) << "threads" << std::setw(11) << "seconds"
+            << std::setw(10) << "fps" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+            << "  output\n";
+        for (const auto& r : results)
+            out << std::left << std::setw(8) << r.config.backend << std::right
+                << std::setw(7) << r.config.ranks << std::setw(9) << r.config.threads << std::fixed
+                << std::setprecision(3) << std::setw(11) << r.seconds
+                << std::setprecision(1) << std::setw(10) << r.fps
+                << std::setprecision(2) << std::setw(10) << r.speedup << std::setw(12) << r.efficiency
+                << "  " << (r.identical ? "identical" : "MISMATCH") << "\n";
+    }
+
+    void appendSweepCsv(const std::vector<RunResult>& results, const std::string& video,
+                        const std::string& csvPath) {
+        bool fresh = !std::filesystem::exists(csvPath);
+        std::ofstream csv(csvPath, std::ios::app);
+        if (!csv)
+            throw std::runtime_error("Cannot write benchmark results: " + csvPath);
+        if (fresh)
+            csv << "video,backend,ranks,threads,seconds,fps,speedup,efficiency,identical\n";
+        for (const auto& r : results)
+            csv << video << "," << r.config.backend << "," << r.config.ranks << ","
+                << r.config.threads << "," << r.seconds << "," << r.fps << "," << r.speedup << ","
+                << r.efficiency << "," << (r.identical ? 1 : 0) << "\n";
+    }
+
+} // namespace Bench
@@ -0,0 +1,65 @@
+// bench/ScalingSweep.h
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    // One point of the sweep: a bg_subtract backend at R ranks x T threads
+    struct RunConfig {
+        std::string backend;   // seq, omp, mpi or hybrid
+        int ranks;
+        int threads;
+    };
+
+    // Measured point; speedup and efficiency are relative to the seq run
+    struct RunResult {
+        RunConfig config;
+        double seconds;        // best "Total run time" over the repeats
+        double fps;
+        double speedup;
+        double efficiency;     // speedup / (ranks * threads)
+        bool identical;        // background and per-frame mask counts match seq
+    };
+
+    /**
+     * Sweep settings.
+     *
+     * binary     bg_subtract to run
+     * launcher   MPI launcher program, invoked as "<launcher> -n R" for mpi/hybrid
+     * ranks      rank counts for mpi and hybrid (values <= 1 are skipped)
+     * threads    team sizes for omp and hybrid (values <= 1 are skipped)
+     * repeats    runs per point; the fastest is kept
+     * extraArgs  arguments appended to every bg_subtract run (passed as is, no shell)
+     */
+    struct SweepOptions {
+        std::string binary = "./bg_subtract";
+        std::string launcher = "mpirun";
+        std::vector<int> ranks{ 2, 4 };
+        std::vector<int> threads{ 2, 4 };
+        int repeats = 1;
+        std::vector<std::string> extraArgs;
+    };
+
+    // seq first (the baseline), then omp x threads, mpi x ranks, hybrid x both
+    std::vector<RunConfig> sweepConfigs(const SweepOptions& opts);
+
+    /**
+     * Runs every configuration on `video`. Outputs go to
+     * output/bench_<backend>_<R>x<T>_*; the background image and the motion
+     * CSV of each run are compared byte for byte with the seq run. Throws
+     * std::runtime_error if a run fails or prints no run time.
+     */
+    std::vector<RunResult> runSweep(const std::string& video, const SweepOptions& opts);
+
+    // Fixed-width table of the results
+    void printSweep(const std::vector<RunResult>& results, std::ostream& out);
+
+    // Appends the results as CSV rows (header written when the file is new)
+    void appendSweepCsv(const std::vector<RunResult>& results, const std::string& video,
+                        const std::string& csvPath);
+
+} // namespace Bench
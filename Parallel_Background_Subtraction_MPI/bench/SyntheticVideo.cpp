@@ -0,0 +1,132 @@
+// bench/SyntheticVideo.cpp
+
+#include "SyntheticVideo.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace Bench {
+
+    // Number of moving squares sharing the motion budget
+    static constexpr int MOVER_COUNT = 8;
+
+    void parseSize(const std::string& text, int& width, int& height) {
+        size_t x = text.find('x');
+        if (x == std::string::npos)
+            throw std::invalid_argument("Size must be WxH, got " + text);
+        width = std::stoi(text.substr(0, x));
+        height = std::stoi(text.substr(x + 1));
+        if (width <= 0 || height <= 0)
+            throw std::invalid_argument("Size must be positive, got " + text);
+    }
+
+    std::string syntheticName(const SyntheticSpec& spec) {
+        return "synthetic_" + std::to_string(spec.width) + "x" + std::to_string(spec.height) + "_" +
+               std::to_string(spec.frames) + "f_m" +
+               std::to_string(static_cast<int>(std::lround(spec.motion * 100.0))) + ".mp4";
+    }
+
+    // Position on [0, span] of a point bouncing between the two ends
+    static double bounce(double x, double span) {
+        if (span <= 0.0) return 0.0;
+        double p = std::fmod(std::fabs(x), 2.0 * span);
+        return p > span ? 2.0 * span - p : p;
+    }
+
+    SyntheticScene::SyntheticScene(const SyntheticSpec& spec) : spec_(spec) {
+        if (spec.width <= 0 || spec.height <= 0 || spec.frames <= 0 || spec.fps <= 0.0)
+            throw std::invalid_argument("Synthetic clip needs a positive size, length and frame rate");
+        if (spec.motion < 0.0 || spec.motion > 1.0)
+            throw std::invalid_argument("Motion must be within [0, 1]");
+
+        // Diagonal gradient plus a smoothed fixed texture, so the background
+        // has structure for the codec and the threshold to work against
+        cv::RNG rng(spec.seed);
+        background_.create(spec.height, spec.width, CV_8UC3);
+        for (int y = 0; y < spec.height; ++y) {
+            cv::Vec3b* row = background_.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < spec.width; ++x) {
+                int g = 60 + 120 * (x + y) / (spec.width + spec.height);
+                row[x] = cv::Vec3b(static_cast<uchar>(g), static_cast<uchar>(g + 20), static_cast<uchar>(g + 10));
+            }
+        }
+        cv::Mat texture(spec.height, spec.width, CV_8UC3);
+        rng.fill(texture, cv::RNG::UNIFORM, 0, 40);
+        cv::GaussianBlur(texture, texture, cv::Size(5, 5), 0);
+        cv::add(background_, texture, background_);
+
+        if (spec.motion <= 0.0) return;
+        double area = spec.motion * spec.width * spec.height / MOVER_COUNT;
+        side_ = std::max(1, std::min({ static_cast<int>(std::sqrt(area)), spec.width, spec.height }));
+        for (int i = 0; i < MOVER_COUNT; ++i) {
+            Mover m;
+            m.start = cv::Point2d(rng.uniform(0.0, 1.0) * (spec.width - side_),
+                                  rng.uniform(0.0, 1.0) * (spec.height - side_));
+            double speed = rng.uniform(1.0, 6.0);
+            double angle = rng.uniform(0.0, 2.0 * CV_PI);
+            m.velocity = cv::Point2d(speed * std::cos(angle), speed * std::sin(angle));
+            m.color = cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+            movers_.push_back(m);
+        }
+    }
+
+    void SyntheticScene::render(int index, cv::Mat& frame) const {
+        background_.copyTo(frame);
+        for (const Mover& m : movers_) {
+            int x = static_cast<int>(bounce(m.start.x + m.velocity.x * index, spec_.width - side_));
+            int y = static_cast<int>(bounce(m.start.y + m.velocity.y * index, spec_.height - side_));
+            cv::rectangle(frame, cv::Rect(x, y, side_, side_), m.color, cv::FILLED);
+        }
+        if (spec_.noise > 0.0) {
+            // Per-frame seed keeps random access deterministic
+            cv::RNG rng(spec_.seed * 2654435761u + static_cast<unsigned>(index));
+            cv::Mat noise(frame.size(), CV_16SC3);
+            rng.fill(noise, cv::RNG::NORMAL, 0, spec_.noise);
+            cv::Mat wide;
+            frame.convertTo(wide, CV_16SC3);
+            wide += noise;
+            wide.convertTo(frame, CV_8UC3);
+        }
+    }
+
+    void writeSyntheticVideo(const SyntheticSpec& spec, const std::string& path) {
+        SyntheticScene scene(spec);
+        cv::VideoWriter writer(path, cv::VideoWriter::fourcc('m', 'p', '4', 'v'),
+                               spec.fps, cv::Size(spec.width, spec.height), true);
+        if (!writer.isOpened())
+            throw std::runtime_error("Cannot open synthetic video for writing: " + path);
+        cv::Mat frame;
+        for (int i = 0; i < spec.frames; ++i) {
+            scene.render(i, frame);
+            writer.write(frame);
+        }
+    }
+
+    long writeSyntheticY4M(const SyntheticSpec& spec, std::FILE* out, bool realtime) {
+        if (spec.width % 2 != 0 || spec.height % 2 != 0)
+            throw std::invalid_argument("Y4M output needs an even frame size");
+        // F as a ratio with three decimals (29.97 → 29970:1000)
+        std::fprintf(out, "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 C420jpeg\n", spec.width, spec.height,
+                     std::lround(spec.fps * 1000.0));
+        SyntheticScene scene(spec);
+        cv::Mat frame, yuv;
+        const auto start = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> period(1.0 / spec.fps);
+        long i = 0;
+        for (; spec.frames == 0 || i < spec.frames; ++i) {
+            scene.render(static_cast<int>(i), frame);
+            cv::cvtColor(frame, yuv, cv::COLOR_BGR2YUV_I420);
+            if (realtime)
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * i));
+            if (std::fputs("FRAME\n", out) < 0 || std::fwrite(yuv.data, 1, yuv.total(), out) != yuv.total())
+                break;   // reader went away
+            if (realtime)
+                std::fflush(out);
+        }
+        std::fflush(out);
+        return i;
+    }
+
+} // namespace Bench
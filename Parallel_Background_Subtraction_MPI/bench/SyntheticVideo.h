@@ -0,0 +1,71 @@
+// bench/SyntheticVideo.h
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace Bench {
+
+    /**
+     * Description of a generated benchmark clip. The same spec (seed
+     * included) always renders the same frames, so timings taken on
+     * different machines or days refer to the same input.
+     *
+     * motion   fraction of the frame covered by moving objects (0 = static scene)
+     * noise    standard deviation of per-pixel sensor noise, in gray levels
+     */
+    struct SyntheticSpec {
+        int width = 1280;
+        int height = 720;
+        int frames = 300;
+        double fps = 30.0;
+        double motion = 0.05;
+        double noise = 2.0;
+        unsigned seed = 1;
+    };
+
+    // Parses "WxH" (e.g. 1920x1080)
+    void parseSize(const std::string& text, int& width, int& height);
+
+    // Canonical file name, e.g. synthetic_1280x720_300f_m5.mp4 (m = motion in percent)
+    std::string syntheticName(const SyntheticSpec& spec);
+
+    /**
+     * Renders frames of a static textured background with bouncing
+     * rectangles on top and Gaussian noise. Object paths are closed-form,
+     * so any frame can be rendered without rendering the ones before it.
+     */
+    class SyntheticScene {
+    public:
+        explicit SyntheticScene(const SyntheticSpec& spec);
+
+        // Frame `index` as CV_8UC3
+        void render(int index, cv::Mat& frame) const;
+
+    private:
+        struct Mover {
+            cv::Point2d start, velocity;   // pixels, pixels per frame
+            cv::Scalar color;
+        };
+
+        SyntheticSpec spec_;
+        cv::Mat background_;
+        std::vector<Mover> movers_;
+        int side_ = 0;                    // edge length of every moving square
+    };
+
+    // Writes the whole clip with the mp4v codec; throws std::runtime_error on I/O failure
+    void writeSyntheticVideo(const SyntheticSpec& spec, const std::string& path);
+
+    /**
+     * Writes the clip as a YUV4MPEG2 (C420jpeg) stream, e.g. to stdout for
+     * bg_subtract's stream input. frames = 0 writes until the reader closes
+     * the pipe; with realtime, frames are paced at spec.fps. Width and
+     * height must be even. Returns the number of frames written.
+     */
+    long writeSyntheticY4M(const SyntheticSpec& spec, std::FILE* out, bool realtime);
+
+} // namespace Bench
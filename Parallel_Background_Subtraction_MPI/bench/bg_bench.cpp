@@ -0,0 +1,251 @@
+// bench/bg_bench.cpp
+//
+// Reproducible benchmarks for bg_subtract: synthetic input clips, kernel
+// micro-benchmarks and backend scaling sweeps with output checks.
+
+#include <iostream>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "SyntheticVideo.h"
+#include "KernelBench.h"
+#include "ScalingSweep.h"
+
+// Print command-line help
+static void printUsage() {
+    std::cerr << "Usage: ./bg_bench <command> [options]\n"
+              << "Commands:\n"
+              << "  generate [out.mp4]     write one synthetic clip (default name under input/synthetic/)\n"
+              << "    --size WxH           frame size (default 1280x720)\n"
+              << "    --frames N           clip length (default 300)\n"
+              << "    --fps F              frame rate (default 30)\n"
+              << "    --motion M           fraction of the frame in motion, 0..1 (default 0.05)\n"
+              << "    --noise S            sensor noise std-dev in gray levels (default 2)\n"
+              << "    --seed S             random seed (default 1)\n"
+              << "  stream                 write a synthetic Y4M stream to stdout, e.g.\n"
+              << "                         ./bg_bench stream --frames 0 --realtime | ./bg_subtract - bg.png fg.msk --single-pass\n"
+              << "    --frames N           stream length, 0 = until the reader closes the pipe (default 300)\n"
+              << "    --realtime           pace frames at --fps instead of writing as fast as possible\n"
+              << "    (and --size, --fps, --motion, --noise, --seed as for generate)\n"
+              << "  kernels                time the per-frame kernels (and the reduce, under mpirun -n P)\n"
+              << "    --size WxH           frame size (default 1920x1080)\n"
+              << "    --iters N            timed iterations, best one kept (default 50)\n"
+              << "  sweep <video.mp4>      run every backend and report fps, speedup, efficiency\n"
+              << "    --bin PATH           bg_subtract binary (default ./bg_subtract)\n"
+              << "    --launcher CMD       MPI launcher (default mpirun)\n"
+              << "    --ranks r1,r2,...    rank counts for mpi/hybrid (default 2,4)\n"
+              << "    --threads t1,t2,...  thread counts for omp/hybrid (default 2,4)\n"
+              << "    --repeat N           runs per point, fastest kept (default 1)\n"
+              << "    --csv FILE           append results as CSV\n"
+              << "    -- ARGS...           pass the remaining arguments to bg_subtract\n"
+              << "  suite [--quick]        generate the standard clips, time the kernels and sweep\n"
+              << "                         each clip; results in output/bench_suite.csv\n";
+}
+
+static std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream list(text);
+    for (std::string v; std::getline(list, v, ',');)
+        values.push_back(std::stoi(v));
+    return values;
+}
+
+// Runs a command over argv[2..]; `value` fetches the argument following a flag
+struct ArgCursor {
+    int argc;
+    char** argv;
+    int i = 2;
+
+    bool more() const { return i < argc; }
+    std::string next() { return argv[i++]; }
+    std::string value(const std::string& flag) {
+        if (i >= argc) throw std::invalid_argument("Missing value for " + flag);
+        return argv[i++];
+    }
+};
+
+static int runGenerate(ArgCursor args) {
+    Bench::SyntheticSpec spec;
+    std::string out;
+    while (args.more()) {
+        std::string flag = args.next();
+        if      (flag == "--size")   Bench::parseSize(args.value(flag), spec.width, spec.height);
+        else if (flag == "--frames") spec.frames = std::stoi(args.value(flag));
+        else if (flag == "--fps")    spec.fps = std::stod(args.value(flag));
+        else if (flag == "--motion") spec.motion = std::stod(args.value(flag));
+        else if (flag == "--noise")  spec.noise = std::stod(args.value(flag));
+        else if (flag == "--seed")   spec.seed = static_cast<unsigned>(std::stoul(args.value(flag)));
+        else if (out.empty() && flag.rfind("--", 0) != 0) out = flag;
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+    if (out.empty()) {
+        std::filesystem::create_directories("input/synthetic");
+        out = "input/synthetic/" + Bench::syntheticName(spec);
+    }
+    Bench::writeSyntheticVideo(spec, out);
+    std::cout << "Wrote " << out << " (" << spec.width << "x" << spec.height << ", "
+              << spec.frames << " frames)\n";
+    return 0;
+}
+
+// Synthetic Y4M on stdout, for the stream input of bg_subtract
+static int runStream(ArgCursor args) {
+    Bench::SyntheticSpec spec;
+    bool realtime = false;
+    while (args.more()) {
+        std::string flag = args.next();
+        if      (flag == "--size")     Bench::parseSize(args.value(flag), spec.width, spec.height);
+        else if (flag == "--frames")   spec.frames = std::stoi(args.value(flag));
+        else if (flag == "--fps")      spec.fps = std::stod(args.value(flag));
+        else if (flag == "--motion")   spec.motion = std::stod(args.value(flag));
+        else if (flag == "--noise")    spec.noise = std::stod(args.value(flag));
+        else if (flag == "--seed")     spec.seed = static_cast<unsigned>(std::stoul(args.value(flag)));
+        else if (flag == "--realtime") realtime = true;
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    // stdout carries the frames; report on stderr
+    long frames = Bench::writeSyntheticY4M(spec, stdout, realtime);
+    std::cerr << "Streamed " << frames << " frames (" << spec.width << "x" << spec.height << ")\n";
+    return 0;
+}
+
+static int runKernels(ArgCursor args) {
+    int width = 1920, height = 1080, iters = 50;
+    while (args.more()) {
+        std::string flag = args.next();
+        if      (flag == "--size")  Bench::parseSize(args.value(flag), width, height);
+        else if (flag == "--iters") iters = std::stoi(args.value(flag));
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+
+    // Only this command joins MPI; the others launch mpirun themselves
+    MPI_Init(nullptr, nullptr);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int rc = 0;
+    try {
+        auto results = Bench::runKernelBench(width, height, iters);
+        if (rank == 0) {
+            std::cout << "Kernels at " << width << "x" << height << ", best of " << iters << ":\n";
+            Bench::printKernelResults(results, std::cout);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        rc = 1;
+    }
+    MPI_Finalize();
+    return rc;
+}
+
+static int runSweepCommand(ArgCursor args) {
+    Bench::SweepOptions opts;
+    std::string video, csvPath;
+    while (args.more()) {
+        std::string flag = args.next();
+        if      (flag == "--bin")      opts.binary = args.value(flag);
+        else if (flag == "--launcher") opts.launcher = args.value(flag);
+        else if (flag == "--ranks")    opts.ranks = parseList(args.value(flag));
+        else if (flag == "--threads")  opts.threads = parseList(args.value(flag));
+        else if (flag == "--repeat")   opts.repeats = std::stoi(args.value(flag));
+        else if (flag == "--csv")      csvPath = args.value(flag);
+        else if (flag == "--") {
+            while (args.more()) opts.extraArgs.push_back(args.next());
+        }
+        else if (video.empty() && flag.rfind("--", 0) != 0) video = flag;
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+    if (video.empty())
+        throw std::invalid_argument("sweep needs an input video");
+
+    auto results = Bench::runSweep(video, opts);
+    std::cout << video << ":\n";
+    Bench::printSweep(results, std::cout);
+    if (!csvPath.empty())
+        Bench::appendSweepCsv(results, video, csvPath);
+    for (const auto& r : results)
+        if (!r.identical) return 2;
+    return 0;
+}
+
+// Standard clips: three resolutions at low and high motion (one small clip with --quick)
+static int runSuite(ArgCursor args) {
+    bool quick = false;
+    while (args.more()) {
+        std::string flag = args.next();
+        if (flag == "--quick") quick = true;
+        else throw std::invalid_argument("Unknown option: " + flag);
+    }
+
+    std::vector<Bench::SyntheticSpec> specs;
+    const std::vector<std::pair<int, int>> sizes = quick
+        ? std::vector<std::pair<int, int>>{ { 640, 360 } }
+        : std::vector<std::pair<int, int>>{ { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+    for (auto [w, h] : sizes) {
+        for (double motion : { 0.02, 0.20 }) {
+            Bench::SyntheticSpec spec;
+            spec.width = w;
+            spec.height = h;
+            spec.frames = quick ? 60 : 300;
+            spec.motion = motion;
+            specs.push_back(spec);
+        }
+    }
+
+    std::filesystem::create_directories("input/synthetic");
+    std::filesystem::create_directories("output");
+    const std::string csvPath = "output/bench_suite.csv";
+    std::filesystem::remove(csvPath);
+
+    // Single-process kernel timings; reduce rows need `mpirun -n P ./bg_bench kernels`
+    auto kernels = Bench::runKernelBench(sizes.back().first, sizes.back().second, quick ? 10 : 50);
+    std::cout << "Kernels at " << sizes.back().first << "x" << sizes.back().second << ":\n";
+    Bench::printKernelResults(kernels, std::cout);
+
+    int rc = 0;
+    Bench::SweepOptions opts;
+    for (const auto& spec : specs) {
+        std::string path = "input/synthetic/" + Bench::syntheticName(spec);
+        if (!std::filesystem::exists(path))
+            Bench::writeSyntheticVideo(spec, path);
+        auto results = Bench::runSweep(path, opts);
+        std::cout << "\n" << path << ":\n";
+        Bench::printSweep(results, std::cout);
+        Bench::appendSweepCsv(results, path, csvPath);
+        for (const auto& r : results)
+            if (!r.identical) rc = 2;
+    }
+    std::cout << "\nResults appended to " << csvPath << "\n";
+    return rc;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    const std::string command = argv[1];
+    ArgCursor args{ argc, argv };
+    try {
+        if (command == "generate") return runGenerate(args);
+        if (command == "stream")   return runStream(args);
+        if (command == "kernels")  return runKernels(args);
+        if (command == "sweep")    return runSweepCommand(args);
+        if (command == "suite")    return runSuite(args);
+        std::cerr << "Unknown command: " << command << "\n";
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    printUsage();
+    return 1;
+}
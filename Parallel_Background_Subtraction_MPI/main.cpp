@@ -1,14 +1,433 @@
 #include <iostream>                          // for std::cout, std::cerr
 #include <string>                            // for std::string
+#include <sstream>                           // for splitting list arguments
+#include <stdexcept>                         // for std::invalid_argument
+#include <filesystem>                        // for creating output/
 #include <mpi.h>                             // MPI functions
 #include "mpi_processing/MPIProcessor.h"     // our MPI orchestration module
+#include "mpi_processing/BatchScheduler.h"   // many videos, work handed out on demand
+#include "../core/LocalBackend.h"            // sequential and OpenMP backends
+#include "../core/AccumulatorCheckpoint.h"    // --merge-checkpoints
 
 // Default threshold for foreground detection
 static constexpr double DEFAULT_THRESHOLD = 30.0;
 
+// Execution backend for the shared core pipeline
+enum class Backend {
+    Auto,         // omp for one process, hybrid with --threads/--layout, else mpi
+    Sequential,   // this process, one thread
+    OpenMP,       // this process, one OpenMP team
+    MPI,          // all ranks, one thread each
+    Hybrid        // all ranks, an OpenMP team inside each
+};
+
+// Everything the command line selects
+struct CliOptions {
+    Backend backend = Backend::Auto;
+    double threshold = DEFAULT_THRESHOLD;
+    MPIProcessor::Options run;
+    int chunkFrames = BatchScheduler::DEFAULT_CHUNK_FRAMES;   // --batch only
+    std::string maskExtension = ".mp4";                       // --batch only
+    StreamSpec stream;                                        // seq/omp only
+};
+
+static const char* backendName(Backend b) {
+    switch (b) {
+    case Backend::Sequential: return "seq";
+    case Backend::OpenMP:     return "omp";
+    case Backend::MPI:        return "mpi";
+    case Backend::Hybrid:     return "hybrid";
+    default:                  return "auto";
+    }
+}
+
+// Print command-line help (rank 0 only)
+static void printUsage() {
+    std::cerr << "Usage: [mpirun -n <P>] ./bg_subtract"
+              << " <input.mp4> <out_bg.png> <out_fg.mp4> [options]\n"
+              << "       [mpirun -n <P>] ./bg_subtract --batch <input_dir> [options]\n"
+              << "       ./bg_subtract --merge-checkpoints <out.ckpt> <in.ckpt>...\n"
+              << "Outputs are written to output/ (batch: output/<name>_bg.png, output/<name>_fg.mp4).\n"
+              << "An input of - (stdin) or a FIFO is read as a Y4M frame stream until it ends.\n"
+              << "A foreground output ending in .msk is written as a lossless mask stream.\n"
+              << "Options:\n"
+              << "  --backend B            seq, omp, mpi or hybrid (default: omp for one process,\n"
+              << "                         hybrid with --threads/--layout, mpi otherwise)\n"
+              << "  --threshold T          foreground threshold (default " << DEFAULT_THRESHOLD << ")\n"
+              << "  --partition block|rr   contiguous blocks (default) or round-robin frames\n"
+              << "  --gop N|auto           align blocks to multiples of N or to probed keyframes\n"
+              << "  --weights w0,w1,...    relative per-rank speed, one weight per rank\n"
+              << "  --decode-report        print per-rank decode counts\n"
+              << "  --stitch concat|merge  join foreground segments by stream copy (default) or re-encode\n"
+              << "  --single-pass          one decode pass against a running background (block partition)\n"
+              << "  --alpha A              single-pass learning rate in [0, 1], 0 = running mean (default)\n"
+              << "  --warmup N             single-pass frames per rank used to seed the background\n"
+              << "  --motion-csv FILE      write per-frame foreground pixel counts\n"
+              << "  --reduce scatter|root  band-wise reduce-scatter (default) or reduce to rank 0\n"
+              << "  --wire u32|f64         element type of the reduced sums (default u32)\n"
+              << "  --model M              background model: mean (default), median or mog (ignores the threshold)\n"
+              << "  --percentile P         percentile background, 0..100 (median = 50)\n"
+              << "  --engine hist|approx   exact two-pass histograms (default) or one-pass estimate\n"
+              << "  --mog-k K              Gaussians per pixel for --model mog (1..5, default 3)\n"
+              << "  --mog-rate A           mixture learning rate (default 0.005)\n"
+              << "  --threads T            OpenMP threads per rank (default OMP_NUM_THREADS)\n"
+              << "  --layout RxT           expect R ranks with T threads each, e.g. 2x16\n"
+              << "  --profile FILE         write per-rank, per-thread stage timers and counters as JSON\n"
+              << "  --trace FILE           write a Chrome trace (chrome://tracing, Perfetto) of every stage\n"
+              << "  --luma-cache FILE      mean model: keep decoded luma in FILE and reuse it on reruns\n"
+              << "  --decode bgr|luma      decode to BGR (default) or take luma straight from the decoder\n"
+              << "  --checkpoint FILE      mean model: resume the frame sums from FILE and keep it updated\n"
+              << "  --checkpoint-every N   frames (per rank) folded in between checkpoint saves (default "
+              << DEFAULT_CHECKPOINT_FRAMES << ")\n"
+              << "  --sweep T1,T2,...      evaluate every threshold in one foreground decode; per-frame\n"
+              << "                         counts go to output/<fg name>_sweep.csv\n"
+              << "  --sweep-models M,...   sweep backgrounds: mean, median, pNN (default: --model)\n"
+              << "  --sweep-masks          also write output/<fg name>_<model>_t<T>.<ext> for every pair\n"
+              << "  --window W             compare each frame with the mean of the W frames around it;\n"
+              << "                         frames are decoded once while W+1 gray frames fit in "
+              << static_cast<int>(WINDOW_RING_BYTES / (1024 * 1024)) << " MiB,\n"
+              << "                         three times (current, leading, trailing) above that\n"
+              << "  --segment N            compare each frame with the mean of its run of N frames\n"
+              << "  --roi x,y,w,h          process only this rectangle (repeatable)\n"
+              << "  --roi-mask FILE        process only the non-zero pixels of this image\n"
+              << "  --downscale N          work at 1/N resolution, refining motion tiles at full resolution\n"
+              << "  --sample N|keyframes|adaptive  mean model: build the background from every N-th frame,\n"
+              << "                         the keyframes, or adaptively (rounds until it converges)\n"
+              << "  --sample-tol T         stop sampling once a round moves the mean by < T gray levels\n"
+              << "                         per pixel on average (adaptive default " << DEFAULT_SAMPLE_TOLERANCE << ")\n"
+              << "  --stream y4m|gray|bgr  read the input as a frame stream (seq/omp, --single-pass or mog)\n"
+              << "  --stream-size WxH      frame size of gray/bgr streams\n"
+              << "  --stream-fps F         frame rate of gray/bgr streams (default 25)\n"
+              << "  --queue N              stream frames buffered ahead of processing (default 8)\n"
+              << "  --drop block|oldest|newest  full queue: stall the reader (default) or drop a frame\n"
+              << "  --batch-chunk N        batch work item size in frames (default "
+              << BatchScheduler::DEFAULT_CHUNK_FRAMES << "); longer mean-model\n"
+              << "                         videos are split, shorter ones packed together\n"
+              << "  --batch-masks mp4|msk  batch foreground outputs as mp4v videos (default) or mask streams\n";
+}
+
+// Parse the optional flags that follow the positional arguments (from argv[first])
+static CliOptions parseOptions(int argc, char* argv[], int first, int size) {
+    CliOptions cli;
+    MPIProcessor::Options& opts = cli.run;
+    std::string layout;
+    bool sampleGiven = false;
+    for (int i = first; i < argc; ++i) {
+        std::string flag = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+            return argv[++i];
+        };
+        if (flag == "--backend") {
+            std::string v = value();
+            if      (v == "seq")    cli.backend = Backend::Sequential;
+            else if (v == "omp")    cli.backend = Backend::OpenMP;
+            else if (v == "mpi")    cli.backend = Backend::MPI;
+            else if (v == "hybrid") cli.backend = Backend::Hybrid;
+            else throw std::invalid_argument("Unknown backend: " + v);
+        } else if (flag == "--threshold") {
+            cli.threshold = std::stod(value());
+        } else if (flag == "--partition") {
+            std::string v = value();
+            if      (v == "block") opts.partition = MPIProcessor::PartitionMode::Block;
+            else if (v == "rr")    opts.partition = MPIProcessor::PartitionMode::RoundRobin;
+            else throw std::invalid_argument("Unknown partition mode: " + v);
+        } else if (flag == "--gop") {
+            std::string v = value();
+            opts.gop = (v == "auto") ? MPIProcessor::GOP_AUTO : std::stoi(v);
+            if (opts.gop < MPIProcessor::GOP_AUTO) throw std::invalid_argument("Invalid GOP: " + v);
+        } else if (flag == "--weights") {
+            std::stringstream list(value());
+            for (std::string w; std::getline(list, w, ',');)
+                opts.weights.push_back(std::stod(w));
+        } else if (flag == "--decode-report") {
+            opts.decodeReport = true;
+        } else if (flag == "--stitch") {
+            std::string v = value();
+            if      (v == "concat") opts.stitch = MPIProcessor::StitchMode::Concat;
+            else if (v == "merge")  opts.stitch = MPIProcessor::StitchMode::Merge;
+            else throw std::invalid_argument("Unknown stitch mode: " + v);
+        } else if (flag == "--single-pass") {
+            opts.singlePass = true;
+        } else if (flag == "--alpha") {
+            opts.alpha = std::stod(value());
+            if (!(opts.alpha >= 0.0 && opts.alpha <= 1.0))
+                throw std::invalid_argument("--alpha must be in [0, 1]");
+        } else if (flag == "--warmup") {
+            opts.warmup = std::stoi(value());
+            if (opts.warmup < 0) throw std::invalid_argument("--warmup must not be negative");
+        } else if (flag == "--motion-csv") {
+            opts.motionCsv = value();
+        } else if (flag == "--reduce") {
+            std::string v = value();
+            if      (v == "scatter") opts.reduce = MPIProcessor::ReduceMode::Scatter;
+            else if (v == "root")    opts.reduce = MPIProcessor::ReduceMode::Root;
+            else throw std::invalid_argument("Unknown reduce mode: " + v);
+        } else if (flag == "--wire") {
+            std::string v = value();
+            if      (v == "u32") opts.wire = MPIProcessor::WireType::U32;
+            else if (v == "f64") opts.wire = MPIProcessor::WireType::F64;
+            else throw std::invalid_argument("Unknown wire type: " + v);
+        } else if (flag == "--model") {
+            std::string v = value();
+            if (v == "mean") {
+                opts.model = MPIProcessor::BackgroundModel::Mean;
+            } else if (v == "median") {
+                opts.model = MPIProcessor::BackgroundModel::Percentile;
+                opts.percentile = 50.0;
+            } else if (v == "mog") {
+                opts.model = MPIProcessor::BackgroundModel::Mixture;
+            } else {
+                throw std::invalid_argument("Unknown background model: " + v);
+            }
+        } else if (flag == "--percentile") {
+            opts.model = MPIProcessor::BackgroundModel::Percentile;
+            opts.percentile = std::stod(value());
+            if (opts.percentile < 0.0 || opts.percentile > 100.0)
+                throw std::invalid_argument("--percentile must be within [0, 100]");
+        } else if (flag == "--engine") {
+            std::string v = value();
+            if      (v == "hist")   opts.engine = MPIProcessor::PercentileEngine::Histogram;
+            else if (v == "approx") opts.engine = MPIProcessor::PercentileEngine::Approx;
+            else throw std::invalid_argument("Unknown percentile engine: " + v);
+        } else if (flag == "--mog-k") {
+            opts.mixture.components = std::stoi(value());
+            if (opts.mixture.components < 1 || opts.mixture.components > MixtureBackground::MAX_COMPONENTS)
+                throw std::invalid_argument("--mog-k must be within [1, 5]");
+        } else if (flag == "--mog-rate") {
+            opts.mixture.learningRate = std::stof(value());
+            if (!(opts.mixture.learningRate > 0.0f && opts.mixture.learningRate <= 1.0f))
+                throw std::invalid_argument("--mog-rate must be within (0, 1]");
+        } else if (flag == "--threads") {
+            opts.threads = std::stoi(value());
+            if (opts.threads < 1) throw std::invalid_argument("--threads must be at least 1");
+        } else if (flag == "--layout") {
+            layout = value();
+        } else if (flag == "--profile") {
+            opts.profile = value();
+        } else if (flag == "--trace") {
+            opts.trace = value();
+        } else if (flag == "--luma-cache") {
+            opts.lumaCache = value();
+        } else if (flag == "--checkpoint") {
+            opts.checkpoint = value();
+        } else if (flag == "--checkpoint-every") {
+            opts.checkpointEvery = std::stoi(value());
+            if (opts.checkpointEvery < 1) throw std::invalid_argument("--checkpoint-every must be at least 1");
+        } else if (flag == "--batch-chunk") {
+            cli.chunkFrames = std::stoi(value());
+            if (cli.chunkFrames < 1) throw std::invalid_argument("--batch-chunk must be at least 1");
+        } else if (flag == "--sweep") {
+            opts.sweep = parseThresholds(value());
+        } else if (flag == "--sweep-models") {
+            opts.sweepModels = parseSweepModels(value());
+        } else if (flag == "--sweep-masks") {
+            opts.sweepMasks = true;
+        } else if (flag == "--window") {
+            opts.window = std::stoi(value());
+            if (opts.window < 1) throw std::invalid_argument("--window must be at least 1");
+        } else if (flag == "--segment") {
+            opts.segment = std::stoi(value());
+            if (opts.segment < 1) throw std::invalid_argument("--segment must be at least 1");
+        } else if (flag == "--roi") {
+            opts.region.rois.push_back(parseRoi(value()));
+        } else if (flag == "--roi-mask") {
+            opts.region.maskPath = value();
+        } else if (flag == "--downscale") {
+            opts.region.scale = std::stoi(value());
+            if (opts.region.scale < 1) throw std::invalid_argument("--downscale must be at least 1");
+        } else if (flag == "--sample") {
+            const double tolerance = opts.sample.tolerance;
+            opts.sample = parseSampleSpec(value());
+            opts.sample.tolerance = tolerance;
+            sampleGiven = true;
+        } else if (flag == "--sample-tol") {
+            opts.sample.tolerance = std::stod(value());
+            if (!(opts.sample.tolerance > 0.0)) throw std::invalid_argument("--sample-tol must be positive");
+        } else if (flag == "--stream") {
+            cli.stream.format = parseStreamFormat(value());
+        } else if (flag == "--stream-size") {
+            cli.stream.size = parseFrameSize(value());
+        } else if (flag == "--stream-fps") {
+            cli.stream.fps = std::stod(value());
+            if (!(cli.stream.fps > 0.0)) throw std::invalid_argument("--stream-fps must be positive");
+        } else if (flag == "--queue") {
+            cli.stream.queue = std::stoi(value());
+            if (cli.stream.queue < 1) throw std::invalid_argument("--queue must be at least 1");
+        } else if (flag == "--drop") {
+            cli.stream.drop = parseDropPolicy(value());
+        } else if (flag == "--batch-masks") {
+            std::string v = value();
+            if (v != "mp4" && v != "msk") throw std::invalid_argument("Unknown mask format: " + v);
+            cli.maskExtension = "." + v;
+        } else if (flag == "--decode") {
+            std::string v = value();
+            if      (v == "bgr")  opts.decode = DecodeMode::BGR;
+            else if (v == "luma") opts.decode = DecodeMode::Luma;
+            else throw std::invalid_argument("Unknown decode mode: " + v);
+        } else {
+            throw std::invalid_argument("Unknown option: " + flag);
+        }
+    }
+    if (!layout.empty()) {
+        // R must match the communicator; T becomes the per-rank team size
+        size_t x = layout.find('x');
+        if (x == std::string::npos)
+            throw std::invalid_argument("--layout expects RxT, got " + layout);
+        int ranks = std::stoi(layout.substr(0, x));
+        opts.threads = std::stoi(layout.substr(x + 1));
+        if (opts.threads < 1)
+            throw std::invalid_argument("--layout needs at least one thread per rank, got " + layout);
+        if (ranks != size)
+            throw std::invalid_argument("--layout " + layout + " does not match " +
+                                        std::to_string(size) + " MPI ranks");
+    }
+    if (opts.threads < 0)
+        throw std::invalid_argument("Thread count must be positive");
+    if (opts.singlePass && opts.model != MPIProcessor::BackgroundModel::Mean)
+        throw std::invalid_argument("--single-pass uses a running mean; drop --model/--percentile");
+    if (!opts.sweep.empty() &&
+        (opts.singlePass || opts.model == MPIProcessor::BackgroundModel::Mixture || !opts.lumaCache.empty() ||
+         !opts.checkpoint.empty() || !opts.motionCsv.empty()))
+        throw std::invalid_argument("--sweep needs a mean or percentile model and writes its own counts;"
+                                    " drop --single-pass/--luma-cache/--checkpoint/--motion-csv");
+    if ((!opts.sweepModels.empty() || opts.sweepMasks) && opts.sweep.empty())
+        throw std::invalid_argument("--sweep-models and --sweep-masks need --sweep");
+    if (!opts.checkpoint.empty() &&
+        (opts.singlePass || opts.model != MPIProcessor::BackgroundModel::Mean || !opts.lumaCache.empty()))
+        throw std::invalid_argument("--checkpoint keeps mean-model sums; drop --single-pass/--model/--luma-cache");
+    if ((opts.window > 0 || opts.segment > 0) &&
+        ((opts.window > 0 && opts.segment > 0) || opts.singlePass ||
+         opts.model != MPIProcessor::BackgroundModel::Mean || !opts.sweep.empty() ||
+         !opts.lumaCache.empty() || !opts.checkpoint.empty()))
+        throw std::invalid_argument("--window and --segment are plain means of their frames; use one of them"
+                                    " and drop --single-pass/--model/--sweep/--luma-cache/--checkpoint");
+    if (!opts.sample.empty() &&
+        (opts.singlePass || opts.model != MPIProcessor::BackgroundModel::Mean || !opts.sweep.empty() ||
+         opts.window > 0 || opts.segment > 0 || !opts.lumaCache.empty() || !opts.checkpoint.empty()))
+        throw std::invalid_argument("--sample builds the plain mean background; drop --single-pass/--model/--sweep/"
+                                    "--window/--segment/--luma-cache/--checkpoint");
+    if (opts.sample.tolerance > 0.0 && opts.sample.empty())
+        throw std::invalid_argument(sampleGiven ? "--sample 1 reads every frame, so there is nothing for --sample-tol"
+                                                  " to stop early; use --sample adaptive"
+                                                : "--sample-tol needs --sample");
+    if (!opts.region.empty() && (!opts.lumaCache.empty() || !opts.checkpoint.empty()))
+        throw std::invalid_argument("--luma-cache and --checkpoint hold whole frames; drop --roi/--roi-mask/--downscale");
+
+    if (cli.backend == Backend::Auto)
+        cli.backend = (size == 1) ? Backend::OpenMP
+                    : (opts.threads > 0) ? Backend::Hybrid : Backend::MPI;
+    if ((cli.backend == Backend::Sequential || cli.backend == Backend::OpenMP) && size != 1)
+        throw std::invalid_argument(std::string("--backend ") + backendName(cli.backend) +
+                                    " runs in one process; launch without mpirun -n");
+    if (!cli.stream.empty() && cli.backend != Backend::Sequential && cli.backend != Backend::OpenMP)
+        throw std::invalid_argument("--stream is read by one process; use --backend seq or omp");
+    if (cli.backend == Backend::Sequential || cli.backend == Backend::MPI)
+        opts.threads = 1;
+    return cli;
+}
+
+// Options of the single-process backends, taken from the command line
+static LocalOptions localOptions(const CliOptions& cli) {
+    const MPIProcessor::Options& o = cli.run;
+    LocalOptions local;
+    local.threshold       = cli.threshold;
+    local.threads         = o.threads;
+    local.singlePass      = o.singlePass;
+    local.alpha           = o.alpha;
+    local.warmup          = o.warmup;
+    local.model           = o.model;
+    local.percentile      = o.percentile;
+    local.engine          = o.engine;
+    local.mixture         = o.mixture;
+    local.motionCsv       = o.motionCsv;
+    local.profile         = o.profile;
+    local.trace           = o.trace;
+    local.lumaCache       = o.lumaCache;
+    local.checkpoint      = o.checkpoint;
+    local.checkpointEvery = o.checkpointEvery;
+    local.sweep           = o.sweep;
+    local.sweepModels     = o.sweepModels;
+    local.sweepMasks      = o.sweepMasks;
+    local.window          = o.window;
+    local.segment         = o.segment;
+    local.region          = o.region;
+    local.stream          = cli.stream;
+    local.sample          = o.sample;
+    local.decode          = o.decode;
+    return local;
+}
+
+// Per-video outputs of many inputs; every rank runs items with its own team
+static int runBatch(const std::string& inputDir, const CliOptions& cli, int rank, int size) {
+    const MPIProcessor::Options& o = cli.run;
+    if (!o.motionCsv.empty() || !o.profile.empty() || !o.trace.empty() || !o.lumaCache.empty() ||
+        !o.checkpoint.empty()) {
+        if (rank == 0)
+            std::cerr << "Error: --motion-csv, --profile, --trace, --luma-cache and --checkpoint name a single file;"
+                      << " they are not supported with --batch\n";
+        return 1;
+    }
+    if (!o.sweep.empty()) {
+        if (rank == 0) std::cerr << "Error: --sweep runs on one video; it is not supported with --batch\n";
+        return 1;
+    }
+    if (!o.region.empty()) {
+        if (rank == 0) std::cerr << "Error: --roi, --roi-mask and --downscale fit one video size; not supported with --batch\n";
+        return 1;
+    }
+    if (o.window > 0 || o.segment > 0) {
+        if (rank == 0) std::cerr << "Error: --window and --segment are not supported with --batch\n";
+        return 1;
+    }
+    if (!cli.stream.empty()) {
+        if (rank == 0) std::cerr << "Error: --stream reads one input; it is not supported with --batch\n";
+        return 1;
+    }
+    if (!o.sample.empty()) {
+        if (rank == 0) std::cerr << "Error: --sample is not supported with --batch\n";
+        return 1;
+    }
+    BatchScheduler::Options batch;
+    batch.chunkFrames = cli.chunkFrames;
+    batch.concat = o.stitch == MPIProcessor::StitchMode::Concat;
+    batch.maskExtension = cli.maskExtension;
+    batch.local = localOptions(cli);
+    // Each rank is one worker; the backend only decides its team size
+    if (cli.backend == Backend::MPI)
+        batch.local.threads = 1;
+    try {
+        return BatchScheduler::run(inputDir, batch, rank, size);
+    } catch (std::exception &e) {
+        if (rank == 0) std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+// Fold partial checkpoints (e.g. written on different machines) into one
+static int mergeCheckpoints(int argc, char* argv[]) {
+    try {
+        AccumulatorCheckpoint merged;
+        for (int i = 3; i < argc; ++i)
+            merged.merge(AccumulatorCheckpoint::load(argv[i]));
+        merged.save(argv[2]);
+        std::cout << "Merged " << (argc - 3) << " checkpoints (" << merged.frames()
+                  << " frames) → " << argv[2] << "\n";
+        for (const auto& [source, ranges] : merged.coverage())
+            for (const auto& r : ranges)
+                std::cout << "  " << source << ": frames [" << r.first << ", " << r.second << ")\n";
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    // Initialize the MPI environment
-    MPI_Init(&argc, &argv);
+    // Initialize the MPI environment. Only the main thread of each rank makes
+    // MPI calls; the OpenMP team inside a rank never does.
+    int provided{};
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
     // Determine this process's rank (ID) and the total number of processes
     int rank{}, size{};
@@ -18,39 +437,96 @@ int main(int argc, char* argv[]) {
     // Record the start time of the MPI run (high-resolution wall-clock)
     double t_start = MPI_Wtime();
 
-    // Expect exactly 3 arguments: input video, background output, foreground output
-    if (argc != 4) {
+    if (argc >= 2 && std::string(argv[1]) == "--merge-checkpoints") {
+        int rc = 1;
+        if (argc < 4) {
+            if (rank == 0) printUsage();
+        } else if (rank == 0) {
+            rc = mergeCheckpoints(argc, argv);
+        }
+        MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return rc;
+    }
+
+    // Expect 3 positional arguments (input video, background output, foreground output)
+    // or --batch <input_dir>, followed by optional flags
+    const bool batch = argc >= 3 && std::string(argv[1]) == "--batch";
+    if (argc < 4 && !batch) {
+        if (rank == 0) printUsage();
+        MPI_Finalize();
+        return 1;
+    }
+
+    CliOptions cli;
+    try {
+        cli = parseOptions(argc, argv, batch ? 3 : 4, size);
+    } catch (std::exception &e) {
         if (rank == 0) {
-            std::cerr << "Usage: mpirun -n <P> ./bg_subtract"
-                      << " <input.mp4> <out_bg.png> <out_fg.mp4> "
-                      << "(uses default threshold=" << DEFAULT_THRESHOLD << ")\n";
+            std::cerr << "Error: " << e.what() << "\n";
+            printUsage();
         }
         MPI_Finalize();
         return 1;
     }
+    // OpenMP teams rely on MPI_THREAD_FUNNELED; without it each rank runs one thread
+    if (provided < MPI_THREAD_FUNNELED && cli.run.threads != 1) {
+        if (rank == 0)
+            std::cerr << "Warning: the MPI library does not support MPI_THREAD_FUNNELED; "
+                         "running one thread per process\n";
+        cli.run.threads = 1;
+    }
 
-    // Parse command-line arguments (skip threshold)
+    if (rank == 0)
+        std::filesystem::create_directories("output");
+    if (batch) {
+        MPI_Barrier(MPI_COMM_WORLD);   // output/ exists before any worker writes
+        int rc = runBatch(argv[2], cli, rank, size);
+        double t_end = MPI_Wtime();
+        MPI_Finalize();
+        if (rank == 0)
+            std::cout << "Total run time: " << (t_end - t_start) << " seconds\n";
+        return rc;
+    }
+
+    // Parse command-line arguments
     std::string inputVid = argv[1];
     std::string outBg    = argv[2];
     std::string outFg    = argv[3];
-    double threshold     = DEFAULT_THRESHOLD;
-
-    // Execute MPI-based background subtraction
-    int rc = MPIProcessor::run(
-        threshold,
-        inputVid,
-        outBg,
-        outFg,
-        rank,
-        size
-    );
+
+    int rc = 0;
+    if (cli.backend == Backend::Sequential || cli.backend == Backend::OpenMP) {
+        // Single-process backends: the same core code path with a team of 1 or T threads
+        LocalOptions local = localOptions(cli);
+        std::cout << "Backend: " << backendName(cli.backend) << "\n";
+        try {
+            runLocal(inputVid, "output/" + outBg, "output/" + outFg, local);
+            std::cout << "Done → output/" << outBg << ", output/" << outFg << "\n";
+        } catch (std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            rc = 1;
+        }
+    } else {
+        // Execute MPI-based background subtraction
+        if (rank == 0)
+            std::cout << "Backend: " << backendName(cli.backend) << "\n";
+        rc = MPIProcessor::run(
+            cli.threshold,
+            inputVid,
+            outBg,
+            outFg,
+            rank,
+            size,
+            cli.run
+        );
+    }
 
     // Measure end time
     double t_end = MPI_Wtime();
     MPI_Finalize();
 
     if (rank == 0) {
-        std::cout << "Total MPI run time: " << (t_end - t_start) << " seconds\n";
+        std::cout << "Total run time: " << (t_end - t_start) << " seconds\n";
     }
     return rc;
 }
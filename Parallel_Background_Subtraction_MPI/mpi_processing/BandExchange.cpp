@@ -0,0 +1,62 @@
+// mpi_processing/BandExchange.cpp
+#include "BandExchange.h"
+#include "../../core/Profiler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace BandExchange {
+
+int bandRows(int height, int size)
+{
+    return (height + size - 1) / size;
+}
+
+RowBand ownedBand(int height, int rank, int size)
+{
+    int rows = bandRows(height, size);
+    int begin = std::min(rank * rows, height);
+    return RowBand{ begin, std::min(begin + rows, height) };
+}
+
+void waitForRanks(MPI_Comm comm)
+{
+    if (!Profiler::enabled()) return;
+    Profiler::Scope scope("reduce_wait");
+    MPI_Barrier(comm);
+}
+
+void reduceScatter(const cv::Mat& padded, cv::Mat& band,
+                   MPI_Datatype wireType, MPI_Comm comm)
+{
+    int size{};
+    MPI_Comm_size(comm, &size);
+    if (!padded.isContinuous() || padded.rows % size != 0)
+        throw std::invalid_argument("reduceScatter needs a continuous buffer padded to whole bands");
+
+    int rows = padded.rows / size;
+    band.create(rows, padded.cols, padded.type());
+    waitForRanks(comm);
+    Profiler::Scope scope("reduce");
+    Profiler::count("bytes_reduced", static_cast<int64_t>(padded.total() * padded.elemSize()));
+    MPI_Reduce_scatter_block(padded.data,              // send buffer (all bands)
+                             band.data,                // receive buffer (own band)
+                             rows * padded.cols,       // elements per band
+                             wireType,
+                             MPI_SUM,
+                             comm);
+}
+
+cv::Mat allgather(const cv::Mat& band8, int height, MPI_Comm comm)
+{
+    int size{};
+    MPI_Comm_size(comm, &size);
+    cv::Mat sendBand = band8.isContinuous() ? band8 : band8.clone();
+
+    cv::Mat padded(band8.rows * size, band8.cols, CV_8U);
+    Profiler::Scope scope("allgather");
+    MPI_Allgather(sendBand.data, band8.rows * band8.cols, MPI_UNSIGNED_CHAR,
+                  padded.data,   band8.rows * band8.cols, MPI_UNSIGNED_CHAR, comm);
+    return padded.rowRange(0, height);
+}
+
+} // namespace BandExchange
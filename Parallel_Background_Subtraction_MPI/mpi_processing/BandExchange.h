@@ -0,0 +1,50 @@
+// mpi_processing/BandExchange.h
+
+#pragma once
+
+#include <mpi.h>
+#include <opencv2/opencv.hpp>
+
+namespace BandExchange {
+
+    // Horizontal band of image rows [begin, end) owned by one rank
+    struct RowBand {
+        int begin, end;
+        int rows() const { return end - begin; }
+    };
+
+    /**
+     * Rows per band when `height` rows are split over `size` ranks. Every
+     * rank gets the same count (the last band may run past the image), so
+     * buffers padded to size * bandRows(...) rows fit MPI_Reduce_scatter_block.
+     */
+    int bandRows(int height, int size);
+
+    // Image rows owned by `rank` (empty for trailing ranks of short images)
+    RowBand ownedBand(int height, int rank, int size);
+
+    /**
+     * With profiling enabled, waits for every rank of comm and books the wait
+     * as "reduce_wait", so load imbalance is not counted as reduction time.
+     * Does nothing when profiling is off.
+     */
+    void waitForRanks(MPI_Comm comm);
+
+    /**
+     * Sums `padded` (size * bandRows rows, continuous) element-wise across
+     * all ranks; each rank receives only its own band of the result.
+     *
+     * @param padded   local contribution, padded to whole bands
+     * @param band     receives this rank's summed band (bandRows x cols)
+     * @param wireType MPI element type matching padded's depth
+     */
+    void reduceScatter(const cv::Mat& padded, cv::Mat& band,
+                       MPI_Datatype wireType, MPI_Comm comm);
+
+    /**
+     * Concatenates every rank's 8-bit band (bandRows x cols) into the full
+     * height x cols image on all ranks.
+     */
+    cv::Mat allgather(const cv::Mat& band8, int height, MPI_Comm comm);
+
+} // namespace BandExchange
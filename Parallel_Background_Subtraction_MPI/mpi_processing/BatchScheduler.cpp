@@ -0,0 +1,486 @@
+// mpi_processing/BatchScheduler.cpp
+#include "BatchScheduler.h"
+#include "../../core/VideoProcessor.h"
+#include "../../core/FrameKernels.h"
+#include "../../core/FrameSource.h"
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace BatchScheduler {
+
+// Message tags between rank 0 and the workers
+enum Tag { TAG_ITEM = 1, TAG_BACKGROUND, TAG_RESULT, TAG_SUM };
+
+// What a work item asks a worker to do
+enum class Kind : int {
+    Stop,         // no more work
+    Whole,        // full workflow on one or more short videos
+    Sum,          // per-pixel sum of one chunk of a split video
+    Foreground    // masks of one chunk of a split video (the background follows)
+};
+
+struct WorkItem {
+    Kind kind = Kind::Stop;
+    int id = -1;
+    std::vector<int> videos;   // Whole: the packed videos; Sum/Foreground: the split video
+    FrameRange range{0, 0};    // Sum/Foreground: the chunk
+    int chunk = 0;             // Sum/Foreground: chunk index
+    int frames = 0;            // frames to decode, for ordering
+};
+
+// Rank 0's bookkeeping for one video split into chunks
+struct SplitVideo {
+    std::vector<FrameRange> chunks;   // clipped to the frames their Sum item read
+    cv::Mat sum;               // total of the chunk sums returned so far
+    int frames = 0;            // frames in sum (the header count may overstate it)
+    cv::Mat background;
+    int pendingSums = 0, pendingMasks = 0;
+    int runningMasks = 0;      // foreground items handed out and not yet back
+    bool failed = false;
+};
+
+// Outputs are named after outputStem(), which every rank derives from the same list
+static std::string bgPath(const std::vector<std::string>& paths, int v)
+{
+    return "output/" + outputStem(paths, v) + "_bg.png";
+}
+static std::string fgPath(const std::vector<std::string>& paths, int v, const std::string& ext)
+{
+    return "output/" + outputStem(paths, v) + "_fg" + ext;
+}
+
+// Foreground segment of one chunk: "output/clip_fg.part003.mp4"
+static std::string segmentPath(const std::vector<std::string>& paths, int v, int chunk, const std::string& ext)
+{
+    std::ostringstream out;
+    out << "output/" << outputStem(paths, v) << "_fg.part" << std::setw(3) << std::setfill('0') << chunk << ext;
+    return out.str();
+}
+
+// Delete the segments of a split video (after stitching, or when it failed)
+static void removeSegments(const std::vector<std::string>& paths, int v, int chunks, const std::string& ext)
+{
+    for (int k = 0; k < chunks; ++k) {
+        std::error_code ec;
+        std::filesystem::remove(segmentPath(paths, v, k, ext), ec);
+    }
+}
+
+// Share rank 0's video list and metadata with every rank
+static void broadcastVideos(std::vector<std::string>& paths, std::vector<VideoMeta>& metas, int rank)
+{
+    std::string joined;
+    if (rank == 0)
+        for (const auto& p : paths) joined += p + '\n';
+    int bytes = static_cast<int>(joined.size());
+    MPI_Bcast(&bytes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    joined.resize(bytes);
+    MPI_Bcast(joined.data(), bytes, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        std::istringstream lines(joined);
+        for (std::string line; std::getline(lines, line);)
+            paths.push_back(line);
+    }
+    metas.resize(paths.size());
+    MPI_Bcast(metas.data(), static_cast<int>(metas.size() * sizeof(VideoMeta)), MPI_BYTE, 0, MPI_COMM_WORLD);
+}
+
+// Work items, longest first. Mean-model videos longer than chunkFrames are
+// split into Sum chunks; the other videos are packed first-fit decreasing
+// into Whole items of at most chunkFrames frames (a longer one goes alone).
+static std::vector<WorkItem> planItems(const std::vector<VideoMeta>& metas, const Options& opts,
+                                       std::map<int, SplitVideo>& split)
+{
+    const bool splittable = opts.local.model == BackgroundModel::Mean && !opts.local.singlePass;
+    std::vector<WorkItem> items;
+    std::vector<int> whole;
+    for (int v = 0; v < static_cast<int>(metas.size()); ++v) {
+        const int frames = metas[v].totalFrames;
+        if (frames <= 0) continue;
+        if (!splittable || frames <= opts.chunkFrames) {
+            whole.push_back(v);
+            continue;
+        }
+        SplitVideo& s = split[v];
+        const int n = (frames + opts.chunkFrames - 1) / opts.chunkFrames;
+        for (int k = 0; k < n; ++k) {
+            FrameRange r = partitionFrames(frames, k, n, {}, {});
+            s.chunks.push_back(r);
+            items.push_back({ Kind::Sum, -1, { v }, r, k, r.count() });
+        }
+        s.pendingSums = n;
+    }
+
+    std::stable_sort(whole.begin(), whole.end(),
+                     [&](int a, int b) { return metas[a].totalFrames > metas[b].totalFrames; });
+    std::vector<WorkItem> packs;
+    for (int v : whole) {
+        const int frames = metas[v].totalFrames;
+        auto fit = std::find_if(packs.begin(), packs.end(),
+                                [&](const WorkItem& p) { return p.frames + frames <= opts.chunkFrames; });
+        if (fit == packs.end()) {
+            packs.push_back({ Kind::Whole, -1, { v }, { 0, 0 }, 0, frames });
+        } else {
+            fit->videos.push_back(v);
+            fit->frames += frames;
+        }
+    }
+    items.insert(items.end(), packs.begin(), packs.end());
+    std::stable_sort(items.begin(), items.end(),
+                     [](const WorkItem& a, const WorkItem& b) { return a.frames > b.frames; });
+    for (size_t i = 0; i < items.size(); ++i)
+        items[i].id = static_cast<int>(i);
+    return items;
+}
+
+static std::vector<int> encodeItem(const WorkItem& w)
+{
+    std::vector<int> msg{ static_cast<int>(w.kind), w.id, w.range.begin, w.range.end, w.chunk };
+    msg.insert(msg.end(), w.videos.begin(), w.videos.end());
+    return msg;
+}
+
+static WorkItem receiveItem()
+{
+    MPI_Status st;
+    MPI_Probe(0, TAG_ITEM, MPI_COMM_WORLD, &st);
+    int count = 0;
+    MPI_Get_count(&st, MPI_INT, &count);
+    std::vector<int> msg(count);
+    MPI_Recv(msg.data(), count, MPI_INT, 0, TAG_ITEM, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    WorkItem w;
+    w.kind = static_cast<Kind>(msg[0]);
+    w.id = msg[1];
+    w.range = { msg[2], msg[3] };
+    w.chunk = msg[4];
+    w.videos.assign(msg.begin() + 5, msg.end());
+    return w;
+}
+
+// Full workflow on each video; returns one status per video (0 = ok)
+static std::vector<int> runWhole(const std::vector<int>& videos, const std::vector<std::string>& paths,
+                                 const Options& opts, int rank)
+{
+    std::vector<int> status;
+    for (int v : videos) {
+        int rc = 0;
+        try {
+            runLocal(paths[v], bgPath(paths, v), fgPath(paths, v, opts.maskExtension), opts.local);
+        } catch (std::exception& e) {
+            std::cerr << "Rank " << rank << " error on " << paths[v] << ": " << e.what() << "\n";
+            rc = 1;
+        }
+        status.push_back(rc);
+    }
+    return status;
+}
+
+// Worker loop: run items until rank 0 says stop. Returns busy seconds.
+static double work(const std::vector<std::string>& paths, const std::vector<VideoMeta>& metas,
+                   const Options& opts, int rank)
+{
+    double busy = 0.0;
+    while (true) {
+        WorkItem item = receiveItem();
+        if (item.kind == Kind::Stop) break;
+        cv::Mat background;
+        if (item.kind == Kind::Foreground) {
+            const VideoMeta& m = metas[item.videos[0]];
+            background.create(m.height, m.width, CV_8U);
+            MPI_Recv(background.data, m.height * m.width, MPI_UNSIGNED_CHAR, 0, TAG_BACKGROUND,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+
+        const double t0 = MPI_Wtime();
+        std::vector<int> result{ item.id };
+        int summed = 0;
+        cv::Mat sum;
+        if (item.kind == Kind::Whole) {
+            std::vector<int> status = runWhole(item.videos, paths, opts, rank);
+            result.insert(result.end(), status.begin(), status.end());
+        } else {
+            const int v = item.videos[0];
+            const VideoMeta& m = metas[v];
+            int rc = 0;
+            try {
+                if (item.kind == Kind::Sum) {
+                    // Exact uint32 sums unless the whole video could overflow them
+                    int type = m.totalFrames <= MAX_U32_ACCUMULATED_FRAMES ? CV_32S : CV_64F;
+                    sum = cv::Mat::zeros(m.height, m.width, type);
+                    // The last chunk may run past the real end of the video
+                    summed = computeLocalSum(paths[v], item.range, sum, nullptr, true).framesDecoded;
+                } else {
+                    generateForegroundSegment(paths[v], background, item.range, m.fps, opts.local.threshold,
+                                              segmentPath(paths, v, item.chunk, opts.maskExtension));
+                }
+            } catch (std::exception& e) {
+                std::cerr << "Rank " << rank << " error on " << paths[v] << " frames [" << item.range.begin
+                          << ", " << item.range.end << "): " << e.what() << "\n";
+                rc = 1;
+            }
+            result.push_back(rc);
+            if (item.kind == Kind::Sum)
+                result.push_back(summed);
+        }
+        busy += MPI_Wtime() - t0;
+
+        MPI_Send(result.data(), static_cast<int>(result.size()), MPI_INT, 0, TAG_RESULT, MPI_COMM_WORLD);
+        if (item.kind == Kind::Sum && result[1] == 0)
+            MPI_Send(sum.data, static_cast<int>(sum.total() * sum.elemSize()), MPI_BYTE, 0, TAG_SUM,
+                     MPI_COMM_WORLD);
+    }
+    return busy;
+}
+
+// Adds one chunk's sum into a split video's total
+static void addSum(cv::Mat& total, const cv::Mat& chunk)
+{
+    if (total.empty()) {
+        total = chunk;
+        return;
+    }
+    if (total.type() != CV_32S) {
+        total += chunk;
+        return;
+    }
+    // uint32 sums do not fit CV_32S arithmetic
+    for (int y = 0; y < total.rows; ++y) {
+        uint32_t* t = reinterpret_cast<uint32_t*>(total.ptr<int>(y));
+        const uint32_t* c = reinterpret_cast<const uint32_t*>(chunk.ptr<int>(y));
+        for (int x = 0; x < total.cols; ++x)
+            t[x] += c[x];
+    }
+}
+
+// Rank 0: hand items to idle workers until every video is done.
+// Returns the number of failed videos.
+static int coordinate(const std::vector<std::string>& paths, const std::vector<VideoMeta>& metas,
+                      const Options& opts, int size)
+{
+    std::map<int, SplitVideo> split;
+    std::vector<WorkItem> items = planItems(metas, opts, split);
+    std::deque<int> queue;
+    for (const auto& w : items) queue.push_back(w.id);
+    std::cout << "Batch: " << paths.size() << " videos, " << items.size() << " initial items on "
+              << size - 1 << " workers\n";
+
+    const int total = static_cast<int>(paths.size());
+    int finished = 0, failures = 0;
+    auto report = [&](int v, bool ok) {
+        ++finished;
+        if (!ok) ++failures;
+        std::cout << "[" << finished << "/" << total << "] " << outputStem(paths, v)
+                  << (ok ? " done" : " FAILED") << "\n";
+    };
+    for (int v = 0; v < total; ++v)
+        if (metas[v].totalFrames <= 0) {
+            std::cerr << "Skipping unreadable or empty video: " << paths[v] << "\n";
+            report(v, false);
+        }
+    auto failSplit = [&](int v) {
+        if (!split[v].failed) {
+            split[v].failed = true;
+            report(v, false);
+        }
+    };
+
+    std::vector<int> idle;
+    for (int r = size - 1; r >= 1; --r) idle.push_back(r);
+    int outstanding = 0;
+    while (true) {
+        while (!idle.empty() && !queue.empty()) {
+            const WorkItem& w = items[queue.front()];
+            queue.pop_front();
+            // Remaining chunks of a failed video are dropped
+            if (w.kind != Kind::Whole && split[w.videos[0]].failed) continue;
+            int worker = idle.back();
+            idle.pop_back();
+            std::vector<int> msg = encodeItem(w);
+            MPI_Send(msg.data(), static_cast<int>(msg.size()), MPI_INT, worker, TAG_ITEM, MPI_COMM_WORLD);
+            if (w.kind == Kind::Foreground) {
+                ++split[w.videos[0]].runningMasks;
+                const cv::Mat& bg = split[w.videos[0]].background;
+                MPI_Send(bg.data, static_cast<int>(bg.total()), MPI_UNSIGNED_CHAR, worker, TAG_BACKGROUND,
+                         MPI_COMM_WORLD);
+            }
+            ++outstanding;
+        }
+        if (outstanding == 0) break;
+
+        MPI_Status st;
+        MPI_Probe(MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &st);
+        int count = 0;
+        MPI_Get_count(&st, MPI_INT, &count);
+        std::vector<int> result(count);
+        MPI_Recv(result.data(), count, MPI_INT, st.MPI_SOURCE, TAG_RESULT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        --outstanding;
+        idle.push_back(st.MPI_SOURCE);
+
+        // Copy: queueing foreground items below may reallocate items
+        const WorkItem w = items[result[0]];
+        if (w.kind == Kind::Whole) {
+            for (size_t i = 0; i < w.videos.size(); ++i)
+                report(w.videos[i], result[i + 1] == 0);
+            continue;
+        }
+
+        const int v = w.videos[0];
+        SplitVideo& s = split[v];
+        const VideoMeta& m = metas[v];
+        if (w.kind == Kind::Sum) {
+            if (result[1] == 0) {
+                cv::Mat chunk(m.height, m.width, m.totalFrames <= MAX_U32_ACCUMULATED_FRAMES ? CV_32S : CV_64F);
+                MPI_Recv(chunk.data, static_cast<int>(chunk.total() * chunk.elemSize()), MPI_BYTE,
+                         st.MPI_SOURCE, TAG_SUM, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                if (!s.failed) addSum(s.sum, chunk);
+                s.frames += result[2];
+                s.chunks[w.chunk].end = w.range.begin + result[2];
+            } else {
+                failSplit(v);
+            }
+            if (--s.pendingSums > 0 || s.failed) continue;
+
+            // Chunks past the end of the stream get no foreground item
+            s.chunks.erase(std::remove_if(s.chunks.begin(), s.chunks.end(),
+                                          [](const FrameRange& r) { return r.count() <= 0; }),
+                           s.chunks.end());
+            s.pendingMasks = static_cast<int>(s.chunks.size());
+            if (s.frames == 0) {
+                std::cerr << "No frames could be read from " << paths[v] << "\n";
+                failSplit(v);
+                continue;
+            }
+            try {
+                s.background = writeBackground(s.sum, s.frames, bgPath(paths, v));
+            } catch (std::exception& e) {
+                std::cerr << "Error writing background of " << paths[v] << ": " << e.what() << "\n";
+                failSplit(v);
+                continue;
+            }
+            s.sum.release();
+            // Foreground chunks finish a video, so they jump the queue
+            for (int k = static_cast<int>(s.chunks.size()) - 1; k >= 0; --k) {
+                WorkItem fg{ Kind::Foreground, static_cast<int>(items.size()), { v }, s.chunks[k], k,
+                             s.chunks[k].count() };
+                items.push_back(fg);
+                queue.push_front(fg.id);
+            }
+        } else {
+            --s.runningMasks;
+            if (result[1] != 0) failSplit(v);
+            if (s.failed) {
+                // Drop the segments written so far once no worker is still writing one
+                if (s.runningMasks == 0)
+                    removeSegments(paths, v, static_cast<int>(s.chunks.size()), opts.maskExtension);
+                continue;
+            }
+            if (--s.pendingMasks > 0) continue;
+
+            std::vector<std::string> segments;
+            for (size_t k = 0; k < s.chunks.size(); ++k)
+                segments.push_back(segmentPath(paths, v, static_cast<int>(k), opts.maskExtension));
+            try {
+                stitchSegments(segments, fgPath(paths, v, opts.maskExtension), m.fps, cv::Size(m.width, m.height), opts.concat);
+                s.background.release();
+                report(v, true);
+            } catch (std::exception& e) {
+                std::cerr << "Error joining " << fgPath(paths, v, opts.maskExtension) << ": " << e.what() << "\n";
+                failSplit(v);
+            }
+            removeSegments(paths, v, static_cast<int>(s.chunks.size()), opts.maskExtension);
+        }
+    }
+
+    WorkItem stop;
+    std::vector<int> msg = encodeItem(stop);
+    for (int r = 1; r < size; ++r)
+        MPI_Send(msg.data(), static_cast<int>(msg.size()), MPI_INT, r, TAG_ITEM, MPI_COMM_WORLD);
+    return failures;
+}
+
+int run(const std::string& inputDir, const Options& opts, int rank, int size)
+{
+    if (opts.chunkFrames < 1)
+        throw std::invalid_argument("Batch chunk size must be at least one frame");
+    setDecodeMode(opts.local.decode);
+#ifdef _OPENMP
+    if (opts.local.threads > 0)
+        omp_set_num_threads(opts.local.threads);
+#endif
+
+    // Rank 0 lists the directory and reads every video's metadata
+    std::vector<std::string> paths;
+    std::vector<VideoMeta> metas;
+    int status = 0;
+    if (rank == 0) {
+        try {
+            paths = listVideos(inputDir);
+            if (paths.empty())
+                throw std::runtime_error("No videos in " + inputDir);
+        } catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            status = 1;
+        }
+        for (const auto& p : paths) {
+            try {
+                metas.push_back(readVideoMeta(p));
+            } catch (std::exception&) {
+                // An empty entry; reported by the coordinator
+                metas.push_back(VideoMeta{ 0, 0, 0, 0.0 });
+            }
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+
+    if (size == 1) {
+        // No workers to feed: run each video in place
+        int failures = 0;
+        for (int v = 0; v < static_cast<int>(paths.size()); ++v) {
+            bool ok = metas[v].totalFrames > 0 && runWhole({ v }, paths, opts, rank)[0] == 0;
+            if (!ok) ++failures;
+            std::cout << "[" << v + 1 << "/" << paths.size() << "] " << outputStem(paths, v)
+                      << (ok ? " done" : " FAILED") << "\n";
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    broadcastVideos(paths, metas, rank);
+    const double t0 = MPI_Wtime();
+    int failures = 0;
+    double busy = 0.0;
+    if (rank == 0)
+        failures = coordinate(paths, metas, opts, size);
+    else
+        busy = work(paths, metas, opts, rank);
+    const double wall = MPI_Wtime() - t0;
+
+    // Worker utilization: share of the schedule each worker spent on items
+    std::vector<double> perRank(rank == 0 ? size : 0);
+    MPI_Gather(&busy, 1, MPI_DOUBLE, perRank.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (rank == 0 && wall > 0.0) {
+        double lo = 1.0, sum = 0.0;
+        for (int r = 1; r < size; ++r) {
+            lo = std::min(lo, perRank[r] / wall);
+            sum += perRank[r] / wall;
+        }
+        std::cout << std::fixed << std::setprecision(1) << "Worker utilization: mean "
+                  << 100.0 * sum / (size - 1) << "%, min " << 100.0 * lo << "%\n"
+                  << std::defaultfloat;
+        if (failures > 0)
+            std::cerr << failures << " of " << paths.size() << " videos failed\n";
+    }
+    MPI_Bcast(&failures, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace BatchScheduler
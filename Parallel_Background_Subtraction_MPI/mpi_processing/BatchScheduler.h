@@ -0,0 +1,52 @@
+// mpi_processing/BatchScheduler.h
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include "../../core/LocalBackend.h"
+
+namespace BatchScheduler {
+
+    // Default work item size, in frames
+    static constexpr int DEFAULT_CHUNK_FRAMES = 1500;
+
+    /**
+     * Tunables for BatchScheduler::run.
+     *
+     * chunkFrames   target work item size: mean-model videos longer than this
+     *               are split into chunks of about this many frames, shorter
+     *               videos are packed together up to this many frames per item
+     * concat        join split foreground segments by ffmpeg stream copy
+     *               (falls back to re-encoding)
+     * maskExtension ".mp4" for mp4v mask videos, ".msk" for lossless mask streams
+     * local         per-video options (threshold, model, threads, decode, ...);
+     *               motionCsv, profile, trace and lumaCache are not used
+     */
+    struct Options {
+        int chunkFrames = DEFAULT_CHUNK_FRAMES;
+        bool concat = true;
+        std::string maskExtension = ".mp4";
+        LocalOptions local;
+    };
+
+    /**
+     * Processes every video in inputDir into output/<stem>_bg.png and
+     * output/<stem>_fg<maskExtension> (collective over MPI_COMM_WORLD).
+     *
+     * Rank 0 plans the work and hands items to idle ranks on demand. The
+     * longest items go first. A split video's background chunks are summed
+     * on rank 0, and its foreground chunks are queued ahead of everything
+     * else once its background is known. With one rank every video is run
+     * in place.
+     *
+     * @param inputDir directory of input videos
+     * @param opts     item sizing and per-video options
+     * @param rank     MPI rank (0..P-1)
+     * @param size     MPI size (P)
+     * @returns        0 if every video succeeded, non-zero otherwise (on every rank)
+     */
+    int run(const std::string& inputDir, const Options& opts, int rank, int size);
+
+} // namespace BatchScheduler
@@ -1,10 +1,989 @@
 // mpi_processing/MPIProcessor.cpp
 #include "MPIProcessor.h"
+#include "BandExchange.h"
+#include "../../core/FrameKernels.h"
+#include "../../core/PercentileBackground.h"
+#include "../../core/MixtureBackground.h"
+#include "../../core/LumaCache.h"
+#include "../../core/AccumulatorCheckpoint.h"
+#include "../../core/FrameSource.h"
+#include "../../core/FrameRegion.h"
+#include "../../core/FrameSampler.h"
+#include "../../core/MaskStream.h"
+#include "../../core/Profiler.h"
+#include <algorithm>
 #include <iostream>
 #include <exception>
+#include <stdexcept>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace MPIProcessor {
 
+// Per-rank segment file: "out/fg.mp4" → "out/fg.part003.mp4"
+static std::string segmentPath(const std::string& fgOut, int rank)
+{
+    std::ostringstream suffix;
+    suffix << ".part" << std::setw(3) << std::setfill('0') << rank;
+    auto dot = fgOut.find_last_of('.');
+    auto slash = fgOut.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return fgOut + suffix.str();
+    return fgOut.substr(0, dot) + suffix.str() + fgOut.substr(dot);
+}
+
+// Share a list held by rank 0 (keyframes, frame ranges) with every rank
+static void broadcastInts(std::vector<int>& values, int rank)
+{
+    int count = (rank == 0) ? static_cast<int>(values.size()) : 0;
+    MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    values.resize(count);
+    if (count > 0)
+        MPI_Bcast(values.data(), count, MPI_INT, 0, MPI_COMM_WORLD);
+}
+
+// Gather every rank's frame range and decode counts and print them on rank 0.
+// In block mode the ranges must tile [0, totalFrames) exactly once. A block
+// that starts off a keyframe is reached by decoding from the preceding
+// keyframe; rank 0 scans the keyframes and reports those frames as overhead,
+// since read() never returns them and framesDecoded cannot count them.
+static void reportDecodes(const std::string& inVid, const FrameRange& range, const DecodeStats& stats,
+                          int totalFrames, PartitionMode mode, int rank, int size)
+{
+    int mine[4] = { range.begin, range.end, stats.framesDecoded, stats.seeks };
+    std::vector<int> all(rank == 0 ? 4 * size : 0);
+    MPI_Gather(mine, 4, MPI_INT, all.data(), 4, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+
+    std::vector<int> keyframes;
+    if (mode == PartitionMode::Block) {
+        try {
+            keyframes = scanKeyframes(inVid);
+        } catch (std::exception&) {
+            keyframes.clear();
+        }
+    }
+    // Frames decoded and discarded to reach frame `begin` after a seek
+    auto seekOverhead = [&](int begin) -> long {
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), begin);
+        return next == keyframes.begin() ? begin : begin - *(next - 1);
+    };
+
+    long decoded = 0, overhead = 0;
+    bool tiled = true;
+    int expectedBegin = 0;
+    std::cout << "Decode report (" << (mode == PartitionMode::Block ? "block" : "round-robin") << "):\n";
+    for (int r = 0; r < size; ++r) {
+        const int* e = &all[4 * r];
+        if (mode == PartitionMode::Block) {
+            std::cout << "  rank " << r << ": frames [" << e[0] << ", " << e[1] << ")";
+            tiled = tiled && e[0] == expectedBegin && e[2] == e[1] - e[0];
+            expectedBegin = e[1];
+        } else {
+            std::cout << "  rank " << r << ": every " << size << "th frame from " << r;
+        }
+        std::cout << " decoded=" << e[2] << " seeks=" << e[3];
+        if (!keyframes.empty() && e[0] > 0 && e[1] > e[0]) {
+            const long extra = seekOverhead(e[0]);
+            std::cout << " gop_overhead=" << extra;
+            overhead += extra;
+        }
+        std::cout << "\n";
+        decoded += e[2];
+    }
+    if (mode == PartitionMode::Block)
+        tiled = tiled && expectedBegin == totalFrames;
+    else
+        tiled = decoded == totalFrames;
+
+    std::cout << "  total returned=" << decoded << " of " << totalFrames << " frames"
+              << (tiled && decoded == totalFrames ? " (each frame returned once)" : " (MISMATCH)") << "\n";
+    if (mode == PartitionMode::RoundRobin)
+        std::cout << "  note: every seek re-decodes from the preceding keyframe\n";
+    else if (!keyframes.empty())
+        std::cout << "  plus " << overhead << " frames decoded from preceding keyframes to reach block starts"
+                  << (overhead == 0 ? " (blocks are keyframe aligned)" : "") << "\n";
+    else
+        std::cout << "  note: keyframes unknown; a block start off a keyframe also decodes from the preceding one\n";
+}
+
+// Gather which ranks produced frames and let rank 0 join their segments in
+// rank (= frame) order. Returns non-zero on rank 0 if stitching failed.
+static int joinSegments(const FrameRange& fgRange, const std::string& finalFg,
+                        const VideoMeta& meta, const Options& opts, int rank, int size)
+{
+    int hasFrames = fgRange.count() > 0 ? 1 : 0;
+    std::vector<int> segmentFrames(rank == 0 ? size : 0);
+    MPI_Gather(&hasFrames, 1, MPI_INT, segmentFrames.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank != 0 || size == 1) return 0;
+
+    try {
+        std::vector<std::string> segments;
+        for (int r = 0; r < size; ++r)
+            if (segmentFrames[r]) segments.push_back(segmentPath(finalFg, r));
+        stitchSegments(segments, finalFg, meta.fps, cv::Size(meta.width, meta.height),
+                       opts.stitch == StitchMode::Concat);
+        for (const auto &seg : segments)
+            std::remove(seg.c_str());
+    } catch (std::exception &e) {
+        std::cerr << "Error generating outputs: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Concatenate every rank's per-frame values on rank 0, in rank (= frame)
+// order (empty vector elsewhere)
+static std::vector<int> gatherCounts(const std::vector<int>& counts, int rank, int size)
+{
+    int mine = static_cast<int>(counts.size());
+    std::vector<int> perRank(rank == 0 ? size : 0), offsets(rank == 0 ? size : 0);
+    MPI_Gather(&mine, 1, MPI_INT, perRank.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> all;
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; ++r) {
+            offsets[r] = total;
+            total += perRank[r];
+        }
+        all.resize(total);
+    }
+    MPI_Gatherv(counts.data(), mine, MPI_INT,
+                all.data(), perRank.data(), offsets.data(), MPI_INT, 0, MPI_COMM_WORLD);
+    return all;
+}
+
+// Gather per-frame foreground pixel counts (ranks hold consecutive frame
+// ranges in rank order) and write them to a CSV on rank 0.
+static int writeMotionStats(const std::vector<int>& counts, const std::string& csvPath,
+                            const VideoMeta& meta, int rank, int size)
+{
+    std::vector<int> all = gatherCounts(counts, rank, size);
+    if (rank != 0) return 0;
+
+    try {
+        writeMotionCsv(all, csvPath, meta.width * meta.height);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Single-pass mode: every rank streams its contiguous block once, updating a
+// running background and emitting masks on the fly. The last rank that got
+// any frames (the stream may end before the header's frame count) writes its
+// final model as the background image.
+static int runSinglePass(double thresh, const std::string& inVid,
+                         const std::string& outBg, const std::string& outFg,
+                         const VideoMeta& meta, const std::vector<int>& keyframes,
+                         const Options& opts, int rank, int size)
+{
+    FrameRange range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    std::string finalFg = "output/" + outFg;
+    std::string segOut  = (size == 1) ? finalFg : segmentPath(finalFg, rank);
+
+    DecodeStats stats;
+    std::vector<int> fgCounts;
+    cv::Mat finalBg;
+    int status = 0;
+    try {
+        stats = streamForegroundSegment(inVid, range, meta.fps, thresh,
+                                        opts.alpha, opts.warmup, segOut, finalBg,
+                                        opts.motionCsv.empty() ? nullptr : &fgCounts);
+    } catch (std::exception &e) {
+        std::cerr << "Rank " << rank << " error in single-pass foreground: " << e.what() << "\n";
+        status = 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+
+    int lastRank = stats.framesDecoded > 0 ? rank : -1;
+    MPI_Allreduce(MPI_IN_PLACE, &lastRank, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (lastRank < 0) {
+        if (rank == 0) std::cerr << "Error: no frames could be read from " << inVid << "\n";
+        return 1;
+    }
+    if (rank == lastRank && !writeFrameImage("output/" + outBg, finalBg)) {
+        std::cerr << "Cannot write background: output/" << outBg << "\n";
+        status = 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+
+    if (opts.decodeReport)
+        reportDecodes(inVid, range, stats, meta.totalFrames, PartitionMode::Block, rank, size);
+    if (!opts.motionCsv.empty() && writeMotionStats(fgCounts, opts.motionCsv, meta, rank, size) != 0)
+        return 1;
+
+    if (joinSegments(range, finalFg, meta, opts, rank, size) != 0)
+        return 1;
+    if (rank == 0)
+        std::cout << "Done (single pass) → output/" << outBg << ", output/" << outFg << "\n";
+    return 0;
+}
+
+// Rank 0 writes a background every rank already holds; all ranks learn whether it worked
+static int publishBackground(const cv::Mat& background, const std::string& outBg, int rank)
+{
+    int status = 0;
+    if (rank == 0 && !writeFrameImage("output/" + outBg, background)) {
+        std::cerr << "Error generating outputs: Cannot write background: output/" << outBg << "\n";
+        status = 1;
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return status;
+}
+
+// Agree on the luma cache: 1 = valid for inVid, 0 = (re)build it in the sum
+// pass, -1 = not used. Building needs block partitioning.
+static int lumaCacheState(const std::string& inVid, const Options& opts, int rank)
+{
+    if (opts.lumaCache.empty()) return -1;
+    int state = 0;
+    if (rank == 0) {
+        state = LumaCache::matches(opts.lumaCache, inVid) ? 1 : 0;
+        if (state == 1)
+            std::cout << "Using luma cache " << opts.lumaCache << "\n";
+        else if (opts.partition != PartitionMode::Block) {
+            std::cerr << "Luma cache needs block partitioning to be built; not using it\n";
+            state = -1;
+        }
+    }
+    MPI_Bcast(&state, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return state;
+}
+
+// Collective: rank 0 creates the cache file sized for the whole video
+static int createLumaCache(const std::string& inVid, const VideoMeta& meta, const Options& opts, int rank)
+{
+    int status = 0;
+    if (rank == 0) {
+        try {
+            LumaCacheWriter::create(opts.lumaCache, inVid, meta);
+        } catch (std::exception &e) {
+            std::cerr << "Error creating luma cache: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return status;
+}
+
+// Collective: once every rank wrote its block, rank 0 marks the cache
+// complete and every rank maps it
+static int openLumaCache(const Options& opts, int rank, int status, std::unique_ptr<LumaCache>& cache)
+{
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status == 0 && rank == 0) {
+        try {
+            LumaCacheWriter::finalize(opts.lumaCache);
+        } catch (std::exception &e) {
+            std::cerr << "Error finalizing luma cache: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status == 0) {
+        try {
+            cache = std::make_unique<LumaCache>(opts.lumaCache);
+        } catch (std::exception &e) {
+            std::cerr << "Rank " << rank << " cannot map luma cache: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    return status;
+}
+
+// Mean background: per-rank frame sums reduced to rank 0 or reduce-scattered by band.
+// Sets `range` to this rank's block (left empty for round-robin partitioning).
+static int meanBackgroundPass(const std::string& inVid, const std::string& outBg,
+                              const VideoMeta& meta, const std::vector<int>& keyframes,
+                              const Options& opts, int rank, int size,
+                              FrameRange& range, cv::Mat& meanBg,
+                              std::unique_ptr<LumaCache>& cache)
+{
+    // uint32 sums are exact and half the size of doubles on the wire, as long
+    // as the frame count cannot overflow them
+    const bool u32Wire = opts.wire == WireType::U32 && meta.totalFrames <= MAX_U32_ACCUMULATED_FRAMES;
+    const int accType = u32Wire ? CV_32S : CV_64F;
+    const MPI_Datatype wireType = u32Wire ? MPI_UINT32_T : MPI_DOUBLE;
+
+    // Initialize a local accumulator for this rank's frame subset. In scatter
+    // mode it is padded to whole bands so it can feed MPI_Reduce_scatter_block.
+    const bool scatter = opts.reduce == ReduceMode::Scatter;
+    const int bandRows = BandExchange::bandRows(meta.height, size);
+    cv::Mat padded = cv::Mat::zeros(scatter ? bandRows * size : meta.height, meta.width, accType);
+    cv::Mat localSum = padded.rowRange(0, meta.height);
+    DecodeStats stats;
+    int summedFrames = meta.totalFrames;
+    const int cacheState = lumaCacheState(inVid, opts, rank);
+    if (cacheState == 0 && createLumaCache(inVid, meta, opts, rank) != 0)
+        return 1;
+    int cacheStatus = 0;
+    try {
+        // Each rank processes its share of frames to compute a per-pixel sum
+        if (cacheState == 1) {
+            // Cached frames cost no seeks, so blocks are always used
+            range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+            cache = std::make_unique<LumaCache>(opts.lumaCache);
+            computeLocalSum(*cache, range, localSum);
+        } else if (cacheState == 0) {
+            // Every rank writes its own block of frames into the shared file
+            range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+            LumaCacheWriter writer(opts.lumaCache);
+            stats = computeLocalSum(inVid, range, localSum, &writer);
+            writer.close();
+        } else if (!opts.sample.empty()) {
+            // Every rank samples its block at the same density; one double
+            // per round decides whether all of them have converged
+            range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+            const SamplePlan plan(opts.sample, meta.totalFrames, keyframes);
+            const SampleStats sampled = sampleLocalSum(inVid, plan, range, localSum, [](double change) {
+                MPI_Allreduce(MPI_IN_PLACE, &change, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+                return change;
+            });
+            stats = sampled.decode;
+            summedFrames = sampled.frames;
+            MPI_Allreduce(MPI_IN_PLACE, &summedFrames, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+            if (rank == 0)
+                std::cout << "Sampled " << summedFrames << " of " << meta.totalFrames << " frames in "
+                          << sampled.rounds << (sampled.rounds == 1 ? " round" : " rounds")
+                          << (sampled.converged ? " (converged)" : "") << "\n";
+        } else if (opts.partition == PartitionMode::Block) {
+            range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+            stats = computeLocalSum(inVid, range, localSum);
+        } else {
+            stats = computeLocalSum(inVid, rank, size, localSum);
+        }
+    } catch (std::exception &e) {
+        if (cacheState != 0) {
+            if (rank == 0) std::cerr << "Error in computeLocalSum: " << e.what() << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // The sum is still needed; fall back to decoding without the cache
+        std::cerr << "Rank " << rank << " luma cache write failed: " << e.what() << "\n";
+        cacheStatus = 1;
+        localSum.setTo(0);
+        try {
+            stats = computeLocalSum(inVid, range, localSum);
+        } catch (std::exception &e2) {
+            std::cerr << "Rank " << rank << " error in computeLocalSum: " << e2.what() << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    if (cacheState == 0 && openLumaCache(opts, rank, cacheStatus, cache) != 0) {
+        cache.reset();
+        if (rank == 0) std::cerr << "Luma cache not available; decoding the video again\n";
+    }
+
+    if (opts.decodeReport)
+        reportDecodes(inVid, range, stats, meta.totalFrames, opts.partition, rank, size);
+
+    if (scatter) {
+        // Each rank sums and averages only its own band of rows, then the
+        // 8-bit bands are shared so every rank holds the full background
+        cv::Mat band;
+        BandExchange::reduceScatter(padded, band, wireType, MPI_COMM_WORLD);
+        meanBg = BandExchange::allgather(meanBackground(band, summedFrames),
+                                         meta.height, MPI_COMM_WORLD);
+        if (publishBackground(meanBg, outBg, rank) != 0) return 1;
+    } else {
+        // Prepare a matrix on rank 0 to collect the global sum
+        cv::Mat globalSum = cv::Mat::zeros(rank == 0 ? meta.height : 0, meta.width, accType);
+        BandExchange::waitForRanks(MPI_COMM_WORLD);
+        Profiler::Scope reduceScope("reduce");
+        Profiler::count("bytes_reduced", static_cast<int64_t>(localSum.total() * localSum.elemSize()));
+        // Sum up all localSum matrices into globalSum on rank 0
+        MPI_Reduce(localSum.data,                  // send buffer
+                   globalSum.data,                 // receive buffer (only valid on root)
+                   meta.height * meta.width,       // element count
+                   wireType,                       // data type
+                   MPI_SUM,                        // operation
+                   0,                              // root rank
+                   MPI_COMM_WORLD);
+
+        // Rank 0 writes the background; every rank needs it for its foreground segment
+        int status = 0;
+        meanBg.create(meta.height, meta.width, CV_8U);
+        if (rank == 0) {
+            try {
+                meanBg = writeBackground(globalSum, summedFrames, "output/" + outBg);
+            } catch (std::exception &e) {
+                std::cerr << "Error generating outputs: " << e.what() << "\n";
+                status = 1;
+            }
+        }
+        MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (status != 0) return 1;
+        MPI_Bcast(meanBg.ptr<uchar>(), meta.height * meta.width, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    }
+
+    if (rank == 0 && opts.decodeReport) {
+        double elemBytes = u32Wire ? 4.0 : 8.0;
+        double mb = elemBytes * (scatter ? bandRows * size : meta.height) * meta.width / (1024.0 * 1024.0);
+        std::cout << "Reduction: " << (scatter ? "reduce-scatter" : "reduce to rank 0")
+                  << ", wire " << (u32Wire ? "uint32" : "double")
+                  << ", " << mb << " MB contributed per rank\n";
+    }
+    return 0;
+}
+
+// Mean background through a resumable checkpoint on rank 0. The frames it
+// does not cover yet are summed in rounds of checkpointEvery frames per rank;
+// after each round rank 0 folds the reduced sum in and saves the file, so an
+// interrupted run loses at most one round. Sets `range` to this rank's block
+// for the foreground pass.
+static int checkpointBackgroundPass(const std::string& inVid, const std::string& outBg,
+                                    const VideoMeta& meta, const std::vector<int>& keyframes,
+                                    const Options& opts, int rank, int size,
+                                    FrameRange& range, cv::Mat& meanBg)
+{
+    const CheckpointSource source = checkpointSource(inVid);
+    AccumulatorCheckpoint ckpt;
+    std::vector<int> gaps;   // flattened [begin, end) pairs
+    int status = 0;
+    if (rank == 0) {
+        try {
+            ckpt = AccumulatorCheckpoint::open(opts.checkpoint, cv::Size(meta.width, meta.height));
+            for (const FrameRange& g : ckpt.missing(source, meta.totalFrames)) {
+                gaps.push_back(g.begin);
+                gaps.push_back(g.end);
+            }
+            if (ckpt.frames() > 0)
+                std::cout << "Resuming from checkpoint " << opts.checkpoint << " ("
+                          << ckpt.frames() << " frames)\n";
+        } catch (std::exception &e) {
+            std::cerr << "Error opening checkpoint: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+    broadcastInts(gaps, rank);
+
+    cv::Mat localSum(meta.height, meta.width, CV_64F);
+    cv::Mat globalSum(rank == 0 ? meta.height : 0, meta.width, CV_64F);
+    const int round = opts.checkpointEvery * size;
+    for (size_t g = 0; g < gaps.size(); g += 2) {
+        for (int b = gaps[g]; b < gaps[g + 1]; b += round) {
+            // Split this round evenly; every rank contributes to the reduce
+            const FrameRange chunk{b, std::min(b + round, gaps[g + 1])};
+            const int n = chunk.count();
+            const FrameRange mine{chunk.begin + static_cast<int>(static_cast<int64_t>(n) * rank / size),
+                                  chunk.begin + static_cast<int>(static_cast<int64_t>(n) * (rank + 1) / size)};
+            localSum.setTo(0);
+            try {
+                computeLocalSum(inVid, mine, localSum);
+            } catch (std::exception &e) {
+                std::cerr << "Rank " << rank << " error in computeLocalSum: " << e.what() << "\n";
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            {
+                Profiler::Scope reduceScope("reduce");
+                MPI_Reduce(localSum.data, globalSum.data, meta.height * meta.width,
+                           MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+            }
+            if (rank == 0) {
+                try {
+                    Profiler::Scope scope("checkpoint");
+                    ckpt.add(source, chunk, globalSum);
+                    ckpt.save(opts.checkpoint);
+                } catch (std::exception &e) {
+                    std::cerr << "Error saving checkpoint: " << e.what() << "\n";
+                    status = 1;
+                }
+            }
+            MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            if (status != 0) return 1;
+        }
+    }
+
+    meanBg.create(meta.height, meta.width, CV_8U);
+    if (rank == 0) {
+        try {
+            meanBg = ckpt.background();
+            if (!writeFrameImage("output/" + outBg, meanBg))
+                throw std::runtime_error("Cannot write background: output/" + outBg);
+        } catch (std::exception &e) {
+            std::cerr << "Error generating outputs: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+    MPI_Bcast(meanBg.ptr<uchar>(), meta.height * meta.width, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    return 0;
+}
+
+// Percentile background over contiguous blocks. The exact engine decodes each
+// block twice (coarse, then fine histograms), and reduce-scatters the
+// histograms so every rank picks the percentile for its own band of rows. The
+// approximate engine decodes once and combines the per-rank streaming
+// estimates as a frame-weighted mean, through the same band reduction.
+static int percentileBackgroundPass(const std::string& inVid, const std::string& outBg,
+                                    const VideoMeta& meta, const std::vector<int>& keyframes,
+                                    const Options& opts, int rank, int size,
+                                    FrameRange& range, cv::Mat& background)
+{
+    range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    const int bandRows = BandExchange::bandRows(meta.height, size);
+    cv::Mat band8;
+    DecodeStats stats;
+    double wireMB = 0.0;
+
+    if (opts.engine == PercentileEngine::Approx) {
+        if (meta.totalFrames > MAX_U32_ACCUMULATED_FRAMES) {
+            if (rank == 0) std::cerr << "Too many frames for the approximate percentile engine\n";
+            return 1;
+        }
+        cv::Mat weighted = cv::Mat::zeros(bandRows * size, meta.width, CV_32S);
+        try {
+            cv::Mat estimate;
+            stats = approximatePercentile(inVid, range, cv::Size(meta.width, meta.height),
+                                          opts.percentile, estimate);
+            // Weighted by the frames each rank actually read
+            if (stats.framesDecoded > 0) {
+                cv::Mat rows = weighted.rowRange(0, meta.height);
+                estimate.convertTo(rows, CV_32S, stats.framesDecoded);
+            }
+        } catch (std::exception &e) {
+            std::cerr << "Rank " << rank << " error in approximate percentile: " << e.what() << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        int frames = stats.framesDecoded;
+        MPI_Allreduce(MPI_IN_PLACE, &frames, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        if (frames == 0) {
+            if (rank == 0) std::cerr << "Error: no frames could be read from " << inVid << "\n";
+            return 1;
+        }
+        cv::Mat band;
+        BandExchange::reduceScatter(weighted, band, MPI_UINT32_T, MPI_COMM_WORLD);
+        band8 = meanBackground(band, frames);
+        wireMB = 4.0 * weighted.total() / (1024.0 * 1024.0);
+    } else {
+        PixelHistogram hist(bandRows * size, meta.width);
+        cv::Mat bandTotals, coarseBand, fineBand;
+        try {
+            // Pass 1: coarse bins, merged per band, select each pixel's bin.
+            // The target rank counts the frames actually read.
+            DecodeStats coarseStats = accumulateHistogram(inVid, range, cv::Mat(), hist);
+            int frames = coarseStats.framesDecoded;
+            MPI_Allreduce(MPI_IN_PLACE, &frames, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+            if (frames == 0)
+                throw std::runtime_error("no frames could be read from " + inVid);
+            cv::Mat target(bandRows, meta.width, CV_32S, cv::Scalar(percentileRank(opts.percentile, frames)));
+            BandExchange::reduceScatter(hist.totals(), bandTotals, MPI_UINT32_T, MPI_COMM_WORLD);
+            selectHistogramBin(bandTotals, target, coarseBand);
+            cv::Mat coarse = BandExchange::allgather(coarseBand, meta.height, MPI_COMM_WORLD);
+
+            // Pass 2: fine bins inside the selected coarse bin
+            hist.reset();
+            stats = accumulateHistogram(inVid, range, coarse, hist);
+            BandExchange::reduceScatter(hist.totals(), bandTotals, MPI_UINT32_T, MPI_COMM_WORLD);
+            selectHistogramBin(bandTotals, target, fineBand);
+            stats.framesDecoded += coarseStats.framesDecoded;
+            stats.seeks += coarseStats.seeks;
+        } catch (std::exception &e) {
+            std::cerr << "Rank " << rank << " error in percentile histograms: " << e.what() << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // value = coarse * 16 + fine
+        cv::scaleAdd(coarseBand, PixelHistogram::BINS, fineBand, band8);
+        wireMB = 2.0 * 4.0 * hist.totals().total() / (1024.0 * 1024.0);
+    }
+
+    if (opts.decodeReport) {
+        reportDecodes(inVid, range, stats, meta.totalFrames, PartitionMode::Block, rank, size);
+        if (rank == 0)
+            std::cout << "Percentile " << opts.percentile << " ("
+                      << (opts.engine == PercentileEngine::Approx ? "approximate" : "exact histogram")
+                      << "), " << wireMB << " MB reduce-scattered per rank\n";
+    }
+
+    background = BandExchange::allgather(band8, meta.height, MPI_COMM_WORLD);
+    return publishBackground(background, outBg, rank);
+}
+
+// Gaussian-mixture mode. Every pixel's mixture depends on all earlier frames,
+// so the work is split by space instead of time: each rank owns a band of
+// rows for the whole video. Rank 0 decodes every frame once and scatters the
+// bands; each rank classifies and updates its band, and rank 0 gathers the
+// band masks and writes them in frame order.
+static int runMixture(const std::string& inVid, const std::string& outBg,
+                      const std::string& outFg, const VideoMeta& meta,
+                      const Options& opts, int rank, int size)
+{
+    const BandExchange::RowBand band = BandExchange::ownedBand(meta.height, rank, size);
+    std::vector<int> counts(size), displs(size);
+    for (int r = 0; r < size; ++r) {
+        BandExchange::RowBand b = BandExchange::ownedBand(meta.height, r, size);
+        counts[r] = b.rows() * meta.width;
+        displs[r] = b.begin * meta.width;
+    }
+
+    std::string finalFg = "output/" + outFg;
+    std::unique_ptr<FrameSource> src;
+    std::unique_ptr<MaskWriter> writer;
+    int status = 0;
+    if (rank == 0) {
+        try {
+            src = std::make_unique<FrameSource>(inVid);
+            writer = std::make_unique<MaskWriter>(finalFg, meta.fps, cv::Size(meta.width, meta.height));
+        } catch (std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+
+    // The rank's thread team splits the band's rows inside the model
+    std::unique_ptr<MixtureBackground> model;
+    try {
+        model = std::make_unique<MixtureBackground>(band.rows(), meta.width, opts.mixture);
+    } catch (std::exception &e) {
+        if (rank == 0) std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    cv::Mat frame, grayBuf(rank == 0 ? meta.height : 0, meta.width, CV_8U), gray;
+    cv::Mat mask(rank == 0 ? meta.height : 0, meta.width, CV_8U);
+    cv::Mat bandGray(band.rows(), meta.width, CV_8U), bandMask(band.rows(), meta.width, CV_8U);
+    std::vector<int> fgCounts;
+    double modelSeconds = 0.0;
+    int frames = 0;
+    while (true) {
+        int more = 0;
+        if (rank == 0) {
+            more = src->read(frame);
+            if (more)
+                gray = src->luma(frame, grayBuf);
+        }
+        MPI_Bcast(&more, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!more) break;
+
+        {
+            Profiler::Scope scope("scatter");
+            MPI_Scatterv(gray.data, counts.data(), displs.data(), MPI_UNSIGNED_CHAR,
+                         bandGray.data, counts[rank], MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+        }
+        int fg = 0;
+        if (band.rows() > 0) {
+            Profiler::Scope scope("model");
+            double t0 = MPI_Wtime();
+            model->apply(bandGray, bandMask, &fg);
+            modelSeconds += MPI_Wtime() - t0;
+        }
+        {
+            Profiler::Scope scope("gather");
+            MPI_Gatherv(bandMask.data, counts[rank], MPI_UNSIGNED_CHAR,
+                        mask.data, counts.data(), displs.data(), MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+        }
+        if (!opts.motionCsv.empty()) {
+            int total = 0;
+            MPI_Reduce(&fg, &total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+            if (rank == 0) fgCounts.push_back(total);
+        }
+        if (rank == 0)
+            writer->write(mask);
+        ++frames;
+    }
+    if (rank == 0) {
+        src->release();
+        writer->release();
+    }
+
+    // Background image: mean of each pixel's heaviest component
+    cv::Mat bandBg(band.rows(), meta.width, CV_8U), background(rank == 0 ? meta.height : 0, meta.width, CV_8U);
+    if (band.rows() > 0 && frames > 0)
+        model->background(bandBg);
+    MPI_Gatherv(bandBg.data, counts[rank], MPI_UNSIGNED_CHAR,
+                background.data, counts.data(), displs.data(), MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    if (publishBackground(background, outBg, rank) != 0) return 1;
+
+    if (!opts.motionCsv.empty() && writeMotionStats(fgCounts, opts.motionCsv, meta, rank, size) != 0)
+        return 1;
+
+    // Model throughput is bounded by the slowest band
+    double slowest = 0.0;
+    MPI_Reduce(&modelSeconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        double fps = slowest > 0.0 ? frames / slowest : 0.0;
+        // Scaled by pixel count, not measured
+        double fps1080 = fps * meta.width * meta.height / (1920.0 * 1080.0);
+        std::cout << "Mixture model (K=" << opts.mixture.components << ", " << size << " bands): "
+                  << frames << " frames, " << fps << " frames/s, ~"
+                  << fps1080 << " frames/s at 1080p (estimated from the pixel count)\n";
+        std::cout << "Done (mixture) → output/" << outBg << ", output/" << outFg << "\n";
+    }
+    return 0;
+}
+
+// Threshold sweep: one background pass per model (as in a normal run), then
+// every rank sweeps its block of frames against all backgrounds and
+// thresholds in a single decode. Rank 0 gathers the per-frame counts into
+// <outFg>_sweep.csv; with sweepMasks each pair's masks are stitched into
+// outFg tagged with model and threshold.
+static int runSweep(const std::string& inVid, const std::string& outBg, const std::string& outFg,
+                    const VideoMeta& meta, const std::vector<int>& keyframes,
+                    const Options& opts, int rank, int size)
+{
+    std::vector<SweepModel> models = opts.sweepModels;
+    if (models.empty()) {
+        SweepModel m;
+        m.model = opts.model;
+        m.percentile = opts.percentile;
+        models.push_back(m);
+    }
+    std::vector<std::string> names;
+    std::vector<cv::Mat> backgrounds;
+    FrameRange range{0, 0};
+    {
+        Profiler::Scope scope("background_pass");
+        for (const SweepModel& m : models) {
+            Options modelOpts = opts;
+            modelOpts.model = m.model;
+            modelOpts.percentile = m.percentile;
+            cv::Mat background;
+            std::unique_ptr<LumaCache> cache;
+            const std::string bg = taggedPath(outBg, m.name());
+            int rc = (m.model == BackgroundModel::Percentile)
+                ? percentileBackgroundPass(inVid, bg, meta, keyframes, modelOpts, rank, size, range, background)
+                : meanBackgroundPass(inVid, bg, meta, keyframes, modelOpts, rank, size, range, background, cache);
+            if (rc != 0) return 1;
+            names.push_back(m.name());
+            backgrounds.push_back(background);
+        }
+    }
+
+    // Every pair's masks go to its own file, split into per-rank segments
+    range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    std::vector<std::string> finalFgs, segOuts;
+    if (opts.sweepMasks) {
+        for (const auto& name : names)
+            for (double t : opts.sweep) {
+                finalFgs.push_back("output/" + taggedPath(outFg, sweepTag(name, t)));
+                segOuts.push_back(size == 1 ? finalFgs.back() : segmentPath(finalFgs.back(), rank));
+            }
+    }
+    std::vector<int> counts;
+    int status = 0;
+    try {
+        Profiler::Scope scope("foreground_pass");
+        sweepForegroundSegment(inVid, backgrounds, range, meta.fps, opts.sweep, counts, segOuts);
+    } catch (std::exception &e) {
+        std::cerr << "Rank " << rank << " error in the sweep: " << e.what() << "\n";
+        status = 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+
+    std::vector<int> all = gatherCounts(counts, rank, size);
+    if (rank == 0) {
+        const std::string csv =
+            std::filesystem::path("output/" + taggedPath(outFg, "sweep")).replace_extension(".csv").string();
+        try {
+            writeSweepCsv(names, opts.sweep, all, csv, meta.width * meta.height);
+            printSweepSummary(names, opts.sweep, all, meta.width * meta.height, std::cout);
+            std::cout << "Sweep counts → " << csv << "\n";
+        } catch (std::exception &e) {
+            std::cerr << "Error generating outputs: " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    for (const auto& finalFg : finalFgs)
+        status = std::max(status, joinSegments(range, finalFg, meta, opts, rank, size));
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return status;
+}
+
+// Segments are cut at multiples of segmentFrames regardless of the rank
+// blocks, so one segment may straddle several ranks. Each rank sums its own
+// frames of the segments at its block edges (ownFirst, ownLast); a forward
+// pass along the ranks carries the sum of a split segment's frames left of
+// the block and a backward pass those right of it. Every rank thus gets the
+// complete sums of its edge segments without decoding its neighbours' frames.
+static void exchangeSegmentSums(const FrameRange& range, int totalFrames, int segmentFrames,
+                                cv::Size frameSize, const cv::Mat& ownFirst, const cv::Mat& ownLast,
+                                int rank, int size, cv::Mat& firstSum, cv::Mat& lastSum)
+{
+    enum { TAG_LEFT = 1, TAG_RIGHT };
+    // A block edge splits a segment unless it falls on a segment start or the video's ends
+    auto splits = [&](int frame) { return frame > 0 && frame < totalFrames && frame % segmentFrames != 0; };
+    const bool own = range.count() > 0;
+    const bool oneSegment = own && segmentOf(range.begin, segmentFrames, totalFrames).end >= range.end;
+    const int elems = frameSize.area();
+    cv::Mat left = cv::Mat::zeros(frameSize, CV_64F), right = cv::Mat::zeros(frameSize, CV_64F);
+
+    // Forward: frames [segment start, range.begin) from the lower ranks
+    if (rank > 0 && splits(range.begin))
+        MPI_Recv(left.ptr<double>(), elems, MPI_DOUBLE, rank - 1, TAG_LEFT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (rank + 1 < size && splits(range.end)) {
+        cv::Mat out = own ? ownLast.clone() : left;
+        if (own && oneSegment) out += left;
+        MPI_Send(out.ptr<double>(), elems, MPI_DOUBLE, rank + 1, TAG_LEFT, MPI_COMM_WORLD);
+    }
+    // Backward: frames [range.end, segment end) from the higher ranks
+    if (rank + 1 < size && splits(range.end))
+        MPI_Recv(right.ptr<double>(), elems, MPI_DOUBLE, rank + 1, TAG_RIGHT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (rank > 0 && splits(range.begin)) {
+        cv::Mat out = own ? ownFirst.clone() : right;
+        if (own && oneSegment) out += right;
+        MPI_Send(out.ptr<double>(), elems, MPI_DOUBLE, rank - 1, TAG_RIGHT, MPI_COMM_WORLD);
+    }
+
+    if (!own) return;
+    firstSum = ownFirst.clone();
+    firstSum += left;
+    if (oneSegment) {
+        firstSum += right;
+        lastSum = firstSum;
+    } else {
+        lastSum = ownLast.clone();
+        lastSum += right;
+    }
+}
+
+// Backgrounds that follow the scene: a sliding-window mean (opts.window) or
+// per-segment means (opts.segment). Every rank thresholds its own block of
+// frames. A sliding window needs up to window/2 frames past each block edge; they
+// are decoded by the rank itself, since shipping raw frames would cost the
+// neighbour the same decode. Segments that straddle blocks get their sums
+// through exchangeSegmentSums. The background of frame 0 goes to outBg.
+static int runWindowed(double thresh, const std::string& inVid,
+                       const std::string& outBg, const std::string& outFg,
+                       const VideoMeta& meta, const std::vector<int>& keyframes,
+                       const Options& opts, int rank, int size)
+{
+    FrameRange range = partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    const cv::Size frameSize(meta.width, meta.height);
+    std::string finalFg = "output/" + outFg;
+    std::string segOut  = (size == 1) ? finalFg : segmentPath(finalFg, rank);
+    int status = 0;
+
+    cv::Mat firstSum, lastSum;
+    if (opts.segment > 0) {
+        cv::Mat ownFirst, ownLast;
+        try {
+            Profiler::Scope scope("segment_sum");
+            if (range.count() > 0) {
+                const FrameRange first{ range.begin,
+                    std::min(range.end, segmentOf(range.begin, opts.segment, meta.totalFrames).end) };
+                const FrameRange last{
+                    std::max(range.begin, segmentOf(range.end - 1, opts.segment, meta.totalFrames).begin), range.end };
+                ownFirst = cv::Mat::zeros(frameSize, CV_64F);
+                computeLocalSum(inVid, first, ownFirst);
+                if (last.begin == first.begin) {
+                    ownLast = ownFirst;
+                } else {
+                    ownLast = cv::Mat::zeros(frameSize, CV_64F);
+                    computeLocalSum(inVid, last, ownLast);
+                }
+            }
+        } catch (std::exception &e) {
+            std::cerr << "Rank " << rank << " error summing segments: " << e.what() << "\n";
+            status = 1;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (status != 0) return 1;
+        Profiler::Scope scope("halo_exchange");
+        exchangeSegmentSums(range, meta.totalFrames, opts.segment, frameSize, ownFirst, ownLast,
+                            rank, size, firstSum, lastSum);
+    }
+
+    std::vector<int> fgCounts;
+    try {
+        Profiler::Scope scope("foreground_pass");
+        std::vector<int>* counts = opts.motionCsv.empty() ? nullptr : &fgCounts;
+        cv::Mat firstBg;
+        if (opts.window > 0)
+            windowForegroundSegment(inVid, range, meta.totalFrames, opts.window, meta.fps, thresh, segOut,
+                                    &firstBg, counts);
+        else
+            segmentedForegroundSegment(inVid, range, meta.totalFrames, opts.segment, meta.fps, thresh, segOut,
+                                       firstSum, lastSum, &firstBg, counts);
+        if (range.begin == 0 && range.count() > 0 && !writeFrameImage("output/" + outBg, firstBg))
+            throw std::runtime_error("Cannot write background: output/" + outBg);
+    } catch (std::exception &e) {
+        std::cerr << "Rank " << rank << " error generating foreground: " << e.what() << "\n";
+        status = 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+    if (!opts.motionCsv.empty() && writeMotionStats(fgCounts, opts.motionCsv, meta, rank, size) != 0)
+        return 1;
+
+    if (joinSegments(range, finalFg, meta, opts, rank, size) != 0)
+        return 1;
+    if (rank == 0)
+        std::cout << "Done (" << (opts.window > 0 ? "window of " + std::to_string(opts.window)
+                                                  : "segments of " + std::to_string(opts.segment))
+                  << " frames) → output/" << outBg << ", output/" << outFg << "\n";
+    return 0;
+}
+
+// Concatenate one string per rank on rank 0 (empty vector elsewhere)
+static std::vector<std::string> gatherStrings(const std::string& mine, int rank, int size)
+{
+    int length = static_cast<int>(mine.size());
+    std::vector<int> lengths(rank == 0 ? size : 0), offsets(rank == 0 ? size : 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::string all;
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; ++r) {
+            offsets[r] = total;
+            total += lengths[r];
+        }
+        all.resize(total);
+    }
+    MPI_Gatherv(mine.data(), length, MPI_CHAR,
+                &all[0], lengths.data(), offsets.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    std::vector<std::string> parts;
+    for (int r = 0; rank == 0 && r < size; ++r)
+        parts.push_back(all.substr(offsets[r], lengths[r]));
+    return parts;
+}
+
+// Collect every rank's timers and counters and write them on rank 0
+static int writeProfile(const Options& opts, int rank, int size)
+{
+    std::vector<std::string> summaries = gatherStrings(Profiler::summaryJson(rank), rank, size);
+    std::vector<std::string> events;
+    if (!opts.trace.empty())
+        events = gatherStrings(Profiler::traceEventsJson(rank), rank, size);
+    if (rank != 0) return 0;
+    try {
+        if (!opts.profile.empty()) {
+            Profiler::writeSummary(summaries, opts.profile);
+            std::cout << "Profile → " << opts.profile << "\n";
+        }
+        if (!opts.trace.empty()) {
+            Profiler::writeChromeTrace(events, opts.trace);
+            std::cout << "Trace → " << opts.trace << "\n";
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int runStages(double thresh, const std::string& inVid, const std::string& outBg,
+                     const std::string& outFg, int rank, int size, const Options& opts);
+
 /**
  * Entry point for the MPI-based background subtraction processor.
  * @param thresh   Threshold value for foreground detection.
@@ -13,6 +992,7 @@ namespace MPIProcessor {
  * @param outFg    Filename for the generated foreground video.
  * @param rank     MPI rank of this process.
  * @param size     Total number of MPI processes.
+ * @param opts     Partitioning and reporting options.
  * @return         Status code (0 = success, non-zero = error).
  */
 int run(double thresh,
@@ -20,7 +1000,31 @@ int run(double thresh,
         const std::string& outBg,
         const std::string& outFg,
         int rank,
-        int size)
+        int size,
+        const Options& opts)
+{
+    if (isStreamPath(inVid)) {
+        if (rank == 0)
+            std::cerr << "Error: stream inputs (stdin, FIFOs) are read by one process; use --backend seq or omp\n";
+        return 1;
+    }
+    // Start every rank's clock together so their timelines line up
+    const bool profiling = !opts.profile.empty() || !opts.trace.empty();
+    if (profiling) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        Profiler::enable(!opts.trace.empty());
+    }
+    setDecodeMode(opts.decode);
+    setRegionSpec(opts.region);
+    int rc = runStages(thresh, inVid, outBg, outFg, rank, size, opts);
+    if (profiling && writeProfile(opts, rank, size) != 0)
+        rc = 1;
+    return rc;
+}
+
+// The workflow behind run(): metadata, background pass, foreground pass
+static int runStages(double thresh, const std::string& inVid, const std::string& outBg,
+                     const std::string& outFg, int rank, int size, const Options& opts)
 {
     VideoMeta meta;
 
@@ -34,51 +1038,106 @@ int run(double thresh,
         }
     }
 
+    const FrameRegion& region = frameRegion();
+    if (rank == 0 && region.active())
+        std::cout << "Region: " << region.workSize().width << "x" << region.workSize().height
+                  << " work frame (" << 100.0 * region.areaRatio() << "% of the pixels"
+                  << (region.scale() > 1 ? ", 1/" + std::to_string(region.scale()) + " scale" : std::string())
+                  << ")\n";
+
+    // Hybrid layout: P ranks, each with a team of T threads
+    int threads = 1;
+#ifdef _OPENMP
+    if (opts.threads > 0)
+        omp_set_num_threads(opts.threads);
+    threads = omp_get_max_threads();
+#endif
+    if (rank == 0)
+        std::cout << "Layout: " << size << " ranks x " << threads << " threads\n";
+
     // Broadcast metadata from rank 0 to all other ranks
     MPI_Bcast(&meta.totalFrames, 1, MPI_INT,    0, MPI_COMM_WORLD);
     MPI_Bcast(&meta.fps,         1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     MPI_Bcast(&meta.width,       1, MPI_INT,    0, MPI_COMM_WORLD);
     MPI_Bcast(&meta.height,      1, MPI_INT,    0, MPI_COMM_WORLD);
 
-    // Initialize a local accumulator for this rank's frame subset
-    cv::Mat localSum = cv::Mat::zeros(meta.height, meta.width, CV_64F);
+    // Block boundaries: fixed GOP multiples, or keyframes probed by rank 0
+    std::vector<int> keyframes;
+    bool blocks = opts.partition == PartitionMode::Block || opts.singlePass ||
+                  opts.model == BackgroundModel::Percentile || opts.window > 0 || opts.segment > 0 ||
+                  !opts.sample.empty();
+    // Keyframe sampling needs the real keyframes (and aligns blocks to them)
+    if (blocks && (opts.gop != 0 || opts.sample.mode == SampleMode::Keyframes)) {
+        if (opts.gop > 0) {
+            for (int k = 0; k < meta.totalFrames; k += opts.gop)
+                keyframes.push_back(k);
+        } else {
+            if (rank == 0) {
+                try {
+                    keyframes = scanKeyframes(inVid);
+                } catch (std::exception &e) {
+                    std::cerr << "Keyframe scan failed, using unaligned blocks: " << e.what() << "\n";
+                }
+            }
+            broadcastInts(keyframes, rank);
+        }
+    }
+
+    if (!opts.sweep.empty())
+        return runSweep(inVid, outBg, outFg, meta, keyframes, opts, rank, size);
+    if (opts.window > 0 || opts.segment > 0)
+        return runWindowed(thresh, inVid, outBg, outFg, meta, keyframes, opts, rank, size);
+    if (opts.singlePass)
+        return runSinglePass(thresh, inVid, outBg, outFg, meta, keyframes, opts, rank, size);
+    if (opts.model == BackgroundModel::Mixture)
+        return runMixture(inVid, outBg, outFg, meta, opts, rank, size);
+
+    // Every rank ends up with the full 8-bit background for its foreground pass
+    FrameRange range{0, 0};
+    cv::Mat background;
+    std::unique_ptr<LumaCache> cache;
+    int rc;
+    {
+        Profiler::Scope scope("background_pass");
+        if (opts.model == BackgroundModel::Percentile)
+            rc = percentileBackgroundPass(inVid, outBg, meta, keyframes, opts, rank, size, range, background);
+        else if (!opts.checkpoint.empty())
+            rc = checkpointBackgroundPass(inVid, outBg, meta, keyframes, opts, rank, size, range, background);
+        else
+            rc = meanBackgroundPass(inVid, outBg, meta, keyframes, opts, rank, size, range, background, cache);
+    }
+    if (rc != 0) return 1;
+    int status = 0;
+
+    // Each rank thresholds its own contiguous frame range into a segment
+    FrameRange fgRange = (blocks || cache || !opts.checkpoint.empty())
+        ? range
+        : partitionFrames(meta.totalFrames, rank, size, opts.weights, keyframes);
+    std::string finalFg = "output/" + outFg;
+    std::string segOut  = (size == 1) ? finalFg : segmentPath(finalFg, rank);
+    std::vector<int> fgCounts;
     try {
-        // Each rank processes its share of frames to compute a per-pixel sum
-        computeLocalSum(inVid, rank, size, localSum);
+        Profiler::Scope scope("foreground_pass");
+        if (cache)
+            generateForegroundSegment(*cache, background, fgRange, meta.fps, thresh, segOut,
+                                      opts.motionCsv.empty() ? nullptr : &fgCounts);
+        else
+            generateForegroundSegment(inVid, background, fgRange, meta.fps, thresh, segOut,
+                                      opts.motionCsv.empty() ? nullptr : &fgCounts);
     } catch (std::exception &e) {
-        if (rank == 0) std::cerr << "Error in computeLocalSum: " << e.what() << "\n";
-        MPI_Abort(MPI_COMM_WORLD, 1);
-    }
-
-    // Prepare a matrix on rank 0 to collect the global sum
-    cv::Mat globalSum = cv::Mat::zeros(meta.height, meta.width, CV_64F);
-    // Sum up all localSum matrices into globalSum on rank 0
-    MPI_Reduce(localSum.ptr<double>(),         // send buffer
-               globalSum.ptr<double>(),        // receive buffer (only valid on root)
-               meta.height * meta.width,       // element count
-               MPI_DOUBLE,                     // data type
-               MPI_SUM,                        // operation
-               0,                              // root rank
-               MPI_COMM_WORLD);
-
-    // Rank 0 generates the final background and foreground outputs
-    if (rank == 0) {
-        try {
-            generateOutputs(
-                inVid,                // original video
-                globalSum,            // summed pixel values
-                meta.totalFrames,     // total number of frames
-                meta.fps,             // frames per second
-                thresh,               // threshold for foreground
-                "output/" + outBg,   // output path for background
-                "output/" + outFg    // output path for foreground
-            );
-            std::cout << "Done → output/" << outBg << ", output/" << outFg << "\n";
-        } catch (std::exception &e) {
-            std::cerr << "Error generating outputs: " << e.what() << "\n";
-            return 1;
-        }
+        std::cerr << "Rank " << rank << " error generating foreground: " << e.what() << "\n";
+        status = 1;
     }
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (status != 0) return 1;
+    if (!opts.motionCsv.empty() && writeMotionStats(fgCounts, opts.motionCsv, meta, rank, size) != 0)
+        return 1;
+
+    // Rank 0 stitches the non-empty segments in rank (= frame) order
+    if (joinSegments(fgRange, finalFg, meta, opts, rank, size) != 0)
+        return 1;
+    if (rank == 0)
+        std::cout << "Done → output/" << outBg << ", output/" << outFg << "\n";
 
     return 0;  // Success
 }
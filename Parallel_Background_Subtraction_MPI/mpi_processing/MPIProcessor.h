@@ -3,14 +3,132 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <mpi.h>
 #include <opencv2/opencv.hpp>
-#include "../utils/VideoProcessor.h"
+#include "../../core/VideoProcessor.h"
+#include "../../core/LocalBackend.h"
 
 namespace MPIProcessor {
 
+    // How frames of the accumulation pass are distributed over ranks
+    enum class PartitionMode {
+        RoundRobin,   // frame i → rank i % P (one seek per frame)
+        Block         // one contiguous block per rank (one seek per rank)
+    };
+
+    // How per-rank foreground segments are joined into the final video
+    enum class StitchMode {
+        Concat,       // ffmpeg stream copy, falls back to Merge if unavailable
+        Merge         // decode every segment and re-encode on rank 0
+    };
+
+    // How per-rank sums are combined into the background
+    enum class ReduceMode {
+        Root,         // MPI_Reduce of the full frame to rank 0, then broadcast
+        Scatter       // MPI_Reduce_scatter_block: each rank owns a band of rows
+    };
+
+    // Element type of the summed frames on the wire
+    enum class WireType {
+        F64,          // double sums
+        U32           // exact uint32 sums (falls back to F64 if they could overflow)
+    };
+
+    // Background models and percentile engines are shared with the local backends
+    using ::BackgroundModel;
+    using ::PercentileEngine;
+
+    // Sentinel for Options::gop: probe the container for real keyframes
+    static constexpr int GOP_AUTO = -1;
+
+    /**
+     * Tunables for MPIProcessor::run (defaults reproduce a plain run).
+     *
+     * partition     frame distribution strategy for computeLocalSum
+     * gop           block alignment: 0 = none, N = multiples of N, GOP_AUTO = keyframes
+     * weights       relative per-rank throughput (empty = equal blocks)
+     * decodeReport  print per-rank decode counts on rank 0
+     * stitch        how foreground segments are joined
+     * singlePass    skip the mean pass; threshold against a running background
+     * alpha         single-pass learning rate in [0, 1] (0 = cumulative running mean)
+     * warmup        single-pass frames used to seed the model before masks are emitted
+     * motionCsv     if set, per-frame foreground pixel counts are written here
+     * reduce        how the per-rank sums are combined
+     * wire          element type of the reduced sums
+     * model         background statistic (percentile forces block partitioning)
+     * percentile    percentile in [0, 100] for BackgroundModel::Percentile
+     * engine        exact histograms or single-pass approximation
+     * mixture       Gaussian-mixture tunables for BackgroundModel::Mixture
+     * threads       OpenMP threads per rank (0 = OpenMP default); the team
+     *               shares the rank's decode buffers and accumulator
+     * profile       if set, per-rank/per-thread stage timers and counters as JSON
+     * trace         if set, a Chrome trace timeline of every timed stage
+     * decode        BGR frames, or luma straight from the decoder where possible
+     * lumaCache     mean model: if set, decoded luma frames are stored in this
+     *               file (on a filesystem shared by all ranks) and reused by the
+     *               foreground pass and by later runs on the same video
+     * checkpoint    mean model: if set, rank 0 keeps the running sum in this
+     *               resumable file and only frames it lacks are decoded; sums
+     *               are reduced to rank 0 as doubles (reduce and wire ignored)
+     * checkpointEvery  frames per rank folded in between checkpoint saves
+     * sweep         if set, a threshold sweep: every threshold (and every
+     *               sweepModels background) is evaluated in one foreground decode
+     * sweepModels   sweep backgrounds (empty = model/percentile)
+     * sweepMasks    also write the masks of every sweep pair
+     * window        if set, each frame is compared with the mean of the
+     *               `window` frames around it (block partition; the frames
+     *               past each block edge are decoded as a halo; frames are
+     *               decoded three times once the window outgrows
+     *               WINDOW_RING_BYTES)
+     * segment       if set, each frame is compared with the mean of its run
+     *               of `segment` frames; ranks sharing a segment exchange
+     *               partial sums instead of decoding each other's frames
+     * region        ROIs and resolution to work at: frames are packed to the
+     *               region's work frame on decode, so sums, reductions and
+     *               thresholding shrink with the area; scale > 1 refines
+     *               coarse motion at full resolution (empty = whole frame)
+     * sample        mean model: build the background from every stride-th
+     *               frame, the keyframes, or adaptively; with a tolerance the
+     *               sample grows in rounds until no rank's estimate moves by
+     *               more, agreed with one MPI_Allreduce per round (block partition)
+     */
+    struct Options {
+        PartitionMode partition = PartitionMode::Block;
+        int gop = 0;
+        std::vector<double> weights;
+        bool decodeReport = false;
+        StitchMode stitch = StitchMode::Concat;
+        bool singlePass = false;
+        double alpha = 0.0;
+        int warmup = 0;
+        std::string motionCsv;
+        ReduceMode reduce = ReduceMode::Scatter;
+        WireType wire = WireType::U32;
+        BackgroundModel model = BackgroundModel::Mean;
+        double percentile = 50.0;
+        PercentileEngine engine = PercentileEngine::Histogram;
+        MixtureParams mixture;
+        int threads = 0;
+        std::string profile;
+        std::string trace;
+        DecodeMode decode = DecodeMode::BGR;
+        std::string lumaCache;
+        std::string checkpoint;
+        int checkpointEvery = DEFAULT_CHECKPOINT_FRAMES;
+        std::vector<double> sweep;
+        std::vector<SweepModel> sweepModels;
+        bool sweepMasks = false;
+        int window = 0;
+        int segment = 0;
+        RegionSpec region;
+        SampleSpec sample;
+    };
+
     /**
      * Runs the entire background subtraction workflow under MPI.
+     * Every rank accumulates and thresholds its own frame range; rank 0
+     * writes the background and stitches the foreground segments.
      *
      * @param thresh   threshold for FG detection
      * @param inVid    path to input video
@@ -18,6 +136,7 @@ namespace MPIProcessor {
      * @param outFg    filename for foreground video (written to output/)
      * @param rank     MPI rank (0..P-1)
      * @param size     MPI size (P)
+     * @param opts     partitioning and reporting options
      * @returns        0 on success, non-zero on error
      */
     int run(double thresh,
@@ -25,6 +144,7 @@ namespace MPIProcessor {
             const std::string& outBg,
             const std::string& outFg,
             int rank,
-            int size);
+            int size,
+            const Options& opts = Options());
 
 } // namespace MPIProcessor
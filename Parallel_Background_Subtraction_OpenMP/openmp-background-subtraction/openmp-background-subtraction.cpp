@@ -1,110 +1,108 @@
 ﻿#include <iostream>
 #include <string>
-#include <vector>
 #include <filesystem>
 #include <chrono>
-#include <iomanip>
-#include <opencv2/opencv.hpp>
+#include <stdexcept>
 #include <omp.h>
+#include "../../core/LocalBackend.h"
 
 namespace fs = std::filesystem;
 
-int main() {
+// The OpenMP build runs the shared core pipeline with one OpenMP team:
+// decode overlapped with row-parallel accumulation for the background, and an
+// ordered decode -> threshold -> encode pipeline for the foreground masks.
+
+int main(int argc, char* argv[]) {
+    // Optional input video (default: the first .mp4 in ../input/), or a
+    // directory whose videos are all processed to output/<name>_bg.png, _fg.mp4
+    // Optional single-pass mode: --single-pass [--alpha A] [--warmup N]
+    // Optional percentile background: --model median | --percentile P [--engine hist|approx]
+    // Optional mixture model: --model mog [--mog-k K] [--mog-rate A]
+    // Optional threshold sweep, one foreground decode for all values:
+    //   --sweep T1,T2,... [--sweep-models mean,median,pNN] [--sweep-masks]
+    // Optional backgrounds for changing scenes: --window W (mean of the W
+    // surrounding frames) | --segment N (mean of each run of N frames)
+    // Optional region: --roi x,y,w,h (repeatable) | --roi-mask FILE, and
+    // --downscale N to detect at 1/N resolution and refine at full resolution
+    // Optional stream input (- for stdin, or a FIFO; needs --single-pass or
+    // --model mog): --stream y4m|gray|bgr [--stream-size WxH] [--stream-fps F]
+    // [--queue N] [--drop block|oldest|newest]
+    // Optional sampled mean background: --sample N (every N-th frame) |
+    // keyframes | adaptive, and --sample-tol T to stop once it converges
+    std::string input_path;
+    LocalOptions opts;
+    opts.threads = omp_get_max_threads();
+    try {
+        parseLocalOptions(argc, argv, opts, input_path);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "❌ " << ex.what() << "\n";
+        std::cerr << "Usage: " << argv[0] << " [input.mp4|input_dir] [--threshold T]"
+                  << " [--single-pass [--alpha A] [--warmup N]]"
+                  << " [--model mean|median|mog] [--percentile P] [--engine hist|approx]"
+                  << " [--mog-k K] [--mog-rate A]"
+                  << " [--sweep T1,T2,... [--sweep-models mean,median,pNN] [--sweep-masks]]"
+                  << " [--window W | --segment N]"
+                  << " [--roi x,y,w,h]... [--roi-mask FILE] [--downscale N]"
+                  << " [--stream y4m|gray|bgr [--stream-size WxH] [--stream-fps F]]"
+                  << " [--queue N] [--drop block|oldest|newest]"
+                  << " [--sample N|keyframes|adaptive [--sample-tol T]]\n";
+        return -1;
+    }
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
     // === Dynamically detect any .mp4 file inside the input directory ===
-    std::string video_path = "C:/Users/sarah/Documents/SENIOR-2/SEMESTER-10/HPC/openmp-background-subtraction/input/";
-    std::string inputPath;
-    for (const auto& entry : fs::directory_iterator(video_path)) {
-        if (entry.path().extension() == ".mp4") {
-            inputPath = entry.path().string();
-            break;
+    if (input_path.empty()) {
+        for (const auto& entry : fs::directory_iterator("../input/")) {
+            if (entry.path().extension() == ".mp4") {
+                input_path = entry.path().string();
+                break;
+            }
         }
     }
-
-    if (inputPath.empty()) {
-        throw std::runtime_error("No .mp4 file found in input folder!");
+    if (input_path.empty()) {
+        std::cerr << "❌ No .mp4 file found in input folder!\n";
+        return -1;
     }
 
     std::string output_folder = "output";
     fs::create_directories(output_folder);
-
-    // === OpenCV video capture ===
-    cv::VideoCapture cap(inputPath);
-    if (!cap.isOpened()) {
-        std::cerr << "❌ Cannot open input video!\n";
-        return -1;
+    std::cout << "Using OpenMP with " << opts.threads << " threads.\n";
+
+    if (fs::is_directory(input_path)) {
+        // One video after another, each with the whole team
+        int failed = 0;
+        const std::vector<std::string> videos = listVideos(input_path);
+        for (size_t v = 0; v < videos.size(); ++v) {
+            const std::string& video = videos[v];
+            std::string stem = outputStem(videos, v);
+            try {
+                runLocal(video, output_folder + "/" + stem + "_bg.png", output_folder + "/" + stem + "_fg.mp4", opts);
+                std::cout << "✅ " << stem << "\n";
+            }
+            catch (const std::exception& ex) {
+                std::cerr << "❌ " << stem << ": " << ex.what() << "\n";
+                ++failed;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+        std::cout << "🕒 Total processing time: " << elapsed.count() << " seconds.\n";
+        return failed == 0 ? 0 : -1;
     }
 
-    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
-    int width = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
-    int height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
-    double fps = cap.get(cv::CAP_PROP_FPS);
-
-    std::cout << "Using OpenMP with " << omp_get_max_threads() << " threads.\n";
-    std::cout << "Total video frames: " << total_frames << ", FPS: " << fps << "\n";
-
-    // === STEP 1: Background Accumulation (Sequential) ===
-    // This part is still sequential due to OpenCV's VideoCapture not being thread-safe.
-    // We read frames, convert to grayscale, and sum them to compute the mean background.
-    cv::Mat background_sum = cv::Mat::zeros(height, width, CV_64F);
-    std::vector<cv::Mat> gray_frames;
-
-    while (true) {
-        cv::Mat frame, gray;
-        cap >> frame;
-        if (frame.empty()) break;
-
-        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-        gray_frames.push_back(gray.clone());
-
-        cv::Mat gray64f;
-        gray.convertTo(gray64f, CV_64F);
-        background_sum += gray64f;
+    try {
+        runLocal(input_path, output_folder + "/background.png", output_folder + "/foreground.mp4", opts);
     }
-    cap.release();
-
-    int actual_frames = gray_frames.size();
-    cv::Mat background;
-    background_sum.convertTo(background, CV_8U, 1.0 / actual_frames);
-    cv::imwrite(output_folder + "/estimated_background.jpg", background);
-    std::cout << "✅ Saved background image\n";
-
-    // === STEP 2: Foreground Mask Computation (Parallel) ===
-    // We parallelize the loop using OpenMP. Each thread processes one frame:
-    // - Compute the absolute difference between frame and background.
-    // - Apply thresholding to generate the binary foreground mask.
-    // NOTE: Video writing is kept in a critical section due to OpenCV's thread-unsafety.
-    double adjusted_fps = 3.0;
-    cv::VideoWriter writer(output_folder + "/foreground.mp4",
-        cv::VideoWriter::fourcc('m', 'p', '4', 'v'), adjusted_fps, cv::Size(width, height), false);
-
-    if (!writer.isOpened()) {
-        std::cerr << "❌ Failed to open output video!\n";
+    catch (const std::exception& ex) {
+        std::cerr << "❌ " << ex.what() << "\n";
         return -1;
     }
 
-    // === OpenMP parallel loop for foreground computation ===
-#pragma omp parallel for
-    for (int i = 0; i < actual_frames; ++i) {
-        if (gray_frames[i].empty()) continue;
-
-        cv::Mat frame_gray = gray_frames[i];
-        cv::Mat diff, mask;
-
-        cv::absdiff(frame_gray, background, diff);
-        cv::threshold(diff, mask, 30, 255, cv::THRESH_BINARY);
-
-        // Writing must be serialized due to shared resource (writer)
-#pragma omp critical
-        writer.write(mask);
-    }
-
-    writer.release();
-
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end_time - start_time;
 
+    std::cout << "✅ Background written to: " << output_folder << "/background.png\n";
     std::cout << "✅ Foreground video written to: " << output_folder << "/foreground.mp4\n";
     std::cout << "🕒 Total processing time: " << elapsed.count() << " seconds.\n";
 
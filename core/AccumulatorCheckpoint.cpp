@@ -0,0 +1,298 @@
+#include "AccumulatorCheckpoint.h"
+#include "VideoProcessor.h"
+#include "FrameSource.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+constexpr char MAGIC[8] = "BGACC1";
+constexpr uint32_t VERSION = 2;           // 2: sources carry size and hash
+// Bounds on the coverage table read back from a file
+constexpr uint32_t MAX_SOURCE_NAME = 4096;
+constexpr uint32_t MAX_SOURCE_RANGES = 1u << 20;
+// Bytes hashed at each end of a source video
+constexpr size_t IDENTITY_BYTES = 1 << 20;
+
+using Ranges = std::vector<std::pair<int, int>>;
+
+// True if [begin, end) shares a frame with any of the sorted ranges
+bool overlaps(const Ranges &ranges, int begin, int end) {
+    auto it = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(begin, begin));
+    if (it != ranges.end() && it->first < end) return true;
+    return it != ranges.begin() && std::prev(it)->second > begin;
+}
+
+template <typename T>
+void put(std::ofstream &out, const T &v) {
+    out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename T>
+T get(std::ifstream &in) {
+    T v{};
+    in.read(reinterpret_cast<char *>(&v), sizeof(v));
+    return v;
+}
+
+} // namespace
+
+CheckpointSource checkpointSource(const std::string &path) {
+    CheckpointSource s;
+    s.name = std::filesystem::path(path).filename().string();
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Cannot read video: " + path);
+    in.seekg(0, std::ios::end);
+    s.size = static_cast<uint64_t>(in.tellg());
+
+    // FNV-1a over the first and the last IDENTITY_BYTES (the whole file if shorter)
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> buf(IDENTITY_BYTES);
+    auto mix = [&](uint64_t offset, size_t bytes) {
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(buf.data(), static_cast<std::streamsize>(bytes));
+        for (std::streamsize i = 0; i < in.gcount(); ++i) {
+            hash ^= static_cast<unsigned char>(buf[static_cast<size_t>(i)]);
+            hash *= 1099511628211ull;
+        }
+        in.clear();
+    };
+    const size_t head = static_cast<size_t>(std::min<uint64_t>(s.size, IDENTITY_BYTES));
+    mix(0, head);
+    if (s.size > head)
+        mix(std::max<uint64_t>(head, s.size - IDENTITY_BYTES), IDENTITY_BYTES);
+    s.hash = hash;
+    return s;
+}
+
+AccumulatorCheckpoint::AccumulatorCheckpoint(cv::Size size)
+    : sum_(cv::Mat::zeros(size, CV_64F)), decode_(static_cast<uint32_t>(decodeMode())) {
+    if (size.width <= 0 || size.height <= 0)
+        throw std::invalid_argument("Checkpoint needs a non-empty frame size");
+}
+
+void AccumulatorCheckpoint::checkIdentity(const CheckpointSource &source) const {
+    auto it = sources_.find(source.name);
+    if (it != sources_.end() && !it->second.sameVideo(source))
+        throw std::runtime_error("The checkpoint holds frames of a different video named " + source.name +
+                                 " (size or content changed)");
+}
+
+void AccumulatorCheckpoint::cover(const std::string &source, int begin, int end) {
+    Ranges &ranges = coverage_[source];
+    ranges.insert(std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(begin, end)),
+                  std::make_pair(begin, end));
+    // Coalesce touching neighbours so the table stays small
+    Ranges merged;
+    for (const auto &r : ranges) {
+        if (!merged.empty() && merged.back().second == r.first)
+            merged.back().second = r.second;
+        else
+            merged.push_back(r);
+    }
+    ranges.swap(merged);
+}
+
+void AccumulatorCheckpoint::add(const CheckpointSource &source, const FrameRange &range, const cv::Mat &sum) {
+    if (range.count() <= 0)
+        return;
+    if (sum.size() != size())
+        throw std::invalid_argument("Checkpoint frame size does not match the summed frames");
+    checkIdentity(source);
+    auto it = coverage_.find(source.name);
+    if (it != coverage_.end() && overlaps(it->second, range.begin, range.end))
+        throw std::invalid_argument("Frames [" + std::to_string(range.begin) + ", " +
+                                    std::to_string(range.end) + ") of " + source.name +
+                                    " are already in the checkpoint");
+    if (sum.type() == CV_32S) {
+        // uint32 sums do not fit CV_32S arithmetic
+        for (int y = 0; y < sum.rows; ++y) {
+            const uint32_t *s = reinterpret_cast<const uint32_t *>(sum.ptr<int>(y));
+            double *d = sum_.ptr<double>(y);
+            for (int x = 0; x < sum.cols; ++x)
+                d[x] += s[x];
+        }
+    } else {
+        sum_ += sum;
+    }
+    frames_ += range.count();
+    sources_[source.name] = source;
+    cover(source.name, range.begin, range.end);
+}
+
+void AccumulatorCheckpoint::merge(const AccumulatorCheckpoint &other) {
+    if (other.empty())
+        return;
+    if (empty()) {
+        *this = other;
+        sum_ = other.sum_.clone();
+        return;
+    }
+    if (other.size() != size() || other.decode_ != decode_)
+        throw std::invalid_argument("Checkpoints differ in frame size or decode mode");
+    for (const auto &[name, source] : other.sources_) {
+        auto it = sources_.find(name);
+        if (it != sources_.end() && !it->second.sameVideo(source))
+            throw std::invalid_argument("Checkpoints hold different videos named " + name);
+    }
+    for (const auto &[source, ranges] : other.coverage_) {
+        auto it = coverage_.find(source);
+        if (it == coverage_.end()) continue;
+        for (const auto &r : ranges)
+            if (overlaps(it->second, r.first, r.second))
+                throw std::invalid_argument("Checkpoints both cover frames [" + std::to_string(r.first) +
+                                            ", " + std::to_string(r.second) + ") of " + source);
+    }
+    sum_ += other.sum_;
+    frames_ += other.frames_;
+    for (const auto &[source, ranges] : other.coverage_)
+        for (const auto &r : ranges)
+            cover(source, r.first, r.second);
+    sources_.insert(other.sources_.begin(), other.sources_.end());
+}
+
+std::vector<FrameRange> AccumulatorCheckpoint::missing(const CheckpointSource &source, int totalFrames) const {
+    checkIdentity(source);
+    std::vector<FrameRange> gaps;
+    int next = 0;
+    auto it = coverage_.find(source.name);
+    if (it != coverage_.end()) {
+        for (const auto &r : it->second) {
+            if (r.first >= totalFrames) break;
+            if (r.first > next) gaps.push_back({next, r.first});
+            next = std::max(next, r.second);
+        }
+    }
+    if (next < totalFrames)
+        gaps.push_back({next, totalFrames});
+    return gaps;
+}
+
+cv::Mat AccumulatorCheckpoint::background() const {
+    if (frames_ <= 0)
+        throw std::runtime_error("Checkpoint holds no frames");
+    if (frames_ > std::numeric_limits<int>::max())
+        throw std::runtime_error("Checkpoint frame count exceeds the supported range");
+    return meanBackground(sum_, static_cast<int>(frames_));
+}
+
+void AccumulatorCheckpoint::save(const std::string &path) const {
+    if (empty())
+        throw std::invalid_argument("Cannot save an empty checkpoint");
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Cannot write checkpoint: " + tmp);
+        out.write(MAGIC, sizeof(MAGIC));
+        put(out, VERSION);
+        put(out, decode_);
+        put(out, static_cast<int32_t>(sum_.cols));
+        put(out, static_cast<int32_t>(sum_.rows));
+        put(out, frames_);
+        put(out, static_cast<uint32_t>(coverage_.size()));
+        for (const auto &[source, ranges] : coverage_) {
+            const CheckpointSource &id = sources_.at(source);
+            put(out, static_cast<uint32_t>(source.size()));
+            out.write(source.data(), static_cast<std::streamsize>(source.size()));
+            put(out, id.size);
+            put(out, id.hash);
+            put(out, static_cast<uint32_t>(ranges.size()));
+            for (const auto &r : ranges) {
+                put(out, static_cast<int32_t>(r.first));
+                put(out, static_cast<int32_t>(r.second));
+            }
+        }
+        for (int y = 0; y < sum_.rows; ++y)
+            out.write(reinterpret_cast<const char *>(sum_.ptr<double>(y)),
+                      static_cast<std::streamsize>(sum_.cols * sizeof(double)));
+        out.flush();
+        if (!out)
+            throw std::runtime_error("Cannot write checkpoint: " + tmp);
+    }
+    std::filesystem::rename(tmp, path);
+}
+
+AccumulatorCheckpoint AccumulatorCheckpoint::open(const std::string &path, cv::Size size) {
+    if (!std::filesystem::exists(path))
+        return AccumulatorCheckpoint(size);
+    AccumulatorCheckpoint ckpt = load(path);
+    if (ckpt.size() != size)
+        throw std::runtime_error("Checkpoint " + path + " holds " + std::to_string(ckpt.size().width) + "x" +
+                                 std::to_string(ckpt.size().height) + " frames, the video is " +
+                                 std::to_string(size.width) + "x" + std::to_string(size.height));
+    if (ckpt.decode() != static_cast<uint32_t>(decodeMode()))
+        throw std::runtime_error("Checkpoint " + path + " was written with another --decode mode");
+    return ckpt;
+}
+
+AccumulatorCheckpoint AccumulatorCheckpoint::load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Cannot open checkpoint: " + path);
+    char magic[sizeof(MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not a background checkpoint: " + path);
+    if (get<uint32_t>(in) != VERSION)
+        throw std::runtime_error("Checkpoint " + path + " was written by another version; delete it and rerun");
+
+    AccumulatorCheckpoint ckpt;
+    ckpt.decode_ = get<uint32_t>(in);
+    const int32_t width = get<int32_t>(in), height = get<int32_t>(in);
+    ckpt.frames_ = get<int64_t>(in);
+    const uint32_t sources = get<uint32_t>(in);
+    if (!in || width <= 0 || height <= 0 || ckpt.frames_ < 0)
+        throw std::runtime_error("Malformed checkpoint header: " + path);
+    int64_t covered = 0;
+    for (uint32_t s = 0; s < sources && in; ++s) {
+        const uint32_t nameBytes = get<uint32_t>(in);
+        if (!in || nameBytes == 0 || nameBytes > MAX_SOURCE_NAME)
+            throw std::runtime_error("Malformed checkpoint source table: " + path);
+        CheckpointSource id;
+        id.name.resize(nameBytes);
+        in.read(id.name.data(), static_cast<std::streamsize>(nameBytes));
+        id.size = get<uint64_t>(in);
+        id.hash = get<uint64_t>(in);
+        const uint32_t count = get<uint32_t>(in);
+        if (!in || count > MAX_SOURCE_RANGES || ckpt.sources_.count(id.name))
+            throw std::runtime_error("Malformed checkpoint source table: " + path);
+        Ranges &ranges = ckpt.coverage_[id.name];
+        ranges.resize(count);
+        for (auto &r : ranges) {
+            r.first = get<int32_t>(in);
+            r.second = get<int32_t>(in);
+            // Sorted, disjoint and non-empty, as cover() keeps them
+            if (r.first < 0 || r.second <= r.first || (&r != ranges.data() && (&r - 1)->second > r.first))
+                throw std::runtime_error("Malformed checkpoint coverage: " + path);
+            covered += r.second - r.first;
+        }
+        ckpt.sources_[id.name] = id;
+    }
+    if (!in || covered != ckpt.frames_)
+        throw std::runtime_error("Checkpoint frame count does not match its coverage: " + path);
+
+    // The sums fill the rest of the file; check before allocating them
+    const std::streamoff start = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff remaining = in.tellg() - start;
+    in.seekg(start);
+    // Divided per row, since width * height * 8 can overflow for a corrupt header
+    const uint64_t rowBytes = static_cast<uint64_t>(width) * sizeof(double);
+    if (!in || start < 0 || remaining < 0 || static_cast<uint64_t>(remaining) % rowBytes != 0 ||
+        static_cast<uint64_t>(remaining) / rowBytes != static_cast<uint64_t>(height))
+        throw std::runtime_error("Checkpoint size does not match its " + std::to_string(width) + "x" +
+                                 std::to_string(height) + " frames: " + path);
+    ckpt.sum_.create(height, width, CV_64F);
+    for (int y = 0; y < height && in; ++y)
+        in.read(reinterpret_cast<char *>(ckpt.sum_.ptr<double>(y)),
+                static_cast<std::streamsize>(width * sizeof(double)));
+    if (!in)
+        throw std::runtime_error("Truncated checkpoint: " + path);
+    return ckpt;
+}
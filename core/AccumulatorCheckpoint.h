@@ -0,0 +1,98 @@
+#ifndef ACCUMULATOR_CHECKPOINT_H
+#define ACCUMULATOR_CHECKPOINT_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct FrameRange;
+
+// Persistent state of the mean-background accumulator: the per-pixel sum of
+// every frame folded in so far, the frame count, the decode mode the frames
+// were read with, and which frames of which source video they were.
+//
+// Sources are keyed by file name (not the full path), so checkpoints written
+// on different machines refer to the same video, and each carries the
+// video's identity (file size and a hash of its first and last MiB): frames
+// of a re-encoded or different video under the same name are refused rather
+// than mixed into the sums. Sums are kept as CV_64F
+// integers, which stay exact far beyond any realistic frame count. merge()
+// is therefore exact, associative and commutative. It refuses overlapping
+// coverage, because counting a frame twice would skew the mean.
+//
+// File layout (native byte order): 16-byte header ("BGACC1", version,
+// decode mode), width, height, frame count, the coverage table (name,
+// identity, ranges per source), then the sums row by row. save() writes a temporary file and renames it over the
+// old one, so a crash never leaves a torn checkpoint behind.
+// Default frames folded in between two saves
+constexpr int DEFAULT_CHECKPOINT_FRAMES = 1000;
+
+// A source video as a checkpoint knows it
+struct CheckpointSource {
+    std::string name;      // file name, the coverage key
+    uint64_t size = 0;     // file size in bytes
+    uint64_t hash = 0;     // FNV-1a of the first and last MiB
+
+    bool sameVideo(const CheckpointSource &o) const { return size == o.size && hash == o.hash; }
+};
+
+class AccumulatorCheckpoint {
+public:
+    AccumulatorCheckpoint() = default;
+    // Empty accumulator for frames of the given size, in the current decode mode
+    explicit AccumulatorCheckpoint(cv::Size size);
+
+    // Throws std::runtime_error if the file is missing or malformed
+    static AccumulatorCheckpoint load(const std::string &path);
+    void save(const std::string &path) const;
+    // load() if path exists, else an empty accumulator of the given size.
+    // Throws std::runtime_error if the file was written for another frame
+    // size or decode mode.
+    static AccumulatorCheckpoint open(const std::string &path, cv::Size size);
+
+    // Fold in the sum of frames [range) of source. sum is CV_64F, or CV_32S
+    // read as uint32 (as produced by computeLocalSum). Throws
+    // std::invalid_argument on a size mismatch or overlapping coverage, and
+    // std::runtime_error if the checkpoint holds another video of that name.
+    void add(const CheckpointSource &source, const FrameRange &range, const cv::Mat &sum);
+
+    // Fold in another checkpoint. Throws std::invalid_argument if the frame
+    // size or decode mode differ, if any frame is covered by both, or if they
+    // hold different videos under one name.
+    void merge(const AccumulatorCheckpoint &other);
+
+    // Frames of [0, totalFrames) of source that are not folded in yet.
+    // Throws std::runtime_error if the checkpoint was written for another
+    // video of the same name.
+    std::vector<FrameRange> missing(const CheckpointSource &source, int totalFrames) const;
+
+    // Mean of every frame folded in (CV_8U); throws if there are none
+    cv::Mat background() const;
+
+    bool empty() const { return sum_.empty(); }
+    cv::Size size() const { return sum_.size(); }
+    int64_t frames() const { return frames_; }
+    uint32_t decode() const { return decode_; }
+
+    // Covered frame ranges per source, sorted and disjoint
+    const std::map<std::string, std::vector<std::pair<int, int>>> &coverage() const { return coverage_; }
+
+private:
+    void cover(const std::string &source, int begin, int end);
+    // Throws if name is known with another identity
+    void checkIdentity(const CheckpointSource &source) const;
+
+    cv::Mat sum_;          // CV_64F
+    int64_t frames_ = 0;
+    uint32_t decode_ = 0;
+    std::map<std::string, std::vector<std::pair<int, int>>> coverage_;
+    std::map<std::string, CheckpointSource> sources_;
+};
+
+// Name and identity of a video file; throws std::runtime_error if it cannot
+// be read
+CheckpointSource checkpointSource(const std::string &path);
+
+#endif // ACCUMULATOR_CHECKPOINT_H
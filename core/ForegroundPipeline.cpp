@@ -0,0 +1,173 @@
+#include "ForegroundPipeline.h"
+#include "FrameKernels.h"
+#include "FrameSource.h"
+#include "Profiler.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+ForegroundPipeline::ForegroundPipeline(int slots, const cv::Mat &background, double threshold,
+                                       std::vector<int> *fgCounts)
+    : slots_(std::max(slots, 1)), background_(background), threshold_(threshold),
+      fgCounts_(fgCounts) {}
+
+int ForegroundPipeline::run(FrameSource &src, MaskWriter &writer, int threads,
+                            int maxFrames) {
+#ifdef _OPENMP
+    omp_set_dynamic(0);
+#pragma omp parallel num_threads(threads)
+    {
+        int tid = omp_get_thread_num();
+        // Exceptions must not leave the parallel region
+        try {
+            if (omp_get_num_threads() < 3) {
+                // Not enough threads for separate stages: run them back to back
+                if (tid == 0) runSerial(src, writer, maxFrames);
+            }
+            else if (tid == 0) decode(src, maxFrames);
+            else if (tid == 1) write(writer);
+            else compute(writer);
+        } catch (...) {
+            fail();
+        }
+    }
+    if (error_)
+        std::rethrow_exception(error_);
+#else
+    (void)threads;
+    runSerial(src, writer, maxFrames);
+#endif
+    return written_;
+}
+
+void ForegroundPipeline::fail() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+        stop_ = true;
+    }
+    changed_.notify_all();
+}
+
+// Luma of a decoded frame into the slot's own buffer; decoder luma is copied
+// out because the decode buffer is reused for the next frame
+static void toGray(const FrameSource &src, const cv::Mat &frame, cv::Mat &gray) {
+    cv::Mat luma = src.luma(frame, gray);
+    if (luma.data != gray.data)
+        luma.copyTo(gray);
+}
+
+// Thresholded difference of one grayscale frame against the background,
+// encoded too when the writer is a mask stream. Full-frame stream masks are
+// thresholded into bits and encoded from them, with no byte mask at all.
+void ForegroundPipeline::computeMask(Slot &slot, const MaskWriter &writer) const {
+    int *count = fgCounts_ ? &slot.foreground : nullptr;
+    if (writer.isStream() && !writer.unpacksRegion()) {
+        {
+            Profiler::Scope scope("threshold");
+            thresholdDiffPacked(slot.gray, background_, threshold_, slot.bits, count);
+        }
+        Profiler::Scope scope("encode");
+        encodePackedMask(slot.bits, slot.gray.cols, slot.encoded);
+        return;
+    }
+    {
+        Profiler::Scope scope("threshold");
+        thresholdDiff(slot.gray, background_, threshold_, slot.mask, count);
+    }
+    if (writer.isStream()) {
+        const cv::Mat &full = writer.frameMask(slot.mask, slot.full);
+        Profiler::Scope scope("encode");
+        encodeMask(full, slot.encoded);
+    }
+}
+
+void ForegroundPipeline::decode(FrameSource &src, int maxFrames) {
+    cv::Mat frame;
+    int i = 0;
+    for (; (maxFrames < 0 || i < maxFrames) && src.read(frame); ++i) {
+        Slot &slot = slots_[i % slots_.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return slot.state == State::Free || stop_; });
+            if (stop_) return;
+        }
+        // The slot is exclusively ours until it is published as Decoded
+        toGray(src, frame, slot.gray);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.frame = i;
+            slot.state = State::Decoded;
+        }
+        changed_.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        total_ = i;
+    }
+    changed_.notify_all();
+}
+
+void ForegroundPipeline::compute(const MaskWriter &writer) {
+    while (true) {
+        int k;
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            k = nextCompute_++;
+            slot = &slots_[k % slots_.size()];
+            changed_.wait(lock, [&] {
+                return (slot->state == State::Decoded && slot->frame == k) || (total_ >= 0 && k >= total_) ||
+                       stop_;
+            });
+            if ((total_ >= 0 && k >= total_) || stop_) return;
+        }
+        computeMask(*slot, writer);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot->state = State::Computed;
+        }
+        changed_.notify_all();
+    }
+}
+
+void ForegroundPipeline::write(MaskWriter &writer) {
+    for (int w = 0;; ++w) {
+        Slot &slot = slots_[w % slots_.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] {
+                return (slot.state == State::Computed && slot.frame == w) || (total_ >= 0 && w >= total_) ||
+                       stop_;
+            });
+            if ((total_ >= 0 && w >= total_) || stop_) return;
+        }
+        if (writer.isStream())
+            writer.write(slot.encoded);
+        else
+            writer.write(slot.mask);
+        if (fgCounts_) fgCounts_->push_back(slot.foreground);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.state = State::Free;
+            ++written_;
+        }
+        changed_.notify_all();
+    }
+}
+
+void ForegroundPipeline::runSerial(FrameSource &src, MaskWriter &writer, int maxFrames) {
+    cv::Mat frame;
+    Slot &slot = slots_[0];
+    while ((maxFrames < 0 || written_ < maxFrames) && src.read(frame)) {
+        toGray(src, frame, slot.gray);
+        computeMask(slot, writer);
+        if (writer.isStream())
+            writer.write(slot.encoded);
+        else
+            writer.write(slot.mask);
+        if (fgCounts_) fgCounts_->push_back(slot.foreground);
+        ++written_;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef FOREGROUND_PIPELINE_H
+#define FOREGROUND_PIPELINE_H
+
+#include "MaskStream.h"
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+class FrameSource;
+
+// Frames in flight per worker thread; bounds the pipeline's peak memory.
+constexpr int SLOTS_PER_WORKER = 2;
+
+// Ordered, bounded decode -> threshold -> encode pipeline on an OpenMP team.
+//
+// Frame i always lives in ring slot i % N. The decoder refills a slot only
+// after the writer has emitted the frame that used it before, so at most N
+// frames are ever in memory. Workers finish frames in any order; the writer
+// drains slots strictly by frame index, which makes the ring double as the
+// reorder buffer. Without OpenMP (or with fewer than three threads) the
+// stages run back to back on the calling thread. For a mask stream the
+// workers also encode their frames, leaving the writer only the file I/O;
+// full-frame masks are then thresholded straight into bit-packed form.
+// The first exception thrown by any stage stops the others and is rethrown
+// from run().
+class ForegroundPipeline {
+public:
+    ForegroundPipeline(int slots, const cv::Mat &background, double threshold,
+                       std::vector<int> *fgCounts = nullptr);
+
+    // Reads up to maxFrames frames (all remaining if negative) from src,
+    // writes one mask per frame and returns the number written. Uses one
+    // decoder thread, one writer thread and the remaining threads as workers.
+    int run(FrameSource &src, MaskWriter &writer, int threads, int maxFrames = -1);
+
+private:
+    enum class State { Free, Decoded, Computed };
+
+    struct Slot {
+        cv::Mat gray, mask, full;       // full: mask unpacked from a frame region
+        cv::Mat bits;                   // packed mask (mask streams of full frames)
+        EncodedMask encoded;
+        int frame = -1;
+        int foreground = 0;
+        State state = State::Free;
+    };
+
+    void computeMask(Slot &slot, const MaskWriter &writer) const;
+    void decode(FrameSource &src, int maxFrames);
+    void compute(const MaskWriter &writer);
+    void write(MaskWriter &writer);
+    void runSerial(FrameSource &src, MaskWriter &writer, int maxFrames);
+    // Record the current exception (the first one wins) and wake every stage
+    void fail();
+
+    std::vector<Slot> slots_;
+    const cv::Mat &background_;
+    double threshold_;
+    std::vector<int> *fgCounts_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    int nextCompute_ = 0;   // next frame index a worker will claim
+    int total_ = -1;        // frame count, known once the decoder hits the end
+    int written_ = 0;
+    bool stop_ = false;     // a stage failed; every stage returns
+    std::exception_ptr error_;
+};
+
+#endif // FOREGROUND_PIPELINE_H
@@ -0,0 +1,539 @@
+#include "FrameKernels.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Fixed-point luma weights: gray = (b*B + g*G + r*R + 2^(shift-1)) >> shift
+struct LumaCoeffs {
+    int b, g, r, shift;
+};
+
+// OpenCV has shipped both a 14-bit and a 15-bit fixed-point BGR2GRAY
+constexpr LumaCoeffs LUMA_CANDIDATES[] = {
+    { 3735, 19235, 9798, 15 },
+    { 1868,  9617, 4899, 14 },
+};
+
+// ---------------------------------------------------------------------------
+// Row kernels: acc[i] += luma(src[3i..3i+2]) for n pixels
+// ---------------------------------------------------------------------------
+
+void addLumaRowScalar(const uchar *src, uint32_t *acc, int n, const LumaCoeffs &c, int i = 0) {
+    const int round = 1 << (c.shift - 1);
+    for (; i < n; ++i, src += 3)
+        acc[i] += static_cast<uint32_t>((src[0] * c.b + src[1] * c.g + src[2] * c.r + round) >> c.shift);
+}
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+// Split 16 interleaved BGR pixels (48 bytes) into B, G and R planes
+inline void deinterleave16(const uchar *src, __m128i &b, __m128i &g, __m128i &r) {
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+    const __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+    b = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    r = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+#endif
+
+#if defined(__AVX2__)
+void addLumaRow(const uchar *src, uint32_t *acc, int n, const LumaCoeffs &c) {
+    // (b, g) pairs and (r, 1) pairs feed _mm256_madd_epi16; the 1 carries the rounding term
+    const __m256i wbg = _mm256_set1_epi32((c.g << 16) | c.b);
+    const __m256i wr1 = _mm256_set1_epi32(((1 << (c.shift - 1)) << 16) | c.r);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m128i shift = _mm_cvtsi32_si128(c.shift);
+    int i = 0;
+    for (; i + 16 <= n; i += 16, src += 48) {
+        __m128i b8, g8, r8;
+        deinterleave16(src, b8, g8, r8);
+        const __m256i b = _mm256_cvtepu8_epi16(b8);
+        const __m256i g = _mm256_cvtepu8_epi16(g8);
+        const __m256i r = _mm256_cvtepu8_epi16(r8);
+        // In-lane unpacks: lo holds pixels 0-3 | 8-11, hi holds 4-7 | 12-15
+        __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(b, g), wbg),
+                                      _mm256_madd_epi16(_mm256_unpacklo_epi16(r, one), wr1));
+        __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(b, g), wbg),
+                                      _mm256_madd_epi16(_mm256_unpackhi_epi16(r, one), wr1));
+        lo = _mm256_srl_epi32(lo, shift);
+        hi = _mm256_srl_epi32(hi, shift);
+        __m256i *dst = reinterpret_cast<__m256i *>(acc + i);
+        _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst),
+                                                  _mm256_permute2x128_si256(lo, hi, 0x20)));
+        _mm256_storeu_si256(dst + 1, _mm256_add_epi32(_mm256_loadu_si256(dst + 1),
+                                                      _mm256_permute2x128_si256(lo, hi, 0x31)));
+    }
+    addLumaRowScalar(src, acc, n, c, i);
+}
+
+void addGrayRow(const uchar *src, uint32_t *acc, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+        __m256i *dst = reinterpret_cast<__m256i *>(acc + i);
+        _mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst), v));
+    }
+    for (; i < n; ++i) acc[i] += src[i];
+}
+
+#elif defined(__SSSE3__)
+void addLumaRow(const uchar *src, uint32_t *acc, int n, const LumaCoeffs &c) {
+    const __m128i wbg = _mm_set1_epi32((c.g << 16) | c.b);
+    const __m128i wr1 = _mm_set1_epi32(((1 << (c.shift - 1)) << 16) | c.r);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i shift = _mm_cvtsi32_si128(c.shift);
+    int i = 0;
+    for (; i + 16 <= n; i += 16, src += 48) {
+        __m128i b8, g8, r8;
+        deinterleave16(src, b8, g8, r8);
+        const __m128i b[2] = { _mm_unpacklo_epi8(b8, zero), _mm_unpackhi_epi8(b8, zero) };
+        const __m128i g[2] = { _mm_unpacklo_epi8(g8, zero), _mm_unpackhi_epi8(g8, zero) };
+        const __m128i r[2] = { _mm_unpacklo_epi8(r8, zero), _mm_unpackhi_epi8(r8, zero) };
+        __m128i *dst = reinterpret_cast<__m128i *>(acc + i);
+        for (int h = 0; h < 2; ++h) {
+            __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b[h], g[h]), wbg),
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(r[h], one), wr1));
+            __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b[h], g[h]), wbg),
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(r[h], one), wr1));
+            _mm_storeu_si128(dst + 2 * h,     _mm_add_epi32(_mm_loadu_si128(dst + 2 * h),     _mm_srl_epi32(lo, shift)));
+            _mm_storeu_si128(dst + 2 * h + 1, _mm_add_epi32(_mm_loadu_si128(dst + 2 * h + 1), _mm_srl_epi32(hi, shift)));
+        }
+    }
+    addLumaRowScalar(src, acc, n, c, i);
+}
+
+void addGrayRow(const uchar *src, uint32_t *acc, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i w[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+        __m128i *dst = reinterpret_cast<__m128i *>(acc + i);
+        for (int h = 0; h < 2; ++h) {
+            _mm_storeu_si128(dst + 2 * h,     _mm_add_epi32(_mm_loadu_si128(dst + 2 * h),     _mm_unpacklo_epi16(w[h], zero)));
+            _mm_storeu_si128(dst + 2 * h + 1, _mm_add_epi32(_mm_loadu_si128(dst + 2 * h + 1), _mm_unpackhi_epi16(w[h], zero)));
+        }
+    }
+    for (; i < n; ++i) acc[i] += src[i];
+}
+
+#elif defined(__ARM_NEON)
+void addLumaRow(const uchar *src, uint32_t *acc, int n, const LumaCoeffs &c) {
+    const uint32x4_t round = vdupq_n_u32(1u << (c.shift - 1));
+    const int32x4_t shift = vdupq_n_s32(-c.shift);
+    int i = 0;
+    for (; i + 16 <= n; i += 16, src += 48) {
+        const uint8x16x3_t px = vld3q_u8(src);   // val[0] = B, val[1] = G, val[2] = R
+        const uint16x8_t b[2] = { vmovl_u8(vget_low_u8(px.val[0])), vmovl_u8(vget_high_u8(px.val[0])) };
+        const uint16x8_t g[2] = { vmovl_u8(vget_low_u8(px.val[1])), vmovl_u8(vget_high_u8(px.val[1])) };
+        const uint16x8_t r[2] = { vmovl_u8(vget_low_u8(px.val[2])), vmovl_u8(vget_high_u8(px.val[2])) };
+        for (int h = 0; h < 2; ++h) {
+            uint32x4_t lo = vmlal_n_u16(vmlal_n_u16(vmlal_n_u16(round, vget_low_u16(b[h]), c.b),
+                                                    vget_low_u16(g[h]), c.g), vget_low_u16(r[h]), c.r);
+            uint32x4_t hi = vmlal_n_u16(vmlal_n_u16(vmlal_n_u16(round, vget_high_u16(b[h]), c.b),
+                                                    vget_high_u16(g[h]), c.g), vget_high_u16(r[h]), c.r);
+            uint32_t *dst = acc + i + 8 * h;
+            vst1q_u32(dst,     vaddq_u32(vld1q_u32(dst),     vshlq_u32(lo, shift)));
+            vst1q_u32(dst + 4, vaddq_u32(vld1q_u32(dst + 4), vshlq_u32(hi, shift)));
+        }
+    }
+    addLumaRowScalar(src, acc, n, c, i);
+}
+
+void addGrayRow(const uchar *src, uint32_t *acc, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+        vst1q_u32(acc + i,     vaddw_u16(vld1q_u32(acc + i),     vget_low_u16(v)));
+        vst1q_u32(acc + i + 4, vaddw_u16(vld1q_u32(acc + i + 4), vget_high_u16(v)));
+    }
+    for (; i < n; ++i) acc[i] += src[i];
+}
+
+#else
+void addLumaRow(const uchar *src, uint32_t *acc, int n, const LumaCoeffs &c) {
+    addLumaRowScalar(src, acc, n, c);
+}
+
+void addGrayRow(const uchar *src, uint32_t *acc, int n) {
+    for (int i = 0; i < n; ++i) acc[i] += src[i];
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Row kernels: foreground test |a - b| >= t1 (t1 = floor(threshold) + 1, 1..255)
+// ---------------------------------------------------------------------------
+
+inline int popcount32(uint32_t v) {
+#if defined(__GNUC__)
+    return __builtin_popcount(v);
+#else
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return static_cast<int>((((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#endif
+}
+
+inline int diffAtLeast(uchar a, uchar b, int t1) {
+    return (a > b ? a - b : b - a) >= t1;
+}
+
+// 0/255 bytes; returns the number of foreground pixels
+int diffMaskRowScalar(const uchar *a, const uchar *b, uchar *out, int n, int t1, int i = 0) {
+    int count = 0;
+    for (; i < n; ++i) {
+        int fg = diffAtLeast(a[i], b[i], t1);
+        out[i] = static_cast<uchar>(-fg);
+        count += fg;
+    }
+    return count;
+}
+
+// Packed bits from pixel i (a multiple of 8) on; returns the number of foreground pixels
+int diffBitsRowScalar(const uchar *a, const uchar *b, uchar *out, int n, int t1, int i = 0) {
+    int count = 0;
+    for (; i < n; i += 8) {
+        uchar byte = 0;
+        for (int k = 0; k < 8 && i + k < n; ++k)
+            byte |= static_cast<uchar>(diffAtLeast(a[i + k], b[i + k], t1) << k);
+        out[i / 8] = byte;
+        count += popcount32(byte);
+    }
+    return count;
+}
+
+#if defined(__AVX2__)
+inline __m256i diffGE32(const uchar *a, const uchar *b, __m256i t1) {
+    const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+    const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+    const __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(d, t1), d);   // d >= t1
+}
+
+int diffMaskRow(const uchar *a, const uchar *b, uchar *out, int n, int t1, bool count) {
+    const __m256i vt = _mm256_set1_epi8(static_cast<char>(t1));
+    int total = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i m = diffGE32(a + i, b + i, vt);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), m);
+        if (count) total += popcount32(static_cast<unsigned>(_mm256_movemask_epi8(m)));
+    }
+    return total + diffMaskRowScalar(a, b, out, n, t1, i);
+}
+
+int diffBitsRow(const uchar *a, const uchar *b, uchar *out, int n, int t1) {
+    const __m256i vt = _mm256_set1_epi8(static_cast<char>(t1));
+    int total = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(diffGE32(a + i, b + i, vt)));
+        std::memcpy(out + i / 8, &bits, 4);
+        total += popcount32(bits);
+    }
+    return total + diffBitsRowScalar(a, b, out, n, t1, i);
+}
+
+#elif defined(__SSE2__)
+inline __m128i diffGE16(const uchar *a, const uchar *b, __m128i t1) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+    const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    return _mm_cmpeq_epi8(_mm_max_epu8(d, t1), d);   // d >= t1
+}
+
+int diffMaskRow(const uchar *a, const uchar *b, uchar *out, int n, int t1, bool count) {
+    const __m128i vt = _mm_set1_epi8(static_cast<char>(t1));
+    int total = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i m = diffGE16(a + i, b + i, vt);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), m);
+        if (count) total += popcount32(static_cast<unsigned>(_mm_movemask_epi8(m)));
+    }
+    return total + diffMaskRowScalar(a, b, out, n, t1, i);
+}
+
+int diffBitsRow(const uchar *a, const uchar *b, uchar *out, int n, int t1) {
+    const __m128i vt = _mm_set1_epi8(static_cast<char>(t1));
+    int total = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const uint16_t bits = static_cast<uint16_t>(_mm_movemask_epi8(diffGE16(a + i, b + i, vt)));
+        std::memcpy(out + i / 8, &bits, 2);
+        total += popcount32(bits);
+    }
+    return total + diffBitsRowScalar(a, b, out, n, t1, i);
+}
+
+#elif defined(__ARM_NEON)
+int diffMaskRow(const uchar *a, const uchar *b, uchar *out, int n, int t1, bool count) {
+    const uint8x16_t vt = vdupq_n_u8(static_cast<uint8_t>(t1));
+    int total = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t m = vcgeq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)), vt);
+        vst1q_u8(out + i, m);
+        if (count) {
+            const uint64x2_t ones = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vshrq_n_u8(m, 7))));
+            total += static_cast<int>(vgetq_lane_u64(ones, 0) + vgetq_lane_u64(ones, 1));
+        }
+    }
+    return total + diffMaskRowScalar(a, b, out, n, t1, i);
+}
+
+int diffBitsRow(const uchar *a, const uchar *b, uchar *out, int n, int t1) {
+    const uint8x16_t vt = vdupq_n_u8(static_cast<uint8_t>(t1));
+    const uint8x16_t weights = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    int total = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t m = vcgeq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)), vt);
+        // Pairwise adds of the weighted lanes collapse each 8-lane half into one byte
+        uint8x8_t packed = vpadd_u8(vget_low_u8(vandq_u8(m, weights)), vget_high_u8(vandq_u8(m, weights)));
+        packed = vpadd_u8(packed, packed);
+        packed = vpadd_u8(packed, packed);
+        out[i / 8]     = vget_lane_u8(packed, 0);
+        out[i / 8 + 1] = vget_lane_u8(packed, 1);
+        total += popcount32(out[i / 8]) + popcount32(out[i / 8 + 1]);
+    }
+    return total + diffBitsRowScalar(a, b, out, n, t1, i);
+}
+
+#else
+int diffMaskRow(const uchar *a, const uchar *b, uchar *out, int n, int t1, bool) {
+    return diffMaskRowScalar(a, b, out, n, t1);
+}
+
+int diffBitsRow(const uchar *a, const uchar *b, uchar *out, int n, int t1) {
+    return diffBitsRowScalar(a, b, out, n, t1);
+}
+#endif
+
+// Pick the fixed-point weights that reproduce this OpenCV build's cvtColor.
+// Returns nullptr if none matches; callers then convert with cvtColor first.
+const LumaCoeffs *matchingLumaCoeffs() {
+    static const LumaCoeffs *match = [] () -> const LumaCoeffs * {
+        // Probe pixels: all channel extremes plus a deterministic pseudo-random spread
+        cv::Mat probe(64, 64, CV_8UC3);
+        uint32_t state = 12345u;
+        for (int y = 0; y < probe.rows; ++y) {
+            uchar *p = probe.ptr<uchar>(y);
+            for (int x = 0; x < probe.cols * 3; ++x) {
+                state = state * 1664525u + 1013904223u;
+                p[x] = static_cast<uchar>(state >> 24);
+            }
+        }
+        for (int k = 0; k < 8; ++k) {
+            uchar *p = probe.ptr<uchar>(0) + 3 * k;
+            p[0] = (k & 1) ? 255 : 0;
+            p[1] = (k & 2) ? 255 : 0;
+            p[2] = (k & 4) ? 255 : 0;
+        }
+        cv::Mat expected;
+        cv::cvtColor(probe, expected, cv::COLOR_BGR2GRAY);
+
+        std::vector<uint32_t> acc(probe.cols);
+        for (const LumaCoeffs &c : LUMA_CANDIDATES) {
+            bool same = true;
+            for (int y = 0; y < probe.rows && same; ++y) {
+                std::fill(acc.begin(), acc.end(), 0u);
+                addLumaRow(probe.ptr<uchar>(y), acc.data(), probe.cols, c);
+                const uchar *e = expected.ptr<uchar>(y);
+                for (int x = 0; x < probe.cols && same; ++x)
+                    same = acc[x] == e[x];
+            }
+            if (same) return &c;
+        }
+        return nullptr;
+    }();
+    return match;
+}
+
+void checkGrayPair(const cv::Mat &gray, const cv::Mat &bg) {
+    if (gray.type() != CV_8UC1 || bg.type() != CV_8UC1 || gray.size() != bg.size())
+        throw std::invalid_argument("Foreground test expects two CV_8UC1 images of equal size");
+}
+
+void checkAccumulator(const cv::Mat &frame, const cv::Mat &acc) {
+    if (acc.type() != CV_32S || acc.rows != frame.rows || acc.cols != frame.cols)
+        throw std::invalid_argument("Accumulator must be CV_32S and match the frame size");
+}
+
+} // namespace
+
+void accumulateGrayBGR(const cv::Mat &bgr, cv::Mat &acc) {
+    if (bgr.type() != CV_8UC3)
+        throw std::invalid_argument("accumulateGrayBGR expects a CV_8UC3 frame");
+    checkAccumulator(bgr, acc);
+
+    const LumaCoeffs *c = matchingLumaCoeffs();
+    if (!c) {
+        // Unknown cvtColor rounding: keep its output, only fuse the accumulate
+        cv::Mat gray;
+        cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+        accumulateGray(gray, acc);
+        return;
+    }
+    for (int y = 0; y < bgr.rows; ++y)
+        addLumaRow(bgr.ptr<uchar>(y), reinterpret_cast<uint32_t *>(acc.ptr<int>(y)), bgr.cols, *c);
+}
+
+void accumulateGray(const cv::Mat &gray, cv::Mat &acc) {
+    if (gray.type() != CV_8UC1)
+        throw std::invalid_argument("accumulateGray expects a CV_8UC1 frame");
+    checkAccumulator(gray, acc);
+    for (int y = 0; y < gray.rows; ++y)
+        addGrayRow(gray.ptr<uchar>(y), reinterpret_cast<uint32_t *>(acc.ptr<int>(y)), gray.cols);
+}
+
+void slideWindow(const cv::Mat &enter, const cv::Mat &leave, cv::Mat &acc) {
+    for (const cv::Mat *frame : { &enter, &leave }) {
+        if (frame->empty()) continue;
+        if (frame->type() != CV_8UC1)
+            throw std::invalid_argument("slideWindow expects CV_8UC1 frames");
+        checkAccumulator(*frame, acc);
+    }
+    for (int y = 0; y < acc.rows; ++y) {
+        uint32_t *a = reinterpret_cast<uint32_t *>(acc.ptr<int>(y));
+        const uchar *in = enter.empty() ? nullptr : enter.ptr<uchar>(y);
+        const uchar *out = leave.empty() ? nullptr : leave.ptr<uchar>(y);
+        if (in && out) {
+            for (int x = 0; x < acc.cols; ++x)
+                a[x] += static_cast<uint32_t>(in[x]) - out[x];
+        } else if (in) {
+            addGrayRow(in, a, acc.cols);
+        } else if (out) {
+            for (int x = 0; x < acc.cols; ++x)
+                a[x] -= out[x];
+        }
+    }
+}
+
+void windowMean(const cv::Mat &acc, int frames, cv::Mat &bg) {
+    if (acc.type() != CV_32S || frames <= 0)
+        throw std::invalid_argument("windowMean expects a CV_32S sum of at least one frame");
+    bg.create(acc.rows, acc.cols, CV_8U);
+    const double scale = 1.0 / frames;
+    for (int y = 0; y < acc.rows; ++y) {
+        const uint32_t *a = reinterpret_cast<const uint32_t *>(acc.ptr<int>(y));
+        uchar *m = bg.ptr<uchar>(y);
+        for (int x = 0; x < acc.cols; ++x)
+            m[x] = cv::saturate_cast<uchar>(static_cast<double>(a[x]) * scale);
+    }
+}
+
+void thresholdDiff(const cv::Mat &gray, const cv::Mat &bg, double threshold,
+                   cv::Mat &mask, int *foreground) {
+    checkGrayPair(gray, bg);
+    mask.create(gray.rows, gray.cols, CV_8U);
+
+    // Same integer threshold as cv::threshold on 8-bit data
+    const int ithresh = cvFloor(threshold);
+    if (ithresh < 0 || ithresh >= 255) {
+        mask.setTo(cv::Scalar(ithresh < 0 ? 255 : 0));
+        if (foreground) *foreground = ithresh < 0 ? gray.rows * gray.cols : 0;
+        return;
+    }
+
+    int count = 0;
+    for (int y = 0; y < gray.rows; ++y)
+        count += diffMaskRow(gray.ptr<uchar>(y), bg.ptr<uchar>(y), mask.ptr<uchar>(y),
+                             gray.cols, ithresh + 1, foreground != nullptr);
+    if (foreground) *foreground = count;
+}
+
+void thresholdDiffPacked(const cv::Mat &gray, const cv::Mat &bg, double threshold,
+                         cv::Mat &bits, int *foreground) {
+    checkGrayPair(gray, bg);
+    bits.create(gray.rows, packedRowBytes(gray.cols), CV_8U);
+
+    const int ithresh = cvFloor(threshold);
+    if (ithresh >= 255) {
+        bits.setTo(cv::Scalar(0));
+        if (foreground) *foreground = 0;
+        return;
+    }
+
+    // ithresh < 0 marks everything as foreground; t1 = 0 expresses that (d >= 0)
+    const int t1 = std::max(ithresh + 1, 0);
+    int count = 0;
+    for (int y = 0; y < gray.rows; ++y)
+        count += diffBitsRow(gray.ptr<uchar>(y), bg.ptr<uchar>(y), bits.ptr<uchar>(y), gray.cols, t1);
+    if (foreground) *foreground = count;
+}
+
+void diffHistogram(const cv::Mat &gray, const cv::Mat &bg, uint32_t *hist) {
+    checkGrayPair(gray, bg);
+    // Four interleaved sub-histograms, so runs of equal differences do not
+    // serialize on one counter
+    uint32_t sub[4][256] = {};
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *a = gray.ptr<uchar>(y), *b = bg.ptr<uchar>(y);
+        int x = 0;
+        for (; x + 4 <= gray.cols; x += 4) {
+            ++sub[0][std::abs(a[x] - b[x])];
+            ++sub[1][std::abs(a[x + 1] - b[x + 1])];
+            ++sub[2][std::abs(a[x + 2] - b[x + 2])];
+            ++sub[3][std::abs(a[x + 3] - b[x + 3])];
+        }
+        for (; x < gray.cols; ++x)
+            ++sub[0][std::abs(a[x] - b[x])];
+    }
+    for (int v = 0; v < 256; ++v)
+        hist[v] += sub[0][v] + sub[1][v] + sub[2][v] + sub[3][v];
+}
+
+void foregroundCounts(const uint32_t *hist, const std::vector<double> &thresholds, int *counts) {
+    // above[t] = pixels with a difference >= t
+    uint32_t above[257];
+    above[256] = 0;
+    for (int v = 255; v >= 0; --v)
+        above[v] = above[v + 1] + hist[v];
+    for (size_t k = 0; k < thresholds.size(); ++k) {
+        const int ithresh = cvFloor(thresholds[k]);
+        counts[k] = static_cast<int>(above[std::clamp(ithresh + 1, 0, 256)]);
+    }
+}
+
+void flushAccumulator(cv::Mat &acc, cv::Mat &sum) {
+    for (int y = 0; y < acc.rows; ++y) {
+        const uint32_t *a = reinterpret_cast<const uint32_t *>(acc.ptr<int>(y));
+        double *s = sum.ptr<double>(y);
+        for (int x = 0; x < acc.cols; ++x)
+            s[x] += a[x];
+    }
+    acc.setTo(cv::Scalar(0));
+}
+
+const char *kernelIsa() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSSE3__)
+    return "SSSE3";
+#elif defined(__SSE2__)
+    return "SSE2";
+#elif defined(__ARM_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef FRAME_KERNELS_H
+#define FRAME_KERNELS_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+// Most 8-bit frames a uint32 accumulator can hold before it may overflow
+constexpr int MAX_U32_ACCUMULATED_FRAMES = static_cast<int>(UINT32_MAX / 255u);
+
+// Convert a BGR frame (CV_8UC3) to luma and add it into a per-pixel uint32
+// accumulator (CV_32S storage, read as unsigned) in a single pass. The luma
+// values are bit-identical to cv::cvtColor(COLOR_BGR2GRAY).
+void accumulateGrayBGR(const cv::Mat &bgr, cv::Mat &acc);
+
+// Add an 8-bit grayscale frame into a per-pixel uint32 accumulator
+void accumulateGray(const cv::Mat &gray, cv::Mat &acc);
+
+// Add a uint32 accumulator into a CV_64F sum and clear it
+void flushAccumulator(cv::Mat &acc, cv::Mat &sum);
+
+// Slide a window sum by one frame: acc += enter - leave. Either frame may be
+// empty (the window only grows or only shrinks). uint32 arithmetic wraps, so
+// the result is exact whenever the window itself fits in a uint32.
+void slideWindow(const cv::Mat &enter, const cv::Mat &leave, cv::Mat &acc);
+
+// Mean of a window of `frames` frames from its uint32 sum, rounded like
+// meanBackground (CV_8U, same size)
+void windowMean(const cv::Mat &acc, int frames, cv::Mat &bg);
+
+// Foreground test mask = |gray - bg| > threshold, with cv::threshold(THRESH_BINARY)
+// semantics for 8-bit images (the threshold is floored). Writes 0/255 bytes into
+// mask (CV_8U, same size). If foreground is given, stores the number of set pixels.
+void thresholdDiff(const cv::Mat &gray, const cv::Mat &bg, double threshold,
+                   cv::Mat &mask, int *foreground = nullptr);
+
+// Same test, bit-packed: 1 bit per pixel, row y at bits.ptr(y), pixel x at
+// bit (x % 8) of byte x / 8, rows padded to whole bytes (bits is CV_8U,
+// rows x packedRowBytes(cols)). The popcount comes almost for free.
+void thresholdDiffPacked(const cv::Mat &gray, const cv::Mat &bg, double threshold,
+                         cv::Mat &bits, int *foreground = nullptr);
+
+// Add the histogram of |gray - bg| (256 bins) into hist. The foreground count
+// of any threshold T is then the sum of bins floor(T) + 1 .. 255, so one pass
+// over the frame serves every threshold of a sweep.
+void diffHistogram(const cv::Mat &gray, const cv::Mat &bg, uint32_t *hist);
+
+// Foreground pixels at each threshold, from a diffHistogram (same semantics
+// as thresholdDiff): counts[k] for thresholds[k]
+void foregroundCounts(const uint32_t *hist, const std::vector<double> &thresholds, int *counts);
+
+// Bytes per row of a bit-packed mask
+inline int packedRowBytes(int cols) { return (cols + 7) / 8; }
+
+// Instruction set the kernels were compiled for ("AVX2", "SSSE3", "SSE2", "NEON", "scalar")
+const char *kernelIsa();
+
+#endif // FRAME_KERNELS_H
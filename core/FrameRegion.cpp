@@ -0,0 +1,278 @@
+#include "FrameRegion.h"
+#include "FrameKernels.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+RegionSpec spec;
+std::unique_ptr<FrameRegion> resolved;
+const FrameRegion wholeFrame;
+std::mutex mutex;
+
+std::string sizeText(cv::Size s) {
+    return std::to_string(s.width) + "x" + std::to_string(s.height);
+}
+
+} // namespace
+
+FrameRegion::FrameRegion(cv::Size frame, const RegionSpec &spec)
+    : scale_(spec.scale), frame_(frame), work_(frame) {
+    if (scale_ < 1)
+        throw std::invalid_argument("Region scale must be at least 1");
+    if (spec.empty())
+        return;
+    const cv::Size usable(frame.width / scale_ * scale_, frame.height / scale_ * scale_);
+    if (usable.area() == 0)
+        throw std::invalid_argument("Frame " + sizeText(frame) + " is smaller than one scale block");
+
+    // Frame pixels the spec selects (all of them if it only sets a scale)
+    cv::Mat keep = cv::Mat::zeros(frame, CV_8U);
+    if (spec.rois.empty() && spec.maskPath.empty())
+        keep.setTo(cv::Scalar(255));
+    for (const cv::Rect &roi : spec.rois) {
+        cv::Rect clipped = roi & cv::Rect(0, 0, frame.width, frame.height);
+        if (clipped.area() > 0)
+            keep(clipped).setTo(cv::Scalar(255));
+    }
+    if (!spec.maskPath.empty()) {
+        cv::Mat mask = cv::imread(spec.maskPath, cv::IMREAD_GRAYSCALE);
+        if (mask.empty())
+            throw std::runtime_error("Cannot read ROI mask: " + spec.maskPath);
+        if (mask.size() != frame)
+            throw std::runtime_error("ROI mask " + spec.maskPath + " is " + sizeText(mask.size()) +
+                                     ", the video is " + sizeText(frame));
+        for (int y = 0; y < frame.height; ++y) {
+            const uchar *m = mask.ptr<uchar>(y);
+            uchar *k = keep.ptr<uchar>(y);
+            for (int x = 0; x < frame.width; ++x)
+                if (m[x]) k[x] = 255;
+        }
+    }
+    if (usable.width < frame.width)
+        keep.colRange(usable.width, frame.width).setTo(cv::Scalar(0));
+    if (usable.height < frame.height)
+        keep.rowRange(usable.height, frame.height).setTo(cv::Scalar(0));
+    const int selected = cv::countNonZero(keep);
+    if (selected == 0)
+        throw std::invalid_argument("The region selects no pixels of the " + sizeText(frame) + " frame");
+    if (scale_ == 1 && selected == frame.area())
+        return;   // whole frame at full resolution
+
+    // Runs of selected tiles per tile row; a run with the same columns as a
+    // span of the row above extends that span downwards
+    const int side = REGION_TILE * scale_;
+    const int tileCols = (usable.width + side - 1) / side, tileRows = (usable.height + side - 1) / side;
+    auto tileRect = [&](int tx, int ty) {
+        return cv::Rect(tx * side, ty * side, std::min(side, usable.width - tx * side),
+                        std::min(side, usable.height - ty * side));
+    };
+    std::map<std::pair<int, int>, int> above;
+    int tileArea = 0;
+    for (int ty = 0; ty < tileRows; ++ty) {
+        std::vector<char> on(tileCols);
+        for (int tx = 0; tx < tileCols; ++tx)
+            on[tx] = cv::countNonZero(keep(tileRect(tx, ty))) > 0;
+        std::map<std::pair<int, int>, int> current;
+        for (int tx = 0; tx < tileCols;) {
+            if (!on[tx]) { ++tx; continue; }
+            int end = tx;
+            while (end < tileCols && on[end]) ++end;
+            const cv::Rect first = tileRect(tx, ty), last = tileRect(end - 1, ty);
+            auto it = above.find({tx, end});
+            int span;
+            if (it != above.end()) {
+                span = it->second;
+                spans_[span].full.height += first.height;
+            } else {
+                span = static_cast<int>(spans_.size());
+                spans_.push_back({cv::Rect(first.x, first.y, last.x + last.width - first.x, first.height), 0, 0, 0});
+            }
+            current[{tx, end}] = span;
+            for (int k = tx; k < end; ++k) {
+                const cv::Rect t = tileRect(k, ty);
+                tiles_.push_back({t, span, (t.x - spans_[span].full.x) / scale_, (t.y - spans_[span].full.y) / scale_});
+                tileArea += t.area();
+            }
+            tx = end;
+        }
+        above.swap(current);
+    }
+
+    // Work layout: spans back to back, wrapped into rows of usable width / scale
+    int top = INT_MAX, bottom = 0;
+    for (Span &s : spans_) {
+        s.cols = s.full.width / scale_;
+        s.rows = s.full.height / scale_;
+        s.offset = area_;
+        area_ += static_cast<size_t>(s.cols) * s.rows;
+        top = std::min(top, s.full.y);
+        bottom = std::max(bottom, s.full.y + s.full.height);
+    }
+    const int width = usable.width / scale_;
+    work_ = cv::Size(width, static_cast<int>((area_ + width - 1) / width));
+    rows_ = {top, bottom};
+    // Tiles reaching past the selected pixels are cut back when unpacking
+    if (selected < tileArea)
+        keep_ = keep;
+    active_ = true;
+}
+
+double FrameRegion::areaRatio() const {
+    return active_ ? static_cast<double>(area_) / frame_.area() : 1.0;
+}
+
+void FrameRegion::pack(const cv::Mat &gray, cv::Mat &work) const {
+    if (gray.type() != CV_8UC1 || gray.size() != frame_)
+        throw std::invalid_argument("Region expects " + sizeText(frame_) + " CV_8UC1 frames");
+    work.create(work_, CV_8U);
+    uchar *out = work.ptr<uchar>();
+    std::memset(out + area_, 0, static_cast<size_t>(work_.area()) - area_);
+    const int blockPixels = scale_ * scale_;
+    std::vector<int> sums;
+    for (const Span &s : spans_) {
+        uchar *dst = out + s.offset;
+        for (int r = 0; r < s.rows; ++r, dst += s.cols) {
+            const int y = s.full.y + r * scale_;
+            if (scale_ == 1) {
+                std::memcpy(dst, gray.ptr<uchar>(y) + s.full.x, s.cols);
+                continue;
+            }
+            // Block means: add the block's rows, then its columns
+            sums.assign(s.full.width, 0);
+            for (int dy = 0; dy < scale_; ++dy) {
+                const uchar *p = gray.ptr<uchar>(y + dy) + s.full.x;
+                for (int x = 0; x < s.full.width; ++x)
+                    sums[x] += p[x];
+            }
+            for (int c = 0; c < s.cols; ++c) {
+                int sum = 0;
+                for (int dx = 0; dx < scale_; ++dx)
+                    sum += sums[c * scale_ + dx];
+                dst[c] = static_cast<uchar>((sum + blockPixels / 2) / blockPixels);
+            }
+        }
+    }
+}
+
+void FrameRegion::unpack(const cv::Mat &work, cv::Mat &full) const {
+    if (!active_) {
+        work.copyTo(full);
+        return;
+    }
+    if (work.type() != CV_8UC1 || work.size() != work_)
+        throw std::invalid_argument("Region expects " + sizeText(work_) + " CV_8UC1 work images");
+    const cv::Mat packed = work.isContinuous() ? work : work.clone();
+    const uchar *in = packed.ptr<uchar>();
+    full.create(frame_, CV_8U);
+    full.setTo(cv::Scalar(0));
+    for (const Span &s : spans_) {
+        for (int r = 0; r < s.rows; ++r) {
+            const uchar *src = in + s.offset + static_cast<size_t>(r) * s.cols;
+            for (int dy = 0; dy < scale_; ++dy) {
+                uchar *dst = full.ptr<uchar>(s.full.y + r * scale_ + dy) + s.full.x;
+                if (scale_ == 1) {
+                    std::memcpy(dst, src, s.cols);
+                    continue;
+                }
+                for (int c = 0; c < s.cols; ++c)
+                    std::memset(dst + c * scale_, src[c], scale_);
+            }
+        }
+    }
+    if (!keep_.empty())
+        cv::bitwise_and(full, keep_, full);
+}
+
+void FrameRegion::refine(const cv::Mat &gray, const cv::Mat &fullBg, const cv::Mat &coarseMask,
+                         double threshold, cv::Mat &mask, int *foreground) const {
+    if (gray.type() != CV_8UC1 || fullBg.type() != CV_8UC1 || gray.size() != frame_ || fullBg.size() != frame_)
+        throw std::invalid_argument("Refinement expects " + sizeText(frame_) + " CV_8UC1 frames");
+    if (coarseMask.type() != CV_8UC1 || coarseMask.size() != work_ || !coarseMask.isContinuous())
+        throw std::invalid_argument("Refinement expects a continuous " + sizeText(work_) + " coarse mask");
+    mask.create(frame_, CV_8U);
+    mask.setTo(cv::Scalar(0));
+    const uchar *coarse = coarseMask.ptr<uchar>();
+    const int tiles = static_cast<int>(tiles_.size());
+    int count = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:count)
+    for (int i = 0; i < tiles; ++i) {
+        const Tile &t = tiles_[i];
+        const Span &s = spans_[t.span];
+        const int cols = t.full.width / scale_, rows = t.full.height / scale_;
+        bool moving = false;
+        for (int r = 0; r < rows && !moving; ++r) {
+            const uchar *p = coarse + s.offset + static_cast<size_t>(t.row + r) * s.cols + t.col;
+            for (int c = 0; c < cols && !moving; ++c)
+                moving = p[c] != 0;
+        }
+        if (!moving)
+            continue;
+        cv::Mat tileMask = mask(t.full);
+        int fg = 0;
+        thresholdDiff(gray(t.full), fullBg(t.full), threshold, tileMask, &fg);
+        if (!keep_.empty()) {
+            cv::bitwise_and(tileMask, keep_(t.full), tileMask);
+            fg = cv::countNonZero(tileMask);
+        }
+        count += fg;
+    }
+    if (foreground) *foreground = count;
+}
+
+void setRegionSpec(const RegionSpec &s) {
+    std::lock_guard<std::mutex> lock(mutex);
+    spec = s;
+    resolved.reset();
+}
+
+const RegionSpec &regionSpec() { return spec; }
+
+const FrameRegion &frameRegion(cv::Size frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (spec.empty())
+        return wholeFrame;
+    if (!resolved)
+        resolved = std::make_unique<FrameRegion>(frame, spec);
+    else if (resolved->frameSize() != frame)
+        throw std::runtime_error("The region was set up for " + sizeText(resolved->frameSize()) +
+                                 " frames, this video is " + sizeText(frame));
+    return *resolved;
+}
+
+const FrameRegion &frameRegion() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resolved ? *resolved : wholeFrame;
+}
+
+cv::Size outputSize(cv::Size work) {
+    const FrameRegion &region = frameRegion();
+    return region.active() && work == region.workSize() ? region.frameSize() : work;
+}
+
+bool writeFrameImage(const std::string &path, const cv::Mat &image) {
+    const FrameRegion &region = frameRegion();
+    if (!region.active() || image.size() != region.workSize())
+        return cv::imwrite(path, image);
+    cv::Mat full;
+    region.unpack(image, full);
+    return cv::imwrite(path, full);
+}
+
+cv::Rect parseRoi(const std::string &text) {
+    std::istringstream in(text);
+    int v[4];
+    char comma;
+    bool ok = static_cast<bool>(in >> v[0]);
+    for (int i = 1; ok && i < 4; ++i)
+        ok = (in >> comma >> v[i]) && comma == ',';
+    if (!ok || !(in >> std::ws).eof() || v[0] < 0 || v[1] < 0 || v[2] <= 0 || v[3] <= 0)
+        throw std::invalid_argument("ROI must be x,y,w,h with w, h > 0: " + text);
+    return cv::Rect(v[0], v[1], v[2], v[3]);
+}
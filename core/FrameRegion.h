@@ -0,0 +1,103 @@
+#ifndef FRAME_REGION_H
+#define FRAME_REGION_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What part of the frame a run processes, and at what resolution
+struct RegionSpec {
+    std::vector<cv::Rect> rois;      // rectangles in full-frame pixels
+    std::string maskPath;            // static mask image (non-zero = process), if set
+    int scale = 1;                   // work at 1/scale resolution (coarse-to-fine when > 1)
+
+    bool empty() const { return rois.empty() && maskPath.empty() && scale == 1; }
+};
+
+// Work pixels per side of the tiles that cover a region
+constexpr int REGION_TILE = 8;
+
+// A RegionSpec resolved for one frame size.
+//
+// The ROIs (and mask) are covered by tiles of REGION_TILE x REGION_TILE work
+// pixels, merged into disjoint rectangles ("spans"). FrameSource packs the
+// spans of every decoded frame into a compact work frame: each span's pixels
+// (averaged over scale x scale blocks) row-major, one span after the other,
+// wrapped into rows of frame width / scale. Accumulators, reductions and
+// thresholding then run on the work frame, so their cost follows the area
+// processed. unpack() maps work images (backgrounds, masks) back onto the
+// full frame, with 0 outside the region.
+//
+// Columns and rows past the last whole scale x scale block are not processed.
+class FrameRegion {
+public:
+    // Whole frame at full resolution (inactive)
+    FrameRegion() = default;
+    // Throws std::invalid_argument if the spec selects nothing, or
+    // std::runtime_error if the mask image is unreadable or of another size
+    FrameRegion(cv::Size frame, const RegionSpec &spec);
+
+    bool active() const { return active_; }
+    int scale() const { return scale_; }
+    cv::Size frameSize() const { return frame_; }
+    cv::Size workSize() const { return work_; }
+    // Share of the frame's pixels that are processed, in work pixels per full-frame pixel
+    double areaRatio() const;
+
+    // CV_8U full-frame gray → work frame (CV_8U, workSize())
+    void pack(const cv::Mat &gray, cv::Mat &work) const;
+    // Work image (CV_8U) → full frame, scaled up by pixel replication
+    void unpack(const cv::Mat &work, cv::Mat &full) const;
+    // Rows [first, second) of the frame that pack() reads
+    std::pair<int, int> rowSpan() const { return rows_; }
+
+    // Coarse-to-fine mask: tiles holding any pixel of coarseMask (a work
+    // image) are thresholded again at full resolution, |gray - fullBg| >
+    // threshold; everything else is background. fullBg is the unpacked
+    // background. If foreground is given, stores the number of set pixels.
+    void refine(const cv::Mat &gray, const cv::Mat &fullBg, const cv::Mat &coarseMask,
+                double threshold, cv::Mat &mask, int *foreground = nullptr) const;
+
+private:
+    struct Span {
+        cv::Rect full;               // in frame pixels (multiples of scale)
+        int cols, rows;              // in work pixels
+        size_t offset;               // of its first work pixel in the work frame
+    };
+    struct Tile {
+        cv::Rect full;
+        int span;
+        int col, row;                // of its first work pixel inside the span
+    };
+
+    bool active_ = false;
+    int scale_ = 1;
+    cv::Size frame_, work_;
+    size_t area_ = 0;                // work pixels in use (the rest of the last row is padding)
+    std::vector<Span> spans_;
+    std::vector<Tile> tiles_;
+    std::pair<int, int> rows_{0, 0};
+    cv::Mat keep_;                   // 0/255 per frame pixel when tiles overreach the ROIs
+};
+
+// Process-wide region for every FrameSource opened afterwards (an empty spec
+// processes the whole frame). Resets the resolved region.
+void setRegionSpec(const RegionSpec &spec);
+const RegionSpec &regionSpec();
+// The spec resolved for frames of this size, built on first use. Throws
+// std::runtime_error if it was already resolved for another size.
+const FrameRegion &frameRegion(cv::Size frame);
+// The resolved region (inactive if none was resolved yet)
+const FrameRegion &frameRegion();
+
+// Full-frame size for images of size `work` (unchanged unless they are
+// work images of the active region)
+cv::Size outputSize(cv::Size work);
+// imwrite() that unpacks work images of the active region first
+bool writeFrameImage(const std::string &path, const cv::Mat &image);
+
+// "x,y,w,h" → rectangle; throws std::invalid_argument if malformed
+cv::Rect parseRoi(const std::string &text);
+
+#endif // FRAME_REGION_H
@@ -0,0 +1,118 @@
+#include "FrameSampler.h"
+#include "VideoProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+double SampleSpec::stopTolerance() const {
+    if (tolerance > 0.0)
+        return tolerance;
+    return mode == SampleMode::Adaptive ? DEFAULT_SAMPLE_TOLERANCE : 0.0;
+}
+
+SamplePlan::SamplePlan(const SampleSpec &spec, int totalFrames, const std::vector<int> &keyframes)
+    : mode_(spec.mode), stride_(spec.mode == SampleMode::Stride ? spec.stride : 1),
+      totalFrames_(totalFrames), tolerance_(spec.stopTolerance()) {
+    if (stride_ < 1)
+        throw std::invalid_argument("Sample stride must be at least 1");
+    if (tolerance_ < 0.0)
+        throw std::invalid_argument("Sample tolerance must not be negative");
+    if (mode_ == SampleMode::Keyframes) {
+        for (int k : keyframes)
+            if (k >= 0 && k < totalFrames)
+                keyframes_.push_back(k);
+        if (keyframes_.empty())
+            throw std::invalid_argument("No keyframes found to sample; use a stride instead");
+        candidates_ = static_cast<int>(keyframes_.size());
+    } else {
+        candidates_ = (totalFrames + stride_ - 1) / stride_;
+    }
+
+    // Without a tolerance every candidate is taken in one round
+    if (tolerance_ > 0.0)
+        while (candidates_ / (2 * firstStep_) >= SAMPLE_FIRST_ROUND) {
+            firstStep_ *= 2;
+            ++rounds_;
+        }
+}
+
+int SamplePlan::frameOf(int candidate) const {
+    return mode_ == SampleMode::Keyframes ? keyframes_[candidate] : candidate * stride_;
+}
+
+int SamplePlan::firstCandidate(int frame) const {
+    if (mode_ == SampleMode::Keyframes)
+        return static_cast<int>(std::lower_bound(keyframes_.begin(), keyframes_.end(), frame) - keyframes_.begin());
+    return (std::max(frame, 0) + stride_ - 1) / stride_;
+}
+
+std::vector<int> SamplePlan::round(int k, const FrameRange &range) const {
+    std::vector<int> frames;
+    if (k < 0 || k >= rounds_)
+        return frames;
+    const int step = firstStep_ >> k;
+    const int begin = firstCandidate(range.begin), end = std::min(firstCandidate(range.end), candidates_);
+    // Multiples of step, minus those of 2 * step an earlier round took
+    for (int c = (begin + step - 1) / step * step; c < end; c += step)
+        if (k == 0 || c % (2 * step) != 0)
+            frames.push_back(frameOf(c));
+    return frames;
+}
+
+double estimateChange(const cv::Mat &sum, int frames, cv::Mat &previous) {
+    const bool first = previous.empty();
+    if (first)
+        previous.create(sum.size(), CV_32F);
+    const double scale = frames > 0 ? 1.0 / frames : 0.0;
+    double total = 0.0;
+#pragma omp parallel for reduction(+:total) schedule(static)
+    for (int y = 0; y < sum.rows; ++y) {
+        float *p = previous.ptr<float>(y);
+        double rowTotal = 0.0;
+        if (sum.type() == CV_32S) {
+            const uint32_t *s = reinterpret_cast<const uint32_t *>(sum.ptr<int>(y));
+            for (int x = 0; x < sum.cols; ++x) {
+                const float m = static_cast<float>(s[x] * scale);
+                rowTotal += std::fabs(m - p[x]);
+                p[x] = m;
+            }
+        } else {
+            const double *s = sum.ptr<double>(y);
+            for (int x = 0; x < sum.cols; ++x) {
+                const float m = static_cast<float>(s[x] * scale);
+                rowTotal += std::fabs(m - p[x]);
+                p[x] = m;
+            }
+        }
+        total += rowTotal;
+    }
+    if (first)
+        return std::numeric_limits<double>::infinity();
+    return sum.total() > 0 ? total / sum.total() : 0.0;
+}
+
+SampleSpec parseSampleSpec(const std::string &text) {
+    SampleSpec spec;
+    if (text == "keyframes") {
+        spec.mode = SampleMode::Keyframes;
+        return spec;
+    }
+    if (text == "adaptive") {
+        spec.mode = SampleMode::Adaptive;
+        return spec;
+    }
+    size_t used = 0;
+    int stride = 0;
+    try {
+        stride = std::stoi(text, &used);
+    } catch (const std::exception &) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size() || stride < 1)
+        throw std::invalid_argument("Sample must be a stride N >= 1, keyframes or adaptive: " + text);
+    spec.mode = stride == 1 ? SampleMode::All : SampleMode::Stride;
+    spec.stride = stride;
+    return spec;
+}
@@ -0,0 +1,82 @@
+#ifndef FRAME_SAMPLER_H
+#define FRAME_SAMPLER_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+struct FrameRange;
+
+// Which frames the mean background is built from
+enum class SampleMode {
+    All,         // every frame (no sampling)
+    Stride,      // every stride-th frame
+    Keyframes,   // keyframes only: each sample is one seek and one decode
+    Adaptive     // every frame, in rounds of doubling density, until the mean converges
+};
+
+// Mean change (gray levels per pixel) below which an adaptive sample stops
+constexpr double DEFAULT_SAMPLE_TOLERANCE = 0.25;
+// Frames (at least) in the first round of a progressive sample
+constexpr int SAMPLE_FIRST_ROUND = 32;
+// Gaps of up to this many frames between samples are skipped with grab();
+// longer ones seek (about one short GOP)
+constexpr int SAMPLE_GRAB_GAP = 12;
+
+struct SampleSpec {
+    SampleMode mode = SampleMode::All;
+    int stride = 1;                  // SampleMode::Stride
+    double tolerance = 0.0;          // stop once a round moves the mean by less (0 = never;
+                                     // DEFAULT_SAMPLE_TOLERANCE for Adaptive)
+
+    bool empty() const { return mode == SampleMode::All; }
+    // The early-stop tolerance in effect (0 = every round runs)
+    double stopTolerance() const;
+};
+
+// The frames a SampleSpec picks, in rounds.
+//
+// The candidates (every frame, every stride-th frame, or the keyframes) are
+// numbered 0..candidates()-1 across the whole video. Without early stopping
+// a single round takes all of them. With a tolerance, round 0 takes every
+// S-th candidate (S a power of two leaving at least SAMPLE_FIRST_ROUND of
+// them) and every further round the candidates halfway between those taken
+// so far, so each round doubles the sample and the sample is spread evenly
+// over the video whenever it stops. Rounds depend only on the video, so the
+// blocks of all MPI ranks go through the same rounds at the same density.
+class SamplePlan {
+public:
+    // Throws std::invalid_argument if the spec is invalid or asks for
+    // keyframes and the list is empty
+    SamplePlan(const SampleSpec &spec, int totalFrames, const std::vector<int> &keyframes);
+
+    int rounds() const { return rounds_; }
+    int candidates() const { return candidates_; }
+    double tolerance() const { return tolerance_; }
+    // Frames of round k inside range, ascending
+    std::vector<int> round(int k, const FrameRange &range) const;
+
+private:
+    int frameOf(int candidate) const;
+    int firstCandidate(int frame) const;   // first candidate at or after frame
+
+    SampleMode mode_;
+    int stride_;
+    int totalFrames_;
+    std::vector<int> keyframes_;
+    int candidates_ = 0;
+    int firstStep_ = 1;                    // S: candidate step of round 0
+    int rounds_ = 1;
+    double tolerance_;
+};
+
+// Mean absolute per-pixel change of the estimate sum / frames against
+// previous (CV_32F, replaced by the new estimate). sum is CV_64F, or CV_32S
+// read as uint32. Returns infinity if previous is empty (first estimate).
+double estimateChange(const cv::Mat &sum, int frames, cv::Mat &previous);
+
+// "N" (every N-th frame), "keyframes" or "adaptive". Throws
+// std::invalid_argument for anything else.
+SampleSpec parseSampleSpec(const std::string &text);
+
+#endif // FRAME_SAMPLER_H
@@ -0,0 +1,126 @@
+#include "FrameSource.h"
+#include "FrameRegion.h"
+#include "Profiler.h"
+#include <stdexcept>
+
+namespace {
+DecodeMode mode = DecodeMode::BGR;
+} // namespace
+
+void setDecodeMode(DecodeMode m) { mode = m; }
+DecodeMode decodeMode() { return mode; }
+
+FrameSource::FrameSource(const std::string &path, bool fullFrame) : path_(path) {
+    if (!cap_.open(path))
+        throw std::runtime_error("Cannot open video: " + path);
+    frameSize_ = size_ = cv::Size(static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_WIDTH)),
+                                  static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    if (!fullFrame) {
+        const FrameRegion &region = frameRegion(frameSize_);
+        if (region.active()) {
+            region_ = &region;
+            size_ = region.workSize();
+        }
+    }
+    // Backends that cannot skip the conversion reject the property
+    if (mode == DecodeMode::Luma && cap_.set(cv::CAP_PROP_CONVERT_RGB, 0))
+        probed_ = false;
+}
+
+int FrameSource::frameCount() const {
+    return static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_COUNT));
+}
+
+double FrameSource::fps() const {
+    return cap_.get(cv::CAP_PROP_FPS);
+}
+
+void FrameSource::openBGR() {
+    cap_.release();
+    if (!cap_.open(path_))
+        throw std::runtime_error("Cannot open video: " + path_);
+    if (position_ > 0)
+        cap_.set(cv::CAP_PROP_POS_FRAMES, position_);
+    luma_ = false;
+    probed_ = true;
+}
+
+bool FrameSource::isLumaLayout(const cv::Mat &frame) const {
+    if (frame.type() != CV_8UC1 || frame.cols != frameSize_.width)
+        return false;
+    return frame.rows == frameSize_.height || frame.rows == frameSize_.height * 3 / 2;
+}
+
+void FrameSource::seek(int index) {
+    Profiler::Scope scope("seek");
+    cap_.set(cv::CAP_PROP_POS_FRAMES, index);
+    position_ = index;
+    Profiler::count("seeks");
+}
+
+bool FrameSource::read(cv::Mat &frame) {
+    if (!region_)
+        return decode(frame);
+    if (!decode(raw_))
+        return false;
+    Profiler::Scope scope("pack");
+    cv::Mat gray;
+    if (raw_.channels() == 1) {
+        gray = raw_.rowRange(0, frameSize_.height);
+    } else {
+        // Only the rows the region reads need converting
+        rawGray_.create(frameSize_, CV_8U);
+        const auto rows = region_->rowSpan();
+        cv::Mat band = rawGray_.rowRange(rows.first, rows.second);
+        cv::cvtColor(raw_.rowRange(rows.first, rows.second), band, cv::COLOR_BGR2GRAY);
+        gray = rawGray_;
+    }
+    region_->pack(gray, frame);
+    return true;
+}
+
+bool FrameSource::grab() {
+    Profiler::Scope scope("grab");
+    if (!cap_.grab())
+        return false;
+    ++position_;
+    Profiler::count("grabbed_frames");
+    return true;
+}
+
+bool FrameSource::decode(cv::Mat &frame) {
+    Profiler::Scope scope("decode");
+    bool ok = cap_.read(frame) && !frame.empty();
+    if (ok && !probed_) {
+        if (isLumaLayout(frame)) {
+            luma_ = probed_ = true;
+            Profiler::count("luma_sources");
+        } else {
+            // Unknown raw layout (packed YUV, ...): decode this frame again as BGR
+            openBGR();
+            ok = cap_.read(frame) && !frame.empty();
+        }
+    }
+    if (ok) {
+        ++position_;
+        Profiler::count("frames");
+    }
+    return ok;
+}
+
+cv::Mat FrameSource::lumaRows(const cv::Mat &frame, int begin, int end, cv::Mat &gray) const {
+    if (frame.channels() == 1)
+        return frame.rowRange(begin, end);
+    Profiler::Scope scope("convert");
+    cv::Mat rows = gray.rowRange(begin, end);
+    cv::cvtColor(frame.rowRange(begin, end), rows, cv::COLOR_BGR2GRAY);
+    return rows;
+}
+
+cv::Mat FrameSource::luma(const cv::Mat &frame, cv::Mat &gray) const {
+    if (frame.channels() == 1)
+        return frame.rowRange(0, size_.height);
+    Profiler::Scope scope("convert");
+    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    return gray;
+}
@@ -0,0 +1,82 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+class FrameRegion;
+
+// What the decoder is asked to deliver
+enum class DecodeMode {
+    BGR,     // BGR frames, luma via cvtColor(COLOR_BGR2GRAY) (reference path)
+    Luma     // the decoder's own Y plane when the capture backend exposes it
+};
+
+// Process-wide decode mode for every FrameSource opened afterwards.
+// Decoder luma is the video's Y channel (usually limited range, 16..235), so
+// it differs slightly from the gray of the BGR path; backgrounds, masks and
+// luma caches from the two modes are not interchangeable.
+void setDecodeMode(DecodeMode mode);
+DecodeMode decodeMode();
+
+// Sequential reader of one video that hands out luma without a BGR round
+// trip when it can.
+//
+// In DecodeMode::Luma the capture is opened with CAP_PROP_CONVERT_RGB off and
+// the first decoded frame is inspected: an 8-bit single-channel frame of the
+// video size (gray) or of 3/2 its height (planar 4:2:0: I420, YV12, NV12) has
+// its Y plane in the first `height` rows and is used as is. Any other layout,
+// or a backend that refuses the property, reopens the video in BGR mode at
+// the same position. Reads are timed as "decode" and counted as "frames".
+//
+// With an active frame region (setRegionSpec) every frame is handed out as
+// the region's work frame, a CV_8UC1 luma image of size() (packing timed as
+// "pack"), unless the source was opened with fullFrame.
+class FrameSource {
+public:
+    // Throws std::runtime_error if the video cannot be opened
+    explicit FrameSource(const std::string &path, bool fullFrame = false);
+
+    int frameCount() const;
+    double fps() const;
+    cv::Size size() const { return size_; }
+
+    // Position the decoder on frame index, timed as "seek"
+    void seek(int index);
+
+    // Next decoded frame: BGR (CV_8UC3), or decoder luma (CV_8UC1 whose first
+    // size().height rows are the Y plane). Use luma()/lumaRows() to read it.
+    bool read(cv::Mat &frame);
+
+    // Step over the next frame without retrieving it (no conversion, no
+    // copy), timed as "grab" and counted as "grabbed_frames"
+    bool grab();
+
+    // True once read() is known to deliver luma
+    bool deliversLuma() const { return luma_; }
+
+    // Rows [begin, end) of a frame's luma: a view into a luma frame, or the
+    // BGR rows converted into the same rows of gray (CV_8U, frame size),
+    // timed as "convert". Safe to call concurrently on disjoint rows.
+    cv::Mat lumaRows(const cv::Mat &frame, int begin, int end, cv::Mat &gray) const;
+    cv::Mat luma(const cv::Mat &frame, cv::Mat &gray) const;
+
+    void release() { cap_.release(); }
+
+private:
+    void openBGR();
+    bool isLumaLayout(const cv::Mat &frame) const;
+    bool decode(cv::Mat &frame);
+
+    std::string path_;
+    cv::VideoCapture cap_;
+    cv::Size size_;          // of the frames read() returns
+    cv::Size frameSize_;     // of the decoded video
+    const FrameRegion *region_ = nullptr;
+    cv::Mat raw_, rawGray_;  // decoded frame and its luma when packing
+    int position_ = 0;       // index of the next frame read() returns
+    bool probed_ = true;     // layout known (always true in BGR mode)
+    bool luma_ = false;
+};
+
+#endif // FRAME_SOURCE_H
@@ -0,0 +1,423 @@
+#include "FrameStream.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <filesystem>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Longest Y4M header line accepted (stream and frame headers)
+constexpr size_t MAX_Y4M_LINE = 4096;
+// Input buffer for headers and short reads; larger reads go straight to the frame
+constexpr size_t INPUT_BUFFER = 64 * 1024;
+
+} // namespace
+
+FrameStream::FrameStream(const std::string &path, const StreamSpec &spec)
+    : path_(path), format_(spec.format), drop_(spec.drop), capacity_(std::max(spec.queue, 1)) {
+    if (format_ == StreamFormat::None)
+        throw std::invalid_argument("No stream format given for " + path);
+    if (spec.queue < 1)
+        throw std::invalid_argument("The stream queue needs at least one frame");
+    // Plain descriptors rather than stdio, so that a blocked read can be interrupted
+    if (path == "-") {
+#ifdef _WIN32
+        fd_ = _fileno(stdin);
+        _setmode(fd_, _O_BINARY);
+#else
+        fd_ = STDIN_FILENO;
+#endif
+    } else {
+#ifdef _WIN32
+        fd_ = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+#endif
+        ownFd_ = fd_ >= 0;
+    }
+    if (fd_ < 0)
+        throw std::runtime_error("Cannot open stream: " + path);
+    in_.resize(INPUT_BUFFER);
+    try {
+#ifndef _WIN32
+        if (::pipe(wake_) != 0)
+            throw std::runtime_error("Cannot create the stop pipe of stream: " + path);
+#endif
+        readHeader(spec);
+    } catch (...) {
+        closeInput();
+        throw;
+    }
+
+    const int type = format_ == StreamFormat::BGR ? CV_8UC3 : CV_8UC1;
+    for (size_t i = 0; i < capacity_ + 2; ++i) {
+        buffers_.emplace_back(size_, type);
+        free_.push_back(static_cast<int>(i));
+    }
+    skip_.resize(skipBytes_);
+    latency_.assign(1000000 / LATENCY_BUCKET_US + 1, 0);
+    reader_ = std::thread(&FrameStream::readLoop, this);
+}
+
+FrameStream::~FrameStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    drained_.notify_all();
+    if (reader_.joinable()) {
+#ifdef _WIN32
+        // A read that starts after a cancel is not interrupted: cancel until the reader is done
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!done_) {
+            CancelSynchronousIo(reader_.native_handle());
+            filled_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        lock.unlock();
+#else
+        const char wake = 0;
+        while (::write(wake_[1], &wake, 1) < 0 && errno == EINTR) {
+        }
+#endif
+        reader_.join();
+    }
+    closeInput();
+}
+
+void FrameStream::closeInput() {
+#ifdef _WIN32
+    if (ownFd_)
+        _close(fd_);
+#else
+    if (ownFd_)
+        ::close(fd_);
+    for (int &fd : wake_) {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+#endif
+    ownFd_ = false;
+    fd_ = -1;
+}
+
+size_t FrameStream::readSome(void *dst, size_t bytes) {
+    bytes = std::min<size_t>(bytes, INT_MAX);
+    for (;;) {
+#ifdef _WIN32
+        const int got = _read(fd_, dst, static_cast<unsigned>(bytes));
+        if (got >= 0)
+            return static_cast<size_t>(got);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_)
+            return 0;
+#else
+        // Wait for input or for the destructor's byte on the stop pipe
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_[0], POLLIN, 0}};
+        if (::poll(fds, 2, -1) > 0) {
+            if (fds[1].revents)
+                return 0;
+            const ssize_t got = ::read(fd_, dst, bytes);
+            if (got >= 0)
+                return static_cast<size_t>(got);
+        }
+        if (errno == EINTR || errno == EAGAIN)
+            continue;
+#endif
+        throw std::runtime_error("Read error in " + path_);
+    }
+}
+
+size_t FrameStream::readBytes(void *dst, size_t bytes) {
+    uchar *out = static_cast<uchar *>(dst);
+    size_t done = std::min(bytes, inEnd_ - inPos_);
+    std::copy(in_.data() + inPos_, in_.data() + inPos_ + done, out);
+    inPos_ += done;
+    while (done < bytes) {
+        const size_t left = bytes - done;
+        if (left >= in_.size()) {
+            const size_t got = readSome(out + done, left);
+            if (got == 0)
+                break;
+            done += got;
+            continue;
+        }
+        inPos_ = 0;
+        inEnd_ = readSome(in_.data(), in_.size());
+        if (inEnd_ == 0)
+            break;
+        const size_t take = std::min(left, inEnd_);
+        std::copy(in_.data(), in_.data() + take, out + done);
+        inPos_ = take;
+        done += take;
+    }
+    return done;
+}
+
+int FrameStream::getByte() {
+    if (inPos_ == inEnd_) {
+        inPos_ = 0;
+        inEnd_ = readSome(in_.data(), in_.size());
+        if (inEnd_ == 0)
+            return -1;
+    }
+    return in_[inPos_++];
+}
+
+void FrameStream::readHeader(const StreamSpec &spec) {
+    if (format_ != StreamFormat::Y4M) {
+        if (spec.size.width <= 0 || spec.size.height <= 0)
+            throw std::invalid_argument("Raw streams need a frame size (WxH)");
+        if (!(spec.fps > 0.0))
+            throw std::invalid_argument("Raw streams need a positive frame rate");
+        size_ = spec.size;
+        fps_ = spec.fps;
+        return;
+    }
+
+    // YUV4MPEG2 W<w> H<h> [F<num>:<den>] [C<colour space>] [I, A, X: ignored]
+    std::string line;
+    if (!readLine(line, true))
+        throw std::runtime_error("Empty stream: " + path_);
+    std::istringstream in(line);
+    std::string tag, chroma = "420jpeg";
+    in >> tag;
+    if (tag != "YUV4MPEG2")
+        throw std::invalid_argument("Not a YUV4MPEG2 stream: " + path_);
+    fps_ = spec.fps;
+    for (std::string field; in >> field;) {
+        const std::string value = field.substr(1);
+        if (field[0] == 'W') {
+            size_.width = std::stoi(value);
+        } else if (field[0] == 'H') {
+            size_.height = std::stoi(value);
+        } else if (field[0] == 'F') {
+            const size_t colon = value.find(':');
+            const double num = std::stod(value.substr(0, colon));
+            const double den = colon == std::string::npos ? 1.0 : std::stod(value.substr(colon + 1));
+            if (num > 0.0 && den > 0.0)
+                fps_ = num / den;
+        } else if (field[0] == 'C') {
+            chroma = value;
+        }
+    }
+    const int w = size_.width, h = size_.height;
+    if (w <= 0 || h <= 0)
+        throw std::invalid_argument("Y4M header without a frame size: " + line);
+
+    // Bytes of the chroma (and alpha) planes that follow the Y plane
+    const size_t cw = (w + 1) / 2, ch = (h + 1) / 2;
+    if (chroma == "mono")
+        skipBytes_ = 0;
+    else if (chroma == "420" || chroma == "420jpeg" || chroma == "420paldv" || chroma == "420mpeg2")
+        skipBytes_ = 2 * cw * ch;
+    else if (chroma == "422")
+        skipBytes_ = 2 * cw * h;
+    else if (chroma == "444")
+        skipBytes_ = 2 * static_cast<size_t>(w) * h;
+    else if (chroma == "444alpha")
+        skipBytes_ = 3 * static_cast<size_t>(w) * h;
+    else if (chroma == "411")
+        skipBytes_ = 2 * static_cast<size_t>((w + 3) / 4) * h;
+    else
+        throw std::invalid_argument("Unsupported Y4M colour space C" + chroma +
+                                    " (8-bit mono, 411, 420, 422 or 444 only)");
+}
+
+bool FrameStream::readLine(std::string &line, bool eofOk) {
+    line.clear();
+    for (int c; (c = getByte()) != '\n';) {
+        if (c < 0) {
+            if (line.empty() && eofOk)
+                return false;
+            throw std::runtime_error("Truncated Y4M header in " + path_);
+        }
+        if (line.size() == MAX_Y4M_LINE)
+            throw std::runtime_error("Y4M header line too long in " + path_);
+        line.push_back(static_cast<char>(c));
+    }
+    return true;
+}
+
+bool FrameStream::readFrame(cv::Mat &buffer) {
+    if (format_ == StreamFormat::Y4M) {
+        std::string line;
+        if (!readLine(line, true))
+            return false;
+        if (line.compare(0, 5, "FRAME") != 0)
+            throw std::runtime_error("Bad Y4M frame header in " + path_ + ": " + line.substr(0, 32));
+    }
+    const size_t bytes = buffer.total() * buffer.elemSize();
+    const size_t got = readBytes(buffer.data, bytes);
+    // Raw streams may only end between frames
+    if (got == 0 && format_ != StreamFormat::Y4M)
+        return false;
+    if (got < bytes || (skipBytes_ > 0 && readBytes(skip_.data(), skipBytes_) < skipBytes_))
+        throw std::runtime_error("Truncated frame in " + path_);
+    return true;
+}
+
+// Reader thread: fill a free buffer, queue it (waiting or dropping while the
+// queue is full), take the next free buffer
+void FrameStream::readLoop() {
+    try {
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot = free_.back();
+            free_.pop_back();
+        }
+        for (int64_t index = 0;; ++index) {
+            if (!readFrame(buffers_[slot]))
+                break;
+            const Clock::time_point arrived = Clock::now();
+            Profiler::count("stream_frames");
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++read_;
+            if (stop_)
+                break;
+            if (queue_.size() >= capacity_) {
+                if (drop_ == DropPolicy::Newest) {
+                    // Read the next frame over this one
+                    ++dropped_;
+                    Profiler::count("stream_drops");
+                    continue;
+                }
+                if (drop_ == DropPolicy::Oldest) {
+                    free_.push_back(queue_.front().slot);
+                    queue_.pop_front();
+                    ++dropped_;
+                    Profiler::count("stream_drops");
+                } else {
+                    drained_.wait(lock, [&] { return queue_.size() < capacity_ || stop_; });
+                    if (stop_)
+                        break;
+                }
+            }
+            queue_.push_back({slot, index, arrived});
+            maxQueued_ = std::max(maxQueued_, static_cast<int>(queue_.size()));
+            filled_.notify_one();
+            // Free unless processing holds on to more than one frame
+            drained_.wait(lock, [&] { return !free_.empty() || stop_; });
+            if (stop_)
+                break;
+            slot = free_.back();
+            free_.pop_back();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    filled_.notify_all();
+}
+
+bool FrameStream::next(StreamFrame &frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    filled_.wait(lock, [&] { return !queue_.empty() || done_; });
+    if (queue_.empty()) {
+        if (error_)
+            std::rethrow_exception(error_);
+        return false;
+    }
+    const Queued q = queue_.front();
+    queue_.pop_front();
+    drained_.notify_one();
+    frame.image = buffers_[q.slot];
+    frame.index = q.index;
+    frame.slot = q.slot;
+    frame.arrived = q.arrived;
+    return true;
+}
+
+void FrameStream::release(StreamFrame &frame) {
+    if (frame.slot < 0)
+        return;
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - frame.arrived).count();
+    const size_t bucket = std::min(latency_.size() - 1, static_cast<size_t>(ms * 1000.0 / LATENCY_BUCKET_US));
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(frame.slot);
+    drained_.notify_one();
+    ++processed_;
+    ++latency_[bucket];
+    latencySumMs_ += ms;
+    latencyMaxMs_ = std::max(latencyMaxMs_, ms);
+    frame.slot = -1;
+    frame.image.release();
+}
+
+StreamStats FrameStream::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StreamStats s;
+    s.read = read_;
+    s.dropped = dropped_;
+    s.processed = processed_;
+    s.maxQueued = maxQueued_;
+    if (processed_ == 0)
+        return s;
+    s.meanMs = latencySumMs_ / processed_;
+    s.maxMs = latencyMaxMs_;
+    // Upper edge of the bucket holding the quantile (the maximum for the open-ended one)
+    auto quantile = [&](double q) {
+        const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(q * processed_ + 0.5));
+        int64_t seen = 0;
+        for (size_t b = 0; b + 1 < latency_.size(); ++b)
+            if ((seen += latency_[b]) >= rank)
+                return std::min(latencyMaxMs_, (b + 1) * LATENCY_BUCKET_US / 1000.0);
+        return latencyMaxMs_;
+    };
+    s.p50Ms = quantile(0.50);
+    s.p99Ms = quantile(0.99);
+    return s;
+}
+
+bool isStreamPath(const std::string &path) {
+    std::error_code ec;
+    return path == "-" || std::filesystem::is_fifo(path, ec);
+}
+
+StreamFormat parseStreamFormat(const std::string &name) {
+    if (name == "y4m")  return StreamFormat::Y4M;
+    if (name == "gray") return StreamFormat::Gray;
+    if (name == "bgr")  return StreamFormat::BGR;
+    throw std::invalid_argument("Unknown stream format: " + name + " (y4m, gray or bgr)");
+}
+
+DropPolicy parseDropPolicy(const std::string &name) {
+    if (name == "block")  return DropPolicy::Block;
+    if (name == "oldest") return DropPolicy::Oldest;
+    if (name == "newest") return DropPolicy::Newest;
+    throw std::invalid_argument("Unknown drop policy: " + name + " (block, oldest or newest)");
+}
+
+cv::Size parseFrameSize(const std::string &text) {
+    std::istringstream in(text);
+    int w = 0, h = 0;
+    char x = 0;
+    if (!(in >> w >> x >> h) || x != 'x' || !(in >> std::ws).eof() || w <= 0 || h <= 0)
+        throw std::invalid_argument("Frame size must be WxH, got " + text);
+    return cv::Size(w, h);
+}
+
+void printStreamStats(const StreamStats &s, std::ostream &out) {
+    const double dropPct = s.read > 0 ? 100.0 * s.dropped / s.read : 0.0;
+    out << "Stream: " << s.read << " frames read, " << s.processed << " processed, " << s.dropped
+        << " dropped (" << dropPct << "%), queue peak " << s.maxQueued << "; latency mean " << s.meanMs
+        << " ms, p50 " << s.p50Ms << " ms, p99 " << s.p99Ms << " ms, max " << s.maxMs << " ms\n";
+}
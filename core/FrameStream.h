@@ -0,0 +1,158 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Layout of the frames of a stream input
+enum class StreamFormat {
+    None,    // not a stream: the input is a video file for cv::VideoCapture
+    Y4M,     // YUV4MPEG2, size and rate from its header; only the Y plane is kept
+    Gray,    // headerless 8-bit frames of StreamSpec::size
+    BGR      // headerless packed BGR24 frames of StreamSpec::size
+};
+
+// What the reader does with a new frame while the queue is full
+enum class DropPolicy {
+    Block,   // wait for a free slot; the writer stalls on the pipe, nothing is lost
+    Oldest,  // evict the oldest queued frame (lowest latency)
+    Newest   // discard the new frame (keeps the queued ones)
+};
+
+// How to read a stream input
+struct StreamSpec {
+    StreamFormat format = StreamFormat::None;
+    cv::Size size;                   // raw formats only
+    double fps = 25.0;               // raw formats only (tags the mask video)
+    int queue = 8;                   // frames buffered between the reader and processing
+    DropPolicy drop = DropPolicy::Block;
+
+    bool empty() const { return format == StreamFormat::None; }
+};
+
+// Counters of a stream run. Latency is measured from the moment a frame was
+// completely read until processing released it (time spent in the pipe
+// before that is not seen).
+struct StreamStats {
+    int64_t read = 0;                // frames read from the input
+    int64_t dropped = 0;             // frames read but never processed
+    int64_t processed = 0;           // frames released after processing
+    int maxQueued = 0;               // high-water mark of the queue
+    double meanMs = 0.0, p50Ms = 0.0, p99Ms = 0.0, maxMs = 0.0;
+};
+
+// One frame handed out by FrameStream::next()
+struct StreamFrame {
+    cv::Mat image;                   // view of a queue buffer (CV_8UC1, or CV_8UC3 for BGR)
+    int64_t index = -1;              // position in the input (gaps where frames were dropped)
+    int slot = -1;
+    std::chrono::steady_clock::time_point arrived;
+};
+
+// Unbounded frame source reading Y4M or raw frames from stdin ("-"), a FIFO
+// or a file, for inputs whose length is unknown up front.
+//
+// A reader thread reads every frame straight into one of a fixed pool of
+// buffers and queues it; next() hands the buffer itself to processing, which
+// gives it back with release(). The queue holds at most spec.queue frames;
+// once it is full, spec.drop decides whether the reader waits or a frame is
+// dropped. Frames are handed out in input order. Counters are kept as
+// "stream_frames" / "stream_drops" in the profile as well.
+class FrameStream {
+public:
+    // Reads the Y4M header (if any) and starts the reader. Throws
+    // std::runtime_error if the input cannot be opened, or
+    // std::invalid_argument for an unsupported or malformed format.
+    FrameStream(const std::string &path, const StreamSpec &spec);
+    // Stops the reader, interrupting a read that waits on the input (an
+    // idle pipe or terminal), and closes the input
+    ~FrameStream();
+    FrameStream(const FrameStream &) = delete;
+    FrameStream &operator=(const FrameStream &) = delete;
+
+    cv::Size size() const { return size_; }
+    double fps() const { return fps_; }
+
+    // Next frame, waiting for one to arrive; false at the end of the input.
+    // Rethrows errors of the reader (truncated frame, read failure).
+    bool next(StreamFrame &frame);
+    // Give the frame's buffer back to the reader and record its latency
+    void release(StreamFrame &frame);
+
+    StreamStats stats() const;
+
+private:
+    struct Queued {
+        int slot;
+        int64_t index;
+        std::chrono::steady_clock::time_point arrived;
+    };
+
+    void readHeader(const StreamSpec &spec);
+    bool readFrame(cv::Mat &buffer);
+    bool readLine(std::string &line, bool eofOk);
+    void readLoop();
+    // Input through in_: readSome() is one read of the descriptor, 0 at the
+    // end of the input or once the stream is stopping; readBytes() is short
+    // only at the end; getByte() is -1 at the end
+    size_t readSome(void *dst, size_t bytes);
+    size_t readBytes(void *dst, size_t bytes);
+    int getByte();
+    void closeInput();
+
+    std::string path_;
+    int fd_ = -1;
+    bool ownFd_ = false;             // false for stdin
+#ifndef _WIN32
+    int wake_[2] = {-1, -1};         // stop pipe: a byte on it interrupts readSome()
+#endif
+    std::vector<uchar> in_;
+    size_t inPos_ = 0, inEnd_ = 0;
+    StreamFormat format_;
+    DropPolicy drop_;
+    cv::Size size_;
+    double fps_ = 0.0;
+    size_t skipBytes_ = 0;           // chroma bytes per Y4M frame, read and discarded
+    std::vector<uchar> skip_;
+
+    std::vector<cv::Mat> buffers_;   // queue + 2: one being read, one being processed
+    std::vector<int> free_;
+    std::deque<Queued> queue_;
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable filled_, drained_;
+    bool done_ = false, stop_ = false;
+    std::exception_ptr error_;
+    std::thread reader_;
+
+    // Latency histogram in LATENCY_BUCKET_US steps, the last bucket open-ended
+    static constexpr int LATENCY_BUCKET_US = 100;
+    std::vector<int64_t> latency_;
+    int64_t read_ = 0, dropped_ = 0, processed_ = 0;
+    int maxQueued_ = 0;
+    double latencySumMs_ = 0.0, latencyMaxMs_ = 0.0;
+};
+
+// True for inputs read as streams: "-" (stdin) and FIFOs
+bool isStreamPath(const std::string &path);
+
+// "y4m", "gray", "bgr" → format; "block", "oldest", "newest" → policy.
+// Throw std::invalid_argument for anything else.
+StreamFormat parseStreamFormat(const std::string &name);
+DropPolicy parseDropPolicy(const std::string &name);
+// "WxH" → size; throws std::invalid_argument if malformed or not positive
+cv::Size parseFrameSize(const std::string &text);
+
+// One-line summary: frames, drops, queue high-water mark, latency percentiles
+void printStreamStats(const StreamStats &stats, std::ostream &out);
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,504 @@
+#include "LocalBackend.h"
+#include "VideoProcessor.h"
+#include "FrameKernels.h"
+#include "FrameRegion.h"
+#include "FrameStream.h"
+#include "FrameSampler.h"
+#include "PercentileBackground.h"
+#include "LumaCache.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Exact (two decode passes) or approximate (one pass) percentile background
+cv::Mat percentileBackground(const std::string &inVid, const VideoMeta &meta,
+                             const LocalOptions &opts) {
+    const FrameRange all{0, meta.totalFrames};
+    cv::Mat background;
+    if (opts.engine == PercentileEngine::Approx) {
+        approximatePercentile(inVid, all, cv::Size(meta.width, meta.height),
+                              opts.percentile, background);
+        return background;
+    }
+
+    PixelHistogram hist(meta.height, meta.width);
+    cv::Mat coarse, fine;
+    // The rank counts the frames actually read, not the header's estimate
+    const int frames = accumulateHistogram(inVid, all, cv::Mat(), hist).framesDecoded;
+    if (frames == 0)
+        throw std::runtime_error("No frames could be read from " + inVid);
+    cv::Mat rank(meta.height, meta.width, CV_32S, cv::Scalar(percentileRank(opts.percentile, frames)));
+    selectHistogramBin(hist.totals(), rank, coarse);
+    hist.reset();
+    accumulateHistogram(inVid, all, coarse, hist);
+    selectHistogramBin(hist.totals(), rank, fine);
+    // value = coarse * 16 + fine
+    cv::scaleAdd(coarse, PixelHistogram::BINS, fine, background);
+    return background;
+}
+
+// Plain mean background: one decode pass into an exact sum
+cv::Mat meanBackgroundOf(const std::string &inVid, const VideoMeta &meta) {
+    int sumType = meta.totalFrames <= MAX_U32_ACCUMULATED_FRAMES ? CV_32S : CV_64F;
+    cv::Mat sum = cv::Mat::zeros(meta.height, meta.width, sumType);
+    computeLocalSum(inVid, FrameRange{0, meta.totalFrames}, sum);
+    return meanBackground(sum, meta.totalFrames);
+}
+
+// Threshold sweep: one background pass per model, then a single decode that
+// evaluates every (model, threshold) pair. Backgrounds are written to bgOut
+// tagged with the model, per-frame counts to <fgOut>_sweep.csv and, with
+// sweepMasks, the masks to fgOut tagged with model and threshold.
+void runSweep(const std::string &inVid, const std::string &bgOut, const std::string &fgOut,
+              const VideoMeta &meta, const LocalOptions &opts) {
+    const std::vector<SweepModel> models = sweepModelsOf(opts);
+    std::vector<std::string> names;
+    std::vector<cv::Mat> backgrounds;
+    {
+        Profiler::Scope scope("background_pass");
+        for (const SweepModel &m : models) {
+            LocalOptions modelOpts = opts;
+            modelOpts.percentile = m.percentile;
+            cv::Mat bg = m.model == BackgroundModel::Percentile ? percentileBackground(inVid, meta, modelOpts)
+                                                                 : meanBackgroundOf(inVid, meta);
+            const std::string out = taggedPath(bgOut, m.name());
+            if (!writeFrameImage(out, bg))
+                throw std::runtime_error("Cannot write background: " + out);
+            names.push_back(m.name());
+            backgrounds.push_back(bg);
+        }
+    }
+
+    std::vector<std::string> maskOuts;
+    if (opts.sweepMasks)
+        for (const auto &name : names)
+            for (double t : opts.sweep)
+                maskOuts.push_back(taggedPath(fgOut, sweepTag(name, t)));
+    std::vector<int> counts;
+    {
+        Profiler::Scope scope("foreground_pass");
+        sweepForegroundSegment(inVid, backgrounds, FrameRange{0, meta.totalFrames}, meta.fps,
+                               opts.sweep, counts, maskOuts);
+    }
+    const std::string csv = std::filesystem::path(taggedPath(fgOut, "sweep")).replace_extension(".csv").string();
+    writeSweepCsv(names, opts.sweep, counts, csv, meta.width * meta.height);
+    printSweepSummary(names, opts.sweep, counts, meta.width * meta.height, std::cout);
+    std::cout << "Sweep counts → " << csv << "\n";
+}
+
+// Mean background of a sample of the frames, stopping early once the
+// estimate settles (SampleSpec)
+cv::Mat sampledBackground(const std::string &inVid, const VideoMeta &meta, const LocalOptions &opts,
+                          const std::string &bgOut) {
+    const std::vector<int> keyframes =
+        opts.sample.mode == SampleMode::Keyframes ? scanKeyframes(inVid) : std::vector<int>();
+    const SamplePlan plan(opts.sample, meta.totalFrames, keyframes);
+    int sumType = meta.totalFrames <= MAX_U32_ACCUMULATED_FRAMES ? CV_32S : CV_64F;
+    cv::Mat sum = cv::Mat::zeros(meta.height, meta.width, sumType);
+    const SampleStats s = sampleLocalSum(inVid, plan, FrameRange{0, meta.totalFrames}, sum,
+                                         [](double change) { return change; });
+    std::cout << "Sampled " << s.frames << " of " << meta.totalFrames << " frames in " << s.rounds
+              << (s.rounds == 1 ? " round" : " rounds") << (s.converged ? " (converged)" : "") << "\n";
+    return writeBackground(sum, s.frames, bgOut);
+}
+
+// Mean background through a resumable checkpoint: only frames the checkpoint
+// does not cover yet are decoded, and it is saved after every chunk
+cv::Mat checkpointedBackground(const std::string &inVid, const VideoMeta &meta,
+                               const LocalOptions &opts) {
+    AccumulatorCheckpoint ckpt = AccumulatorCheckpoint::open(opts.checkpoint, cv::Size(meta.width, meta.height));
+    const CheckpointSource source = checkpointSource(inVid);
+    const std::vector<FrameRange> gaps = ckpt.missing(source, meta.totalFrames);
+    if (gaps.empty())
+        std::cout << "Checkpoint " << opts.checkpoint << " already covers " << source.name << "\n";
+    else if (ckpt.frames() > 0)
+        std::cout << "Resuming from checkpoint " << opts.checkpoint << " (" << ckpt.frames() << " frames)\n";
+    cv::Mat sum(meta.height, meta.width, CV_64F);
+    for (const FrameRange &gap : gaps) {
+        for (int b = gap.begin; b < gap.end; b += opts.checkpointEvery) {
+            const FrameRange chunk{b, std::min(b + opts.checkpointEvery, gap.end)};
+            sum.setTo(0);
+            computeLocalSum(inVid, chunk, sum);
+            ckpt.add(source, chunk, sum);
+            Profiler::Scope scope("checkpoint");
+            ckpt.save(opts.checkpoint);
+        }
+    }
+    return ckpt.background();
+}
+
+// Stream input: frames through a single-pass model until the stream ends,
+// then the queue's drop and latency counters. Returns the frame size.
+cv::Size runStream(const std::string &inVid, const StreamSpec &spec, const std::string &bgOut,
+                   const std::string &fgOut, const LocalOptions &opts, std::vector<int> *fgCounts) {
+    if (!(opts.singlePass || opts.model == BackgroundModel::Mixture) || !opts.sweep.empty() ||
+        opts.window > 0 || opts.segment > 0 || !opts.lumaCache.empty() || !opts.checkpoint.empty() ||
+        !opts.sample.empty())
+        throw std::invalid_argument("Stream inputs are read once with no frame count up front;"
+                                    " use the single-pass or mixture model");
+    FrameStream stream(inVid, spec);
+    std::cout << "Stream " << inVid << ": " << stream.size().width << "x" << stream.size().height
+              << " at " << stream.fps() << " fps, queue " << spec.queue << "\n";
+    cv::Mat background;
+    {
+        Profiler::Scope scope("foreground_pass");
+        liveForegroundSegment(stream, opts.threshold, opts.alpha, opts.warmup,
+                              opts.model == BackgroundModel::Mixture ? &opts.mixture : nullptr,
+                              fgOut, background, fgCounts);
+    }
+    printStreamStats(stream.stats(), std::cout);
+    if (background.empty())
+        throw std::runtime_error("Input stream has no frames: " + inVid);
+    if (!writeFrameImage(bgOut, background))
+        throw std::runtime_error("Cannot write background: " + bgOut);
+    return stream.size();
+}
+
+// Motion CSV, profile and trace of a finished run
+void writeReports(const LocalOptions &opts, const std::vector<int> *fgCounts, int pixelsPerFrame) {
+    if (fgCounts)
+        writeMotionCsv(*fgCounts, opts.motionCsv, pixelsPerFrame);
+    if (!opts.profile.empty()) {
+        Profiler::writeSummary({Profiler::summaryJson(0)}, opts.profile);
+        std::cout << "Profile → " << opts.profile << "\n";
+    }
+    if (!opts.trace.empty()) {
+        Profiler::writeChromeTrace({Profiler::traceEventsJson(0)}, opts.trace);
+        std::cout << "Trace → " << opts.trace << "\n";
+    }
+}
+
+} // namespace
+
+std::string SweepModel::name() const {
+    if (model == BackgroundModel::Mean)
+        return "mean";
+    if (percentile == 50.0)
+        return "median";
+    std::ostringstream out;
+    out << "p" << percentile;
+    return out.str();
+}
+
+std::vector<double> parseThresholds(const std::string &list) {
+    std::vector<double> thresholds;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) {
+        size_t used = 0;
+        double t = 0.0;
+        try {
+            t = std::stod(item, &used);
+        } catch (const std::exception &) {
+            used = 0;
+        }
+        if (used == 0 || used != item.size())
+            throw std::invalid_argument("Bad threshold: '" + item + "'");
+        thresholds.push_back(t);
+    }
+    if (thresholds.empty())
+        throw std::invalid_argument("Empty threshold list");
+    return thresholds;
+}
+
+std::vector<SweepModel> parseSweepModels(const std::string &list) {
+    std::vector<SweepModel> models;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) {
+        SweepModel m;
+        if (item == "median") {
+            m.model = BackgroundModel::Percentile;
+        } else if (item.size() > 1 && item[0] == 'p') {
+            m.model = BackgroundModel::Percentile;
+            m.percentile = parseThresholds(item.substr(1)).front();
+            if (m.percentile < 0.0 || m.percentile > 100.0)
+                throw std::invalid_argument("Percentile out of range: " + item);
+        } else if (item != "mean") {
+            throw std::invalid_argument("Unknown sweep model: '" + item + "' (mean, median or pNN)");
+        }
+        models.push_back(m);
+    }
+    if (models.empty())
+        throw std::invalid_argument("Empty sweep model list");
+    return models;
+}
+
+void parseLocalOptions(int argc, char *argv[], LocalOptions &opts, std::string &inputPath) {
+    bool percentileSet = false, sampleGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string flag = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+            return argv[++i];
+        };
+        if (flag == "--threshold") {
+            opts.threshold = std::stod(value());
+        } else if (flag == "--single-pass") {
+            opts.singlePass = true;
+        } else if (flag == "--alpha") {
+            opts.alpha = std::stod(value());
+            if (!(opts.alpha >= 0.0 && opts.alpha <= 1.0))
+                throw std::invalid_argument("--alpha must be in [0, 1]");
+        } else if (flag == "--warmup") {
+            opts.warmup = std::stoi(value());
+            if (opts.warmup < 0) throw std::invalid_argument("--warmup must not be negative");
+        } else if (flag == "--model") {
+            const std::string v = value();
+            if (v == "mean") {
+                opts.model = BackgroundModel::Mean;
+            } else if (v == "median") {
+                opts.model = BackgroundModel::Percentile;
+                opts.percentile = 50.0;
+            } else if (v == "mog") {
+                opts.model = BackgroundModel::Mixture;
+            } else {
+                throw std::invalid_argument("Unknown background model: " + v);
+            }
+        } else if (flag == "--percentile") {
+            percentileSet = true;
+            opts.percentile = std::stod(value());
+            if (opts.percentile < 0.0 || opts.percentile > 100.0)
+                throw std::invalid_argument("--percentile must be within [0, 100]");
+        } else if (flag == "--engine") {
+            const std::string v = value();
+            if      (v == "hist")   opts.engine = PercentileEngine::Histogram;
+            else if (v == "approx") opts.engine = PercentileEngine::Approx;
+            else throw std::invalid_argument("Unknown percentile engine: " + v);
+        } else if (flag == "--mog-k") {
+            opts.mixture.components = std::stoi(value());
+            if (opts.mixture.components < 1 || opts.mixture.components > MixtureBackground::MAX_COMPONENTS)
+                throw std::invalid_argument("--mog-k must be within [1, 5]");
+        } else if (flag == "--mog-rate") {
+            opts.mixture.learningRate = std::stof(value());
+            if (!(opts.mixture.learningRate > 0.0f && opts.mixture.learningRate <= 1.0f))
+                throw std::invalid_argument("--mog-rate must be within (0, 1]");
+        } else if (flag == "--sweep") {
+            opts.sweep = parseThresholds(value());
+        } else if (flag == "--sweep-models") {
+            opts.sweepModels = parseSweepModels(value());
+        } else if (flag == "--sweep-masks") {
+            opts.sweepMasks = true;
+        } else if (flag == "--window") {
+            opts.window = std::stoi(value());
+            if (opts.window < 1) throw std::invalid_argument("--window must be at least 1");
+        } else if (flag == "--segment") {
+            opts.segment = std::stoi(value());
+            if (opts.segment < 1) throw std::invalid_argument("--segment must be at least 1");
+        } else if (flag == "--roi") {
+            opts.region.rois.push_back(parseRoi(value()));
+        } else if (flag == "--roi-mask") {
+            opts.region.maskPath = value();
+        } else if (flag == "--downscale") {
+            opts.region.scale = std::stoi(value());
+            if (opts.region.scale < 1) throw std::invalid_argument("--downscale must be at least 1");
+        } else if (flag == "--stream") {
+            opts.stream.format = parseStreamFormat(value());
+        } else if (flag == "--stream-size") {
+            opts.stream.size = parseFrameSize(value());
+        } else if (flag == "--stream-fps") {
+            opts.stream.fps = std::stod(value());
+            if (!(opts.stream.fps > 0.0)) throw std::invalid_argument("--stream-fps must be positive");
+        } else if (flag == "--queue") {
+            opts.stream.queue = std::stoi(value());
+            if (opts.stream.queue < 1) throw std::invalid_argument("--queue must be at least 1");
+        } else if (flag == "--drop") {
+            opts.stream.drop = parseDropPolicy(value());
+        } else if (flag == "--sample") {
+            const double tolerance = opts.sample.tolerance;
+            opts.sample = parseSampleSpec(value());
+            opts.sample.tolerance = tolerance;
+            sampleGiven = true;
+        } else if (flag == "--sample-tol") {
+            opts.sample.tolerance = std::stod(value());
+            if (!(opts.sample.tolerance > 0.0)) throw std::invalid_argument("--sample-tol must be positive");
+        } else if (flag.rfind("--", 0) != 0 && inputPath.empty()) {
+            inputPath = flag;
+        } else {
+            throw std::invalid_argument("Unknown option: " + flag);
+        }
+    }
+    // --percentile alone picks the percentile model
+    if (percentileSet && opts.model == BackgroundModel::Mean)
+        opts.model = BackgroundModel::Percentile;
+    if (opts.singlePass && opts.model != BackgroundModel::Mean)
+        throw std::invalid_argument("--single-pass uses a running mean; drop --model/--percentile");
+    if (opts.sample.tolerance > 0.0 && opts.sample.empty())
+        throw std::invalid_argument(sampleGiven ? "--sample 1 reads every frame, so there is nothing for --sample-tol"
+                                                  " to stop early; use --sample adaptive"
+                                                : "--sample-tol needs --sample");
+}
+
+std::vector<SweepModel> sweepModelsOf(const LocalOptions &opts) {
+    if (!opts.sweepModels.empty())
+        return opts.sweepModels;
+    SweepModel m;
+    m.model = opts.model;
+    m.percentile = opts.percentile;
+    return {m};
+}
+
+std::vector<std::string> listVideos(const std::string &dir) {
+    namespace fs = std::filesystem;
+    if (!fs::is_directory(dir))
+        throw std::runtime_error("Not a directory: " + dir);
+    static const char *const EXTENSIONS[] = {".mp4", ".avi", ".mov", ".mkv", ".m4v"};
+    std::vector<std::string> videos;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (std::find(std::begin(EXTENSIONS), std::end(EXTENSIONS), ext) != std::end(EXTENSIONS))
+            videos.push_back(entry.path().string());
+    }
+    std::sort(videos.begin(), videos.end());
+    return videos;
+}
+
+std::string outputStem(const std::vector<std::string> &videos, size_t i) {
+    namespace fs = std::filesystem;
+    auto stemOf = [&](size_t k) { return fs::path(videos[k]).stem().string(); };
+    auto taken = [&](const std::string &name) {
+        for (size_t k = 0; k < videos.size(); ++k)
+            if (k != i && stemOf(k) == name) return true;
+        return false;
+    };
+    std::string name = stemOf(i);
+    if (!taken(name))
+        return name;
+    const std::string ext = fs::path(videos[i]).extension().string();
+    if (!ext.empty())
+        name += "_" + ext.substr(1);
+    // Still ambiguous (clip.mp4 next to clip_mp4.avi): fall back to the list position
+    return taken(name) ? name + "_" + std::to_string(i) : name;
+}
+
+void runLocal(const std::string &inVid, const std::string &bgOut,
+              const std::string &fgOut, const LocalOptions &opts) {
+#ifdef _OPENMP
+    if (opts.threads > 0)
+        omp_set_num_threads(opts.threads);
+#endif
+    if (!opts.profile.empty() || !opts.trace.empty())
+        Profiler::enable(!opts.trace.empty());
+    if (!opts.region.empty() && (!opts.lumaCache.empty() || !opts.checkpoint.empty()))
+        throw std::invalid_argument("Luma caches and checkpoints hold whole frames; drop the ROI or scale");
+    setDecodeMode(opts.decode);
+    setRegionSpec(opts.region);
+    std::vector<int> counts;
+    std::vector<int> *fgCounts = opts.motionCsv.empty() ? nullptr : &counts;
+
+    StreamSpec stream = opts.stream;
+    if (stream.empty() && isStreamPath(inVid))
+        stream.format = StreamFormat::Y4M;
+    if (!stream.empty()) {
+        const cv::Size size = runStream(inVid, stream, bgOut, fgOut, opts, fgCounts);
+        writeReports(opts, fgCounts, size.area());
+        return;
+    }
+
+    VideoMeta meta = readVideoMeta(inVid);
+    if (meta.totalFrames <= 0)
+        throw std::runtime_error("Input video has no frames: " + inVid);
+    const FrameRange all{0, meta.totalFrames};
+
+    if (!opts.sample.empty() &&
+        (opts.singlePass || opts.model != BackgroundModel::Mean || !opts.sweep.empty() || opts.window > 0 ||
+         opts.segment > 0 || !opts.lumaCache.empty() || !opts.checkpoint.empty()))
+        throw std::invalid_argument("Sampling builds the plain mean background from a subset of the frames");
+    if (opts.window > 0 || opts.segment > 0) {
+        if (opts.window > 0 && opts.segment > 0)
+            throw std::invalid_argument("Choose a sliding window or segments, not both");
+        if (opts.singlePass || opts.model != BackgroundModel::Mean || !opts.sweep.empty() ||
+            !opts.lumaCache.empty() || !opts.checkpoint.empty())
+            throw std::invalid_argument("Windowed and segmented backgrounds are plain means of their frames");
+    }
+
+    cv::Mat background;
+    if (!opts.sweep.empty()) {
+        if (opts.singlePass || opts.model == BackgroundModel::Mixture)
+            throw std::invalid_argument("A sweep needs a mean or percentile background");
+        runSweep(inVid, bgOut, fgOut, meta, opts);
+    } else if (opts.window > 0 || opts.segment > 0) {
+        // Backgrounds that follow the scene; bgOut gets the first frame's
+        Profiler::Scope scope("foreground_pass");
+        if (opts.window > 0)
+            windowForegroundSegment(inVid, all, meta.totalFrames, opts.window, meta.fps, opts.threshold,
+                                    fgOut, &background, fgCounts);
+        else
+            segmentedForegroundSegment(inVid, all, meta.totalFrames, opts.segment, meta.fps, opts.threshold,
+                                       fgOut, cv::Mat(), cv::Mat(), &background, fgCounts);
+        if (!writeFrameImage(bgOut, background))
+            throw std::runtime_error("Cannot write background: " + bgOut);
+    } else if (opts.singlePass) {
+        // Background and foreground in one decode
+        streamForegroundSegment(inVid, all, meta.fps, opts.threshold, opts.alpha, opts.warmup,
+                                fgOut, background, fgCounts);
+        if (!writeFrameImage(bgOut, background))
+            throw std::runtime_error("Cannot write background: " + bgOut);
+    } else if (opts.model == BackgroundModel::Mixture) {
+        double modelSeconds = 0.0;
+        const DecodeStats stats = mixtureForegroundSegment(inVid, all, meta.fps, opts.mixture, fgOut,
+                                                           background, modelSeconds, fgCounts);
+        if (!writeFrameImage(bgOut, background))
+            throw std::runtime_error("Cannot write background: " + bgOut);
+        // The 1080p figure scales the measured rate by pixel count; it is not measured
+        double fps = modelSeconds > 0.0 ? stats.framesDecoded / modelSeconds : 0.0;
+        std::cout << "Mixture model (K=" << opts.mixture.components << "): " << fps << " frames/s, ~"
+                  << fps * meta.width * meta.height / (1920.0 * 1080.0)
+                  << " frames/s at 1080p (estimated from the pixel count)\n";
+    } else {
+        std::unique_ptr<LumaCache> cache;
+        {
+            Profiler::Scope scope("background_pass");
+            if (opts.model == BackgroundModel::Percentile) {
+                background = percentileBackground(inVid, meta, opts);
+                if (!writeFrameImage(bgOut, background))
+                    throw std::runtime_error("Cannot write background: " + bgOut);
+            } else if (!opts.checkpoint.empty()) {
+                background = checkpointedBackground(inVid, meta, opts);
+                if (!writeFrameImage(bgOut, background))
+                    throw std::runtime_error("Cannot write background: " + bgOut);
+            } else if (!opts.sample.empty()) {
+                background = sampledBackground(inVid, meta, opts, bgOut);
+            } else {
+                // Exact uint32 sums unless the video is long enough to overflow them
+                int sumType = meta.totalFrames <= MAX_U32_ACCUMULATED_FRAMES ? CV_32S : CV_64F;
+                cv::Mat sum = cv::Mat::zeros(meta.height, meta.width, sumType);
+                if (!opts.lumaCache.empty() && LumaCache::matches(opts.lumaCache, inVid)) {
+                    std::cout << "Using luma cache " << opts.lumaCache << "\n";
+                    cache = std::make_unique<LumaCache>(opts.lumaCache);
+                    computeLocalSum(*cache, all, sum);
+                } else if (!opts.lumaCache.empty()) {
+                    // Fill the cache during this pass; the foreground pass reads it back
+                    LumaCacheWriter::create(opts.lumaCache, inVid, meta);
+                    {
+                        LumaCacheWriter writer(opts.lumaCache);
+                        computeLocalSum(inVid, all, sum, &writer);
+                        writer.close();
+                    }
+                    LumaCacheWriter::finalize(opts.lumaCache);
+                    cache = std::make_unique<LumaCache>(opts.lumaCache);
+                } else {
+                    computeLocalSum(inVid, all, sum);
+                }
+                background = writeBackground(sum, meta.totalFrames, bgOut);
+            }
+        }
+        Profiler::Scope scope("foreground_pass");
+        if (cache)
+            generateForegroundSegment(*cache, background, all, meta.fps, opts.threshold, fgOut, fgCounts);
+        else
+            generateForegroundSegment(inVid, background, all, meta.fps, opts.threshold, fgOut, fgCounts);
+    }
+
+    writeReports(opts, fgCounts, meta.width * meta.height);
+}
@@ -0,0 +1,92 @@
+#ifndef LOCAL_BACKEND_H
+#define LOCAL_BACKEND_H
+
+#include "MixtureBackground.h"
+#include "FrameSource.h"
+#include "FrameRegion.h"
+#include "FrameStream.h"
+#include "FrameSampler.h"
+#include "AccumulatorCheckpoint.h"
+#include <string>
+#include <vector>
+
+// Per-pixel statistic used as the background
+enum class BackgroundModel {
+    Mean,         // arithmetic mean of all frames
+    Percentile,   // per-pixel percentile (median = 50)
+    Mixture       // per-pixel Gaussian mixture, updated every frame
+};
+
+// How the percentile background is computed
+enum class PercentileEngine {
+    Histogram,    // exact: two decode passes over mergeable 16-bin histograms
+    Approx        // one decode pass, streaming estimate
+};
+
+// One background of a threshold sweep: the mean or a per-pixel percentile
+struct SweepModel {
+    BackgroundModel model = BackgroundModel::Mean;
+    double percentile = 50.0;
+    std::string name() const;        // "mean", "median", "p25", ...
+};
+
+// Options of the single-process backends. The sequential backend is this
+// code path with a team of one thread; the OpenMP backend uses a full team.
+struct LocalOptions {
+    double threshold = 30.0;
+    int threads = 1;                 // OpenMP team size (0 = OpenMP default)
+    bool singlePass = false;         // running background, one decode
+    double alpha = 0.0;              // single-pass learning rate (<= 0 = cumulative mean)
+    int warmup = 0;                  // single-pass frames used to seed the model
+    BackgroundModel model = BackgroundModel::Mean;
+    double percentile = 50.0;
+    PercentileEngine engine = PercentileEngine::Histogram;
+    MixtureParams mixture;
+    std::string motionCsv;           // per-frame foreground counts, if set
+    std::string profile;             // stage timers and counters as JSON, if set
+    std::string trace;               // Chrome trace timeline, if set
+    std::string lumaCache;           // mean model: decoded luma kept here for reruns, if set
+    std::string checkpoint;          // mean model: resumable accumulator file, if set
+    int checkpointEvery = DEFAULT_CHECKPOINT_FRAMES;  // frames folded in between checkpoint saves
+    DecodeMode decode = DecodeMode::BGR;
+    std::vector<double> sweep;       // thresholds of a sweep run, if set (one decode for all)
+    std::vector<SweepModel> sweepModels;  // sweep backgrounds (empty = model/percentile)
+    bool sweepMasks = false;         // also write the masks of every sweep pair
+    int window = 0;                  // mean of the surrounding `window` frames per frame, if set
+    int segment = 0;                 // mean of each run of `segment` frames, if set
+    RegionSpec region;               // ROIs and resolution to work at (empty = whole frame)
+    StreamSpec stream;               // read the input as a frame stream (empty = video file;
+                                     // "-" and FIFOs default to Y4M)
+    SampleSpec sample;               // mean model: frames the background is built from (empty = all)
+};
+
+// Runs the whole workflow in this process: background image to bgOut and
+// foreground masks to fgOut (paths used as given). Stream inputs run until
+// the stream ends, with a single-pass model. Throws std::runtime_error on I/O
+// errors.
+void runLocal(const std::string &inVid, const std::string &bgOut,
+              const std::string &fgOut, const LocalOptions &opts);
+
+// Comma-separated thresholds ("10,20,30") and sweep models ("mean,median,p25").
+// Throw std::invalid_argument on malformed lists.
+std::vector<double> parseThresholds(const std::string &list);
+std::vector<SweepModel> parseSweepModels(const std::string &list);
+
+// Command line of the sequential and OpenMP front ends: options go into
+// opts (threads as the caller set it), the first non-option argument into
+// inputPath. Applies the same limits as the MPI front end; throws
+// std::invalid_argument on unknown options, missing or malformed values,
+// out-of-range values and conflicting options.
+void parseLocalOptions(int argc, char *argv[], LocalOptions &opts, std::string &inputPath);
+
+// Backgrounds of a sweep run: opts.sweepModels, or the run's own model
+std::vector<SweepModel> sweepModelsOf(const LocalOptions &opts);
+
+// Video files (.mp4, .avi, .mov, .mkv, .m4v) directly inside dir, sorted by
+// name. Throws std::runtime_error if dir is not a directory.
+std::vector<std::string> listVideos(const std::string &dir);
+// Output name of videos[i]: its file stem, plus the extension ("clip_avi")
+// when another video of the list has the same stem, so outputs never collide
+std::string outputStem(const std::vector<std::string> &videos, size_t i);
+
+#endif // LOCAL_BACKEND_H
@@ -0,0 +1,190 @@
+#include "LumaCache.h"
+#include "VideoProcessor.h"
+#include "FrameSource.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[8] = "BGLUMA1";
+
+size_t frameBytes(const LumaCacheHeader &h) {
+    return static_cast<size_t>(h.width) * h.height;
+}
+
+// Size and modification time identify the source video
+void sourceIdentity(const std::string &source, uint64_t &size, int64_t &time) {
+    namespace fs = std::filesystem;
+    size = static_cast<uint64_t>(fs::file_size(source));
+    time = static_cast<int64_t>(fs::last_write_time(source).time_since_epoch().count());
+}
+
+bool readHeader(const std::string &path, LumaCacheHeader &h) {
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    bool ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0;
+    std::fclose(f);
+    return ok;
+}
+
+} // namespace
+
+void LumaCacheWriter::create(const std::string &path, const std::string &source, const VideoMeta &meta) {
+    if (meta.width <= 0 || meta.height <= 0 || meta.totalFrames <= 0)
+        throw std::invalid_argument("Luma cache needs a non-empty video");
+    LumaCacheHeader h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.width = static_cast<uint32_t>(meta.width);
+    h.height = static_cast<uint32_t>(meta.height);
+    h.frames = static_cast<uint32_t>(meta.totalFrames);
+    h.complete = 0;
+    h.fps = meta.fps;
+    h.decode = static_cast<uint32_t>(decodeMode());
+    sourceIdentity(source, h.sourceSize, h.sourceTime);
+
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        throw std::runtime_error("Cannot create luma cache: " + path);
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+    std::fclose(f);
+    if (!ok)
+        throw std::runtime_error("Cannot write luma cache header: " + path);
+    // Reserve every frame up front so writers can fill any offset
+    std::filesystem::resize_file(path, sizeof(h) + frameBytes(h) * h.frames);
+}
+
+void LumaCacheWriter::finalize(const std::string &path) {
+    std::FILE *f = std::fopen(path.c_str(), "r+b");
+    if (!f)
+        throw std::runtime_error("Cannot open luma cache: " + path);
+    const uint32_t complete = 1;
+    bool ok = std::fseek(f, offsetof(LumaCacheHeader, complete), SEEK_SET) == 0 &&
+              std::fwrite(&complete, sizeof(complete), 1, f) == 1;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error("Cannot finalize luma cache: " + path);
+}
+
+LumaCacheWriter::LumaCacheWriter(const std::string &path) : path_(path) {
+    if (!readHeader(path, header_))
+        throw std::runtime_error("Not a luma cache: " + path);
+    file_ = std::fopen(path.c_str(), "r+b");
+    if (!file_)
+        throw std::runtime_error("Cannot open luma cache for writing: " + path);
+}
+
+LumaCacheWriter::~LumaCacheWriter() {
+    // Unwinding after an error; the cache is never finalized then
+    if (file_) std::fclose(file_);
+}
+
+void LumaCacheWriter::close() {
+    if (!file_)
+        return;
+    std::FILE *f = file_;
+    file_ = nullptr;
+    bool ok = std::fflush(f) == 0 && !std::ferror(f);
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error("Cannot write luma cache: " + path_);
+}
+
+void LumaCacheWriter::write(int index, const cv::Mat &gray) {
+    if (!file_)
+        throw std::logic_error("Luma cache writer already closed: " + path_);
+    if (index < 0 || static_cast<uint32_t>(index) >= header_.frames)
+        throw std::out_of_range("Frame " + std::to_string(index) + " is outside the luma cache");
+    if (gray.type() != CV_8U || gray.cols != static_cast<int>(header_.width) ||
+        gray.rows != static_cast<int>(header_.height))
+        throw std::invalid_argument("Luma cache frames must be CV_8U of the cache size");
+
+    const long long offset = static_cast<long long>(sizeof(header_) + frameBytes(header_) * index);
+#ifdef _WIN32
+    bool ok = _fseeki64(file_, offset, SEEK_SET) == 0;
+#else
+    bool ok = fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    for (int y = 0; ok && y < gray.rows; ++y)
+        ok = std::fwrite(gray.ptr<uchar>(y), 1, gray.cols, file_) == static_cast<size_t>(gray.cols);
+    if (!ok)
+        throw std::runtime_error("Cannot write frame " + std::to_string(index) + " to " + path_);
+}
+
+bool LumaCache::matches(const std::string &path, const std::string &source) {
+    LumaCacheHeader h;
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec) || !readHeader(path, h) || !h.complete)
+        return false;
+    uint64_t size = 0;
+    int64_t time = 0;
+    try {
+        sourceIdentity(source, size, time);
+    } catch (const std::filesystem::filesystem_error &) {
+        return false;
+    }
+    return h.sourceSize == size && h.sourceTime == time &&
+           h.decode == static_cast<uint32_t>(decodeMode()) &&
+           std::filesystem::file_size(path, ec) == sizeof(h) + frameBytes(h) * h.frames;
+}
+
+LumaCache::LumaCache(const std::string &path) {
+    if (!readHeader(path, header_) || !header_.complete)
+        throw std::runtime_error("Missing or incomplete luma cache: " + path);
+    length_ = sizeof(header_) + frameBytes(header_) * header_.frames;
+    if (std::filesystem::file_size(path) < length_)
+        throw std::runtime_error("Truncated luma cache: " + path);
+
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open luma cache: " + path);
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_)
+        data_ = static_cast<const uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, length_));
+    if (!data_) {
+        if (mapping_) CloseHandle(mapping_);
+        CloseHandle(file_);
+        throw std::runtime_error("Cannot map luma cache: " + path);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open luma cache: " + path);
+    void *map = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);   // the mapping keeps the file alive
+    if (map == MAP_FAILED)
+        throw std::runtime_error("Cannot map luma cache: " + path);
+    madvise(map, length_, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t *>(map);
+#endif
+}
+
+LumaCache::~LumaCache() {
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+#else
+    munmap(const_cast<uint8_t *>(data_), length_);
+#endif
+}
+
+cv::Mat LumaCache::frame(int i) const {
+    if (i < 0 || i >= frames())
+        throw std::out_of_range("Frame " + std::to_string(i) + " is outside the luma cache");
+    // cv::Mat has no const data view; callers only read through it
+    uint8_t *plane = const_cast<uint8_t *>(data_ + sizeof(header_) + frameBytes(header_) * i);
+    return cv::Mat(static_cast<int>(header_.height), static_cast<int>(header_.width), CV_8U, plane);
+}
@@ -0,0 +1,91 @@
+#ifndef LUMA_CACHE_H
+#define LUMA_CACHE_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct VideoMeta;
+
+// On-disk cache of decoded luma frames: a 64-byte header followed by every
+// frame's Y plane (width * height bytes, no padding) in frame order. Luma is
+// what FrameSource delivered in the decode mode recorded in the header.
+//
+// The header records the source file's size and modification time, so a
+// cache made from a different or edited video, or in another decode mode,
+// is never used. Frames are written at fixed offsets, so several processes
+// may fill disjoint frame ranges of one cache concurrently.
+struct LumaCacheHeader {
+    char magic[8];              // "BGLUMA1"
+    uint32_t width, height;
+    uint32_t frames;
+    uint32_t complete;          // set once every frame has been written
+    double fps;
+    uint64_t sourceSize;
+    int64_t sourceTime;         // source last_write_time, in clock ticks
+    uint32_t decode;            // DecodeMode the frames were decoded with
+    uint8_t reserved[12];
+};
+static_assert(sizeof(LumaCacheHeader) == 64, "cache header must stay 64 bytes");
+
+// Writes frames into a cache file that LumaCacheWriter::create() sized.
+// close() flushes and reports write errors; only a cache whose writers all
+// closed cleanly may be finalized. The destructor closes silently.
+class LumaCacheWriter {
+public:
+    // Create (or replace) path sized for meta.totalFrames frames of source.
+    // Call on one process before any writer opens the file.
+    static void create(const std::string &path, const std::string &source, const VideoMeta &meta);
+
+    // Mark the cache complete; call once, after every frame was written
+    static void finalize(const std::string &path);
+
+    explicit LumaCacheWriter(const std::string &path);
+    ~LumaCacheWriter();
+    LumaCacheWriter(const LumaCacheWriter &) = delete;
+    LumaCacheWriter &operator=(const LumaCacheWriter &) = delete;
+
+    // Store the luma plane (CV_8U, cache size) of frame index
+    void write(int index, const cv::Mat &gray);
+    // Flush and close; throws std::runtime_error if buffered frames did not
+    // reach the file
+    void close();
+
+private:
+    std::string path_;
+    LumaCacheHeader header_;
+    std::FILE *file_ = nullptr;
+};
+
+// Read-only, memory-mapped view of a complete cache
+class LumaCache {
+public:
+    // True if path holds a complete cache made from source as it is now,
+    // in the current decode mode
+    static bool matches(const std::string &path, const std::string &source);
+
+    // Maps the cache; throws std::runtime_error if it is missing, incomplete
+    // or truncated
+    explicit LumaCache(const std::string &path);
+    ~LumaCache();
+    LumaCache(const LumaCache &) = delete;
+    LumaCache &operator=(const LumaCache &) = delete;
+
+    int frames() const { return static_cast<int>(header_.frames); }
+    cv::Size size() const { return cv::Size(header_.width, header_.height); }
+    double fps() const { return header_.fps; }
+
+    // Zero-copy CV_8U view of frame i, valid while the cache is alive
+    cv::Mat frame(int i) const;
+
+private:
+    LumaCacheHeader header_;
+    const uint8_t *data_ = nullptr;   // start of the mapping (header included)
+    size_t length_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr, *mapping_ = nullptr;
+#endif
+};
+
+#endif // LUMA_CACHE_H
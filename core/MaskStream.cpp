@@ -0,0 +1,409 @@
+#include "MaskStream.h"
+#include "FrameKernels.h"
+#include "FrameRegion.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[8] = "BGMASK1";
+constexpr uint32_t VERSION = 1;
+
+void putVarint(std::vector<uint8_t> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+uint64_t getVarint(const uint8_t *&p, const uint8_t *end) {
+    uint64_t v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("Corrupt run length in mask stream");
+}
+
+// Run lengths of the whole frame plus its metadata, in one scan
+void encodeRuns(const cv::Mat &mask, EncodedMask &out) {
+    out.bytes.clear();
+    int foreground = 0, x0 = mask.cols, y0 = mask.rows, x1 = -1, y1 = -1;
+    bool current = false;   // runs start with background
+    uint64_t run = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar *m = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols;) {
+            const bool fg = m[x] != 0;
+            if (fg != current) {
+                putVarint(out.bytes, run);
+                run = 0;
+                current = fg;
+            }
+            // Extend the run as far as this row allows
+            int end = x + 1;
+            while (end < mask.cols && (m[end] != 0) == fg) ++end;
+            if (fg) {
+                foreground += end - x;
+                x0 = std::min(x0, x);
+                x1 = std::max(x1, end - 1);
+                y0 = std::min(y0, y);
+                y1 = y;
+            }
+            run += end - x;
+            x = end;
+        }
+    }
+    putVarint(out.bytes, run);
+    out.codec = MASK_RLE;
+    out.foreground = foreground;
+    out.bbox = x1 < 0 ? cv::Rect() : cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+// encodeRuns for a bit-packed mask; bytes of eight equal pixels extend a
+// run in one step
+void encodePackedRuns(const cv::Mat &bits, int cols, EncodedMask &out) {
+    out.bytes.clear();
+    int foreground = 0, x0 = cols, y0 = bits.rows, x1 = -1, y1 = -1;
+    bool current = false;   // runs start with background
+    uint64_t run = 0;
+    auto bit = [](const uint8_t *b, int x) { return ((b[x >> 3] >> (x & 7)) & 1) != 0; };
+    for (int y = 0; y < bits.rows; ++y) {
+        const uint8_t *b = bits.ptr<uint8_t>(y);
+        for (int x = 0; x < cols;) {
+            const bool fg = bit(b, x);
+            if (fg != current) {
+                putVarint(out.bytes, run);
+                run = 0;
+                current = fg;
+            }
+            const uint8_t same = fg ? 0xff : 0x00;
+            int end = x + 1;
+            while (end < cols) {
+                if ((end & 7) == 0 && end + 8 <= cols && b[end >> 3] == same)
+                    end += 8;
+                else if (bit(b, end) == fg)
+                    ++end;
+                else
+                    break;
+            }
+            if (fg) {
+                foreground += end - x;
+                x0 = std::min(x0, x);
+                x1 = std::max(x1, end - 1);
+                y0 = std::min(y0, y);
+                y1 = y;
+            }
+            run += end - x;
+            x = end;
+        }
+    }
+    putVarint(out.bytes, run);
+    out.codec = MASK_RLE;
+    out.foreground = foreground;
+    out.bbox = x1 < 0 ? cv::Rect() : cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+// Replace the run-length code by the packed rows when they are smaller
+// (noisy masks: runs cost more than one bit per pixel)
+void preferBits(const cv::Mat &bits, EncodedMask &out) {
+    const size_t rowBytes = static_cast<size_t>(bits.cols);
+    if (out.bytes.size() <= rowBytes * bits.rows)
+        return;
+    out.bytes.resize(rowBytes * bits.rows);
+    for (int y = 0; y < bits.rows; ++y)
+        std::memcpy(out.bytes.data() + rowBytes * y, bits.ptr<uint8_t>(y), rowBytes);
+    out.codec = MASK_BITS;
+}
+
+void compressFrame(EncodedMask &out) {
+#ifdef HAVE_ZSTD
+    std::vector<uint8_t> packed(ZSTD_compressBound(out.bytes.size()));
+    const size_t n = ZSTD_compress(packed.data(), packed.size(), out.bytes.data(), out.bytes.size(), 1);
+    if (!ZSTD_isError(n) && n < out.bytes.size()) {
+        packed.resize(n);
+        out.bytes.swap(packed);
+        out.codec |= MASK_ZSTD;
+    }
+#else
+    (void)out;
+#endif
+}
+
+void decodeRuns(const uint8_t *p, const uint8_t *end, cv::Mat &mask) {
+    bool fg = false;
+    int x = 0, y = 0;
+    while (p < end) {
+        uint64_t run = getVarint(p, end);
+        while (run > 0) {
+            if (y >= mask.rows)
+                throw std::runtime_error("Mask stream frame has too many pixels");
+            const int n = static_cast<int>(std::min<uint64_t>(run, mask.cols - x));
+            std::memset(mask.ptr<uchar>(y) + x, fg ? 255 : 0, n);
+            run -= n;
+            x += n;
+            if (x == mask.cols) { x = 0; ++y; }
+        }
+        fg = !fg;
+    }
+    if (y != mask.rows)
+        throw std::runtime_error("Mask stream frame has too few pixels");
+}
+
+void decodeBits(const uint8_t *p, size_t bytes, cv::Mat &mask) {
+    const int rowBytes = packedRowBytes(mask.cols);
+    if (bytes != static_cast<size_t>(rowBytes) * mask.rows)
+        throw std::runtime_error("Bit-packed mask has the wrong size");
+    for (int y = 0; y < mask.rows; ++y) {
+        const uint8_t *b = p + static_cast<size_t>(rowBytes) * y;
+        uchar *m = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; ++x)
+            m[x] = (b[x >> 3] >> (x & 7)) & 1 ? 255 : 0;
+    }
+}
+
+void seekTo(std::FILE *f, uint64_t offset) {
+#ifdef _WIN32
+    bool ok = _fseeki64(f, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    bool ok = fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    if (!ok)
+        throw std::runtime_error("Cannot seek in mask stream");
+}
+
+} // namespace
+
+void encodeMask(const cv::Mat &mask, EncodedMask &out) {
+    if (mask.type() != CV_8U)
+        throw std::invalid_argument("Mask streams hold CV_8U masks");
+    encodeRuns(mask, out);
+    if (out.bytes.size() > static_cast<size_t>(packedRowBytes(mask.cols)) * mask.rows) {
+        // Pack with the threshold kernel: against a zero background every
+        // non-zero pixel is above threshold 0
+        thread_local cv::Mat zeros, bits;
+        if (zeros.size() != mask.size())
+            zeros = cv::Mat::zeros(mask.size(), CV_8U);
+        thresholdDiffPacked(mask, zeros, 0.0, bits);
+        preferBits(bits, out);
+    }
+    compressFrame(out);
+}
+
+void encodePackedMask(const cv::Mat &bits, int cols, EncodedMask &out) {
+    if (bits.type() != CV_8U || bits.cols != packedRowBytes(cols))
+        throw std::invalid_argument("Packed masks hold packedRowBytes(cols) bytes per row");
+    encodePackedRuns(bits, cols, out);
+    preferBits(bits, out);
+    compressFrame(out);
+}
+
+bool isMaskStreamPath(const std::string &path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".msk";
+}
+
+MaskStreamWriter::MaskStreamWriter(const std::string &path, cv::Size size, double fps)
+    : path_(path), header_{} {
+    if (size.width <= 0 || size.height <= 0)
+        throw std::invalid_argument("Mask stream needs a non-empty frame size");
+    std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+    header_.version = VERSION;
+    header_.width = static_cast<uint32_t>(size.width);
+    header_.height = static_cast<uint32_t>(size.height);
+    header_.fps = fps;
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_ || std::fwrite(&header_, sizeof(header_), 1, file_) != 1) {
+        if (file_) std::fclose(file_);
+        file_ = nullptr;
+        throw std::runtime_error("Cannot open writer: " + path);
+    }
+    offset_ = sizeof(header_);
+}
+
+MaskStreamWriter::~MaskStreamWriter() {
+    try {
+        close();
+    } catch (...) {
+        // Left without an index; readers reject it
+    }
+}
+
+void MaskStreamWriter::write(const cv::Mat &mask) {
+    if (mask.cols != static_cast<int>(header_.width) || mask.rows != static_cast<int>(header_.height))
+        throw std::invalid_argument("Mask size does not match the stream: " + path_);
+    EncodedMask frame;
+    encodeMask(mask, frame);
+    write(frame);
+}
+
+void MaskStreamWriter::write(const EncodedMask &frame) {
+    if (!file_)
+        throw std::logic_error("Mask stream already closed: " + path_);
+    if (!frame.bytes.empty() && std::fwrite(frame.bytes.data(), frame.bytes.size(), 1, file_) != 1)
+        throw std::runtime_error("Cannot write mask stream: " + path_);
+    MaskIndexEntry e{};
+    e.offset = offset_;
+    e.bytes = static_cast<uint32_t>(frame.bytes.size());
+    e.codec = frame.codec;
+    e.foreground = frame.foreground;
+    e.x = frame.bbox.x;
+    e.y = frame.bbox.y;
+    e.width = frame.bbox.width;
+    e.height = frame.bbox.height;
+    index_.push_back(e);
+    offset_ += frame.bytes.size();
+}
+
+void MaskStreamWriter::close() {
+    if (!file_)
+        return;
+    std::FILE *f = file_;
+    file_ = nullptr;
+    header_.frames = static_cast<uint32_t>(index_.size());
+    header_.indexOffset = offset_;
+    bool ok = index_.empty() || std::fwrite(index_.data(), sizeof(MaskIndexEntry), index_.size(), f) == index_.size();
+    if (ok) {
+        seekTo(f, 0);
+        ok = std::fwrite(&header_, sizeof(header_), 1, f) == 1;
+    }
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error("Cannot finalize mask stream: " + path_);
+}
+
+MaskStreamReader::MaskStreamReader(const std::string &path) : path_(path), header_{} {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_)
+        throw std::runtime_error("Cannot open mask stream: " + path);
+    try {
+        if (std::fread(&header_, sizeof(header_), 1, file_) != 1 ||
+            std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) != 0 || header_.version != VERSION)
+            throw std::runtime_error("Not a mask stream: " + path);
+        if (header_.indexOffset == 0)
+            throw std::runtime_error("Incomplete mask stream (writer not closed): " + path);
+        index_.resize(header_.frames);
+        seekTo(file_, header_.indexOffset);
+        if (!index_.empty() && std::fread(index_.data(), sizeof(MaskIndexEntry), index_.size(), file_) != index_.size())
+            throw std::runtime_error("Truncated mask stream index: " + path);
+    } catch (...) {
+        std::fclose(file_);
+        throw;
+    }
+}
+
+MaskStreamReader::~MaskStreamReader() {
+    std::fclose(file_);
+}
+
+void MaskStreamReader::raw(int i, EncodedMask &frame) const {
+    const MaskIndexEntry &e = index_.at(i);
+    frame.bytes.resize(e.bytes);
+    seekTo(file_, e.offset);
+    if (e.bytes > 0 && std::fread(frame.bytes.data(), e.bytes, 1, file_) != 1)
+        throw std::runtime_error("Truncated mask stream: " + path_);
+    frame.codec = e.codec;
+    frame.foreground = e.foreground;
+    frame.bbox = cv::Rect(e.x, e.y, e.width, e.height);
+}
+
+void MaskStreamReader::read(int i, cv::Mat &mask) const {
+    EncodedMask frame;
+    raw(i, frame);
+    const uint8_t *p = frame.bytes.data();
+    size_t bytes = frame.bytes.size();
+    std::vector<uint8_t> unpacked;
+    if (frame.codec & MASK_ZSTD) {
+#ifdef HAVE_ZSTD
+        const unsigned long long n = ZSTD_getFrameContentSize(p, bytes);
+        if (n == ZSTD_CONTENTSIZE_ERROR || n == ZSTD_CONTENTSIZE_UNKNOWN)
+            throw std::runtime_error("Corrupt zstd frame in mask stream: " + path_);
+        unpacked.resize(n);
+        if (ZSTD_isError(ZSTD_decompress(unpacked.data(), unpacked.size(), p, bytes)))
+            throw std::runtime_error("Corrupt zstd frame in mask stream: " + path_);
+        p = unpacked.data();
+        bytes = unpacked.size();
+#else
+        throw std::runtime_error("Mask stream is zstd-compressed; rebuild with ZSTD=1: " + path_);
+#endif
+    }
+    mask.create(size(), CV_8U);
+    if ((frame.codec & ~MASK_ZSTD) == MASK_BITS)
+        decodeBits(p, bytes, mask);
+    else
+        decodeRuns(p, p + bytes, mask);
+}
+
+void concatMaskStreams(const std::vector<std::string> &segments, const std::string &out) {
+    if (segments.empty())
+        throw std::invalid_argument("No mask stream segments to join");
+    std::unique_ptr<MaskStreamWriter> writer;
+    EncodedMask frame;
+    for (const auto &seg : segments) {
+        MaskStreamReader reader(seg);
+        if (!writer)
+            writer = std::make_unique<MaskStreamWriter>(out, reader.size(), reader.fps());
+        // Encoded frames are copied as they are
+        for (int i = 0; i < reader.frames(); ++i) {
+            reader.raw(i, frame);
+            writer->write(frame);
+        }
+    }
+    writer->close();
+}
+
+MaskWriter::MaskWriter(const std::string &path, double fps, cv::Size size) {
+    const FrameRegion &region = frameRegion();
+    if (region.active() && size == region.workSize()) {
+        region_ = &region;
+        size = region.frameSize();
+    }
+    if (isMaskStreamPath(path)) {
+        stream_ = std::make_unique<MaskStreamWriter>(path, size, fps);
+        return;
+    }
+    video_.open(path, cv::VideoWriter::fourcc('m','p','4','v'), fps, size, false);
+    if (!video_.isOpened())
+        throw std::runtime_error("Cannot open writer: " + path);
+}
+
+const cv::Mat &MaskWriter::frameMask(const cv::Mat &mask, cv::Mat &scratch) const {
+    if (!region_)
+        return mask;
+    Profiler::Scope scope("unpack");
+    region_->unpack(mask, scratch);
+    return scratch;
+}
+
+void MaskWriter::write(const cv::Mat &mask) {
+    const cv::Mat &full = frameMask(mask, full_);
+    Profiler::Scope scope("encode");
+    if (stream_)
+        stream_->write(full);
+    else
+        video_.write(full);
+}
+
+void MaskWriter::write(const EncodedMask &frame) {
+    if (!stream_)
+        throw std::logic_error("Pre-encoded masks need a mask stream");
+    Profiler::Scope scope("mask_write");
+    stream_->write(frame);
+}
+
+void MaskWriter::release() {
+    if (stream_)
+        stream_->close();
+    else
+        video_.release();
+}
@@ -0,0 +1,148 @@
+#ifndef MASK_STREAM_H
+#define MASK_STREAM_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FrameRegion;
+
+// Lossless foreground mask stream, an alternative to the mp4v mask video.
+//
+// Every frame is encoded on its own, so frames can be encoded in parallel
+// and read back in any order: a 64-byte header, the encoded frames back to
+// back, then an index with one MaskIndexEntry per frame. A frame is the
+// smaller of a run-length code (alternating background/foreground run
+// lengths in row-major order, as LEB128 varints, starting with background)
+// and the bit-packed layout of thresholdDiffPacked. Builds with HAVE_ZSTD
+// additionally zstd-compress a frame when that makes it smaller.
+//
+// Masks are binary: any non-zero pixel is foreground and reads back as 255.
+struct MaskStreamHeader {
+    char magic[8];              // "BGMASK1"
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t frames;
+    double fps;
+    uint64_t indexOffset;       // 0 until the writer was closed
+    uint8_t reserved[24];
+};
+static_assert(sizeof(MaskStreamHeader) == 64, "mask stream header must stay 64 bytes");
+
+// Codec bits of MaskIndexEntry::codec
+enum MaskCodec : uint32_t {
+    MASK_RLE = 0,
+    MASK_BITS = 1,
+    MASK_ZSTD = 0x10            // payload is zstd-compressed on top
+};
+
+// Per-frame record of the index: where the frame is and what it holds
+struct MaskIndexEntry {
+    uint64_t offset;            // from the start of the file
+    uint32_t bytes;
+    uint32_t codec;
+    int32_t foreground;         // set pixels
+    int32_t x, y, width, height; // bounding box of the set pixels (all 0 if none)
+    uint32_t reserved;
+};
+static_assert(sizeof(MaskIndexEntry) == 40, "mask index entries must stay 40 bytes");
+
+// One encoded frame and its metadata
+struct EncodedMask {
+    std::vector<uint8_t> bytes;
+    uint32_t codec = MASK_RLE;
+    int foreground = 0;
+    cv::Rect bbox;
+};
+
+// Encode a CV_8U mask. Thread-safe: frames are independent.
+void encodeMask(const cv::Mat &mask, EncodedMask &out);
+// Encode a mask of `cols` pixels per row already bit-packed by
+// thresholdDiffPacked; its bits are stored as they are when they beat the
+// run-length code. Thread-safe.
+void encodePackedMask(const cv::Mat &bits, int cols, EncodedMask &out);
+
+// True for paths written as mask streams (extension ".msk")
+bool isMaskStreamPath(const std::string &path);
+
+// Appends frames to a new mask stream. close() (or the destructor) writes
+// the index; a stream that was never closed is rejected by the reader.
+class MaskStreamWriter {
+public:
+    MaskStreamWriter(const std::string &path, cv::Size size, double fps);
+    ~MaskStreamWriter();
+    MaskStreamWriter(const MaskStreamWriter &) = delete;
+    MaskStreamWriter &operator=(const MaskStreamWriter &) = delete;
+
+    void write(const cv::Mat &mask);
+    void write(const EncodedMask &frame);
+    void close();
+
+private:
+    std::string path_;
+    MaskStreamHeader header_;
+    std::vector<MaskIndexEntry> index_;
+    std::FILE *file_ = nullptr;
+    uint64_t offset_ = 0;
+};
+
+// Random access to a closed mask stream
+class MaskStreamReader {
+public:
+    // Throws std::runtime_error if the file is missing, unclosed or truncated
+    explicit MaskStreamReader(const std::string &path);
+    ~MaskStreamReader();
+    MaskStreamReader(const MaskStreamReader &) = delete;
+    MaskStreamReader &operator=(const MaskStreamReader &) = delete;
+
+    int frames() const { return static_cast<int>(index_.size()); }
+    cv::Size size() const { return cv::Size(header_.width, header_.height); }
+    double fps() const { return header_.fps; }
+    const MaskIndexEntry &info(int i) const { return index_.at(i); }
+
+    // Frame i as a 0/255 CV_8U mask
+    void read(int i, cv::Mat &mask) const;
+    // Frame i exactly as stored (for copying it into another stream)
+    void raw(int i, EncodedMask &frame) const;
+
+private:
+    std::string path_;
+    MaskStreamHeader header_;
+    std::vector<MaskIndexEntry> index_;
+    std::FILE *file_ = nullptr;
+};
+
+// Join mask stream segments (in frame order) into one stream without
+// decoding them
+void concatMaskStreams(const std::vector<std::string> &segments, const std::string &out);
+
+// Destination of foreground masks: an mp4v video, or a mask stream when the
+// path ends in ".msk". Throws std::runtime_error if it cannot be opened.
+// Masks of the active frame region's work size are unpacked to full frames.
+class MaskWriter {
+public:
+    MaskWriter(const std::string &path, double fps, cv::Size size);
+
+    bool isStream() const { return stream_ != nullptr; }
+    // True if masks are of the frame region's work size and get unpacked
+    bool unpacksRegion() const { return region_ != nullptr; }
+    // The full-frame mask that will be written for `mask` (mask itself, or
+    // unpacked into scratch). Thread-safe; for encoding frames elsewhere.
+    const cv::Mat &frameMask(const cv::Mat &mask, cv::Mat &scratch) const;
+    // Encode then write, timed as "encode"
+    void write(const cv::Mat &mask);
+    // Mask streams only: a frame already encoded with encodeMask()
+    void write(const EncodedMask &frame);
+    void release();
+
+private:
+    cv::VideoWriter video_;
+    std::unique_ptr<MaskStreamWriter> stream_;
+    const FrameRegion *region_ = nullptr;
+    cv::Mat full_;
+};
+
+#endif // MASK_STREAM_H
@@ -0,0 +1,132 @@
+#include "MixtureBackground.h"
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+MixtureBackground::MixtureBackground(int rows, int cols, const MixtureParams &params)
+    : params_(params) {
+    if (params_.components < 1 || params_.components > MAX_COMPONENTS)
+        throw std::invalid_argument("Mixture needs 1.." + std::to_string(MAX_COMPONENTS) + " components");
+    for (int k = 0; k < params_.components; ++k) {
+        weight_.push_back(cv::Mat::zeros(rows, cols, CV_32F));
+        mean_.push_back(cv::Mat::zeros(rows, cols, CV_32F));
+        var_.push_back(cv::Mat(rows, cols, CV_32F, cv::Scalar(params_.initialVar)));
+    }
+}
+
+void MixtureBackground::apply(const cv::Mat &gray, cv::Mat &mask, int *count) {
+    if (gray.type() != CV_8UC1 || gray.size() != weight_[0].size())
+        throw std::invalid_argument("MixtureBackground expects a CV_8UC1 frame of the configured size");
+    mask.create(gray.size(), CV_8U);
+
+    if (frames_++ == 0) {
+        // Seed: one component per pixel centred on the first frame
+        weight_[0].setTo(1.0f);
+        gray.convertTo(mean_[0], CV_32F);
+        mask.setTo(0);
+        if (count) *count = 0;
+        return;
+    }
+
+    int fg = 0;
+    switch (params_.components) {
+    case 1: fg = applyRows<1>(gray, mask); break;
+    case 2: fg = applyRows<2>(gray, mask); break;
+    case 3: fg = applyRows<3>(gray, mask); break;
+    case 4: fg = applyRows<4>(gray, mask); break;
+    default: fg = applyRows<5>(gray, mask); break;
+    }
+    if (count) *count = fg;
+}
+
+// K is a compile-time constant so the per-component loops unroll and the
+// planes of one row stay in registers/L1 while x advances. Rows are split into
+// static blocks (tiles) across the OpenMP team; tiles share no state.
+template <int K>
+int MixtureBackground::applyRows(const cv::Mat &gray, cv::Mat &mask) {
+    const float alpha = params_.learningRate;
+    const float keep = 1.0f - alpha;
+    const float varThr = params_.varThreshold;
+    const float bgRatio = params_.backgroundRatio;
+    const float minVar = params_.minVar;
+    const float initialVar = params_.initialVar;
+    int fg = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:fg)
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *g = gray.ptr<uchar>(y);
+        uchar *out = mask.ptr<uchar>(y);
+        float *w[K], *mu[K], *var[K];
+        for (int k = 0; k < K; ++k) {
+            w[k] = weight_[k].ptr<float>(y);
+            mu[k] = mean_[k].ptr<float>(y);
+            var[k] = var_[k].ptr<float>(y);
+        }
+
+        // Branch-free per pixel: matches, replacement and the decision are
+        // 0/1 factors and selects, so the x loop can be vectorized (the trip
+        // count is hoisted so the stores cannot alias it)
+        const int cols = gray.cols;
+        for (int x = 0; x < cols; ++x) {
+            const float v = g[x];
+            float hit[K];
+            float matchedAny = 0.0f, wm = 0.0f;
+            // First matching component wins; weights decay toward 0 or 1
+            for (int k = 0; k < K; ++k) {
+                const float d = v - mu[k][x];
+                const float d2 = d * d;
+                const float vk = var[k][x];
+                hit[k] = (d2 < varThr * vk) ? 1.0f - matchedAny : 0.0f;
+                matchedAny += hit[k];
+                const float wk = keep * w[k][x] + alpha * hit[k];
+                w[k][x] = wk;
+                wm += hit[k] * wk;
+                const float rho = hit[k] * std::min(alpha / std::max(wk, FLT_MIN), 1.0f);
+                mu[k][x] += rho * d;
+                var[k][x] = hit[k] > 0.0f ? std::max(vk + rho * (d2 - vk), minVar) : vk;
+            }
+
+            // No match: the weakest component (the first of equals) is
+            // replaced by the sample and the weights renormalized
+            const float miss = 1.0f - matchedAny;
+            float weakestW = w[0][x];
+            for (int k = 1; k < K; ++k)
+                weakestW = std::min(weakestW, w[k][x]);
+            float replaced = 0.0f, total = 0.0f;
+            for (int k = 0; k < K; ++k) {
+                const float r = (w[k][x] == weakestW) ? miss * (1.0f - replaced) : 0.0f;
+                replaced += r;
+                w[k][x] = r > 0.0f ? alpha : w[k][x];
+                mu[k][x] = r > 0.0f ? v : mu[k][x];
+                var[k][x] = r > 0.0f ? initialVar : var[k][x];
+                total += w[k][x];
+            }
+            const float norm = miss > 0.0f ? total : 1.0f;
+            for (int k = 0; k < K; ++k)
+                w[k][x] /= norm;
+
+            // Background if the heavier components do not already cover bgRatio
+            float heavier = 0.0f;
+            for (int k = 0; k < K; ++k)
+                heavier += (w[k][x] > wm) ? w[k][x] : 0.0f;
+            const int isFg = (miss > 0.0f) | (heavier >= bgRatio);
+            out[x] = static_cast<uchar>(-isFg);
+            fg += isFg;
+        }
+    }
+    return fg;
+}
+
+void MixtureBackground::background(cv::Mat &out) const {
+    const int rows = weight_[0].rows, cols = weight_[0].cols;
+    out.create(rows, cols, CV_8U);
+    for (int y = 0; y < rows; ++y) {
+        uchar *o = out.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x) {
+            int best = 0;
+            for (int k = 1; k < params_.components; ++k)
+                if (weight_[k].ptr<float>(y)[x] > weight_[best].ptr<float>(y)[x]) best = k;
+            o[x] = cv::saturate_cast<uchar>(mean_[best].ptr<float>(y)[x]);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef MIXTURE_BACKGROUND_H
+#define MIXTURE_BACKGROUND_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Tunables of the Gaussian-mixture model (defaults follow OpenCV's MOG2)
+struct MixtureParams {
+    int components = 3;             // Gaussians per pixel, 1..MixtureBackground::MAX_COMPONENTS
+    float learningRate = 0.005f;    // weight update rate per frame
+    float varThreshold = 16.0f;     // a sample matches if d^2 < varThreshold * var (4 sigma)
+    float backgroundRatio = 0.9f;   // heaviest components covering this weight are background
+    float initialVar = 225.0f;      // variance of a new component (sigma 15)
+    float minVar = 4.0f;            // variance floor
+};
+
+// Per-pixel Gaussian mixture (Stauffer-Grimson style) over 8-bit grayscale.
+//
+// State is stored structure-of-arrays: one CV_32F plane per component for the
+// weights, means and variances, so the update streams through contiguous rows.
+// Rows are independent, so an OpenMP team splits each frame into row tiles,
+// and MPI ranks can each own one model for a band of rows.
+class MixtureBackground {
+public:
+    static constexpr int MAX_COMPONENTS = 5;
+
+    MixtureBackground(int rows, int cols, const MixtureParams &params = MixtureParams());
+
+    // Classify one CV_8U frame into a 0/255 mask (optionally counting set
+    // pixels), then fold it into the model. The first frame seeds the model
+    // and is all background.
+    void apply(const cv::Mat &gray, cv::Mat &mask, int *count = nullptr);
+    // Mean of each pixel's heaviest component, rounded to CV_8U
+    void background(cv::Mat &out) const;
+    int frames() const { return frames_; }
+
+private:
+    template <int K>
+    int applyRows(const cv::Mat &gray, cv::Mat &mask);
+
+    MixtureParams params_;
+    std::vector<cv::Mat> weight_, mean_, var_;   // one plane per component
+    int frames_ = 0;
+};
+
+#endif // MIXTURE_BACKGROUND_H
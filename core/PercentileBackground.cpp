@@ -0,0 +1,139 @@
+#include "PercentileBackground.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+// 8-bit staged counts can take this many frames before they must be flushed
+constexpr int MAX_STAGED_FRAMES = 255;
+
+void checkFrame(const cv::Mat &gray, const cv::Mat &staged) {
+    if (gray.type() != CV_8UC1 || gray.rows > staged.rows ||
+        gray.cols * PixelHistogram::BINS != staged.cols)
+        throw std::invalid_argument("Histogram expects a CV_8UC1 frame of the configured size");
+}
+
+} // namespace
+
+PixelHistogram::PixelHistogram(int rows, int cols)
+    : staged_(cv::Mat::zeros(rows, cols * BINS, CV_8U)),
+      totals_(cv::Mat::zeros(rows, cols * BINS, CV_32S)) {}
+
+void PixelHistogram::addCoarse(const cv::Mat &gray) {
+    checkFrame(gray, staged_);
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *g = gray.ptr<uchar>(y);
+        uchar *s = staged_.ptr<uchar>(y);
+        for (int x = 0; x < gray.cols; ++x)
+            ++s[x * BINS + (g[x] >> 4)];
+    }
+    frameDone();
+}
+
+void PixelHistogram::addFine(const cv::Mat &gray, const cv::Mat &coarse) {
+    checkFrame(gray, staged_);
+    if (coarse.type() != CV_8UC1 || coarse.rows < gray.rows || coarse.cols != gray.cols)
+        throw std::invalid_argument("Fine histogram pass expects one CV_8UC1 coarse bin per pixel");
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *g = gray.ptr<uchar>(y);
+        const uchar *c = coarse.ptr<uchar>(y);
+        uchar *s = staged_.ptr<uchar>(y);
+        // Branch-free: samples outside the selected coarse bin add zero
+        for (int x = 0; x < gray.cols; ++x)
+            s[x * BINS + (g[x] & 15)] += static_cast<uchar>((g[x] >> 4) == c[x]);
+    }
+    frameDone();
+}
+
+cv::Mat &PixelHistogram::totals() {
+    if (pending_ > 0) {
+#pragma omp parallel for schedule(static)
+        for (int y = 0; y < totals_.rows; ++y) {
+            const uchar *s = staged_.ptr<uchar>(y);
+            uint32_t *t = reinterpret_cast<uint32_t *>(totals_.ptr<int>(y));
+            for (int i = 0; i < totals_.cols; ++i)
+                t[i] += s[i];
+        }
+        staged_.setTo(0);
+        pending_ = 0;
+    }
+    return totals_;
+}
+
+void PixelHistogram::reset() {
+    staged_.setTo(0);
+    totals_.setTo(0);
+    pending_ = 0;
+}
+
+void PixelHistogram::frameDone() {
+    if (++pending_ == MAX_STAGED_FRAMES)
+        totals();
+}
+
+int percentileRank(double percentile, int n) {
+    if (n <= 0)
+        return 0;
+    double p = std::min(std::max(percentile, 0.0), 100.0);
+    return static_cast<int>(std::floor(p * (n - 1) / 100.0));
+}
+
+void selectHistogramBin(const cv::Mat &totals, cv::Mat &rank, cv::Mat &bin) {
+    const int bins = PixelHistogram::BINS;
+    const int cols = totals.cols / bins;
+    if (totals.type() != CV_32S || rank.type() != CV_32S ||
+        rank.rows != totals.rows || rank.cols != cols)
+        throw std::invalid_argument("selectHistogramBin expects CV_32S totals and one CV_32S rank per pixel");
+    bin.create(totals.rows, cols, CV_8U);
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < totals.rows; ++y) {
+        const uint32_t *t = reinterpret_cast<const uint32_t *>(totals.ptr<int>(y));
+        int *r = rank.ptr<int>(y);
+        uchar *b = bin.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x, t += bins) {
+            uint32_t remaining = static_cast<uint32_t>(r[x]);
+            int k = 0;
+            // Stop on the last bin: only reached by padding rows with no samples
+            while (k < bins - 1 && remaining >= t[k])
+                remaining -= t[k++];
+            b[x] = static_cast<uchar>(k);
+            r[x] = static_cast<int>(remaining);
+        }
+    }
+}
+
+ApproxPercentile::ApproxPercentile(int rows, int cols, double percentile)
+    : estimate_(cv::Mat::zeros(rows, cols, CV_16U)) {
+    // Steps in 1/256 gray levels; up + down = 2 levels, median = +-1
+    double p = std::min(std::max(percentile, 0.0), 100.0);
+    up_ = static_cast<int>(std::lround(512.0 * p / 100.0));
+    down_ = 512 - up_;
+}
+
+void ApproxPercentile::update(const cv::Mat &gray) {
+    if (gray.type() != CV_8UC1 || gray.size() != estimate_.size())
+        throw std::invalid_argument("ApproxPercentile expects a CV_8UC1 frame of the configured size");
+    if (frames_++ == 0) {
+        gray.convertTo(estimate_, CV_16U, 256.0);
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *g = gray.ptr<uchar>(y);
+        ushort *e = estimate_.ptr<ushort>(y);
+        for (int x = 0; x < gray.cols; ++x) {
+            int v = g[x] << 8, cur = e[x];
+            // Step toward the sample without overshooting it
+            int next = v > cur ? std::min(cur + up_, v) : std::max(cur - down_, v);
+            e[x] = static_cast<ushort>(next);
+        }
+    }
+}
+
+void ApproxPercentile::background(cv::Mat &out) const {
+    estimate_.convertTo(out, CV_8U, 1.0 / 256.0);
+}
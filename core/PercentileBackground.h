@@ -0,0 +1,66 @@
+#ifndef PERCENTILE_BACKGROUND_H
+#define PERCENTILE_BACKGROUND_H
+
+#include <opencv2/opencv.hpp>
+
+// Exact per-pixel percentile of 8-bit frames in two passes with bounded memory.
+//
+// Pass 1 counts the high nibble of every sample (16 bins per pixel), which
+// pins the percentile to one coarse bin per pixel; pass 2 counts the low
+// nibble of the samples that fall in that bin. The 16 bins of a pixel are
+// contiguous, so every update touches a single cache line. Counts are staged
+// in 8 bits and folded into uint32 totals (CV_32S) every 255 frames. Totals
+// from different frame ranges simply add up, so they merge with MPI_SUM.
+// Rows are updated in parallel when built with OpenMP.
+class PixelHistogram {
+public:
+    static constexpr int BINS = 16;
+
+    // rows may exceed the frame height (e.g. padded to whole MPI bands)
+    PixelHistogram(int rows, int cols);
+
+    // Pass 1: count gray >> 4
+    void addCoarse(const cv::Mat &gray);
+    // Pass 2: count gray & 15 where gray >> 4 == coarse (CV_8U, one bin per pixel)
+    void addFine(const cv::Mat &gray, const cv::Mat &coarse);
+    // Flushed totals, rows x (cols * BINS), uint32 stored as CV_32S
+    cv::Mat &totals();
+    // Clear all counts (pass 2 reuses the pass 1 buffers)
+    void reset();
+
+private:
+    void frameDone();
+
+    cv::Mat staged_;     // CV_8U, same layout as totals_
+    cv::Mat totals_;
+    int pending_ = 0;
+};
+
+// 0-based rank of percentile p (0..100) among n samples (lower nearest rank)
+int percentileRank(double percentile, int n);
+
+// For every pixel of `totals` (rows x cols*BINS), find the bin holding the
+// rank-th smallest sample; `rank` (CV_32S) becomes the rank inside that bin
+// and `bin` (CV_8U) receives the bin index.
+void selectHistogramBin(const cv::Mat &totals, cv::Mat &rank, cv::Mat &bin);
+
+// Single-pass streaming percentile estimate that needs no memory beyond the
+// estimate itself: every frame nudges each pixel up by 2p/100 or down by
+// 2(1 - p/100) gray levels toward the sample, so it settles where a fraction
+// p/100 of the samples lie below it. The first frame seeds the estimate.
+class ApproxPercentile {
+public:
+    ApproxPercentile(int rows, int cols, double percentile);
+
+    void update(const cv::Mat &gray);
+    // Current estimate rounded to CV_8U
+    void background(cv::Mat &out) const;
+    int frames() const { return frames_; }
+
+private:
+    cv::Mat estimate_;   // CV_16U, 8.8 fixed point
+    int up_, down_;
+    int frames_ = 0;
+};
+
+#endif // PERCENTILE_BACKGROUND_H
@@ -0,0 +1,175 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace Profiler {
+
+namespace {
+
+struct Event {
+    const char *stage;
+    int64_t start, end;
+};
+
+struct StageTotal {
+    const char *stage;
+    int64_t calls = 0, ns = 0;
+};
+
+struct Counter {
+    const char *name;
+    int64_t value = 0;
+};
+
+// One thread's records. Stages and counters are few, so a linear search by
+// pointer beats a map on the hot path.
+struct ThreadLog {
+    int thread = 0;
+    std::vector<StageTotal> stages;
+    std::vector<Counter> counters;
+    std::vector<Event> events;
+};
+
+bool keepEvents = false;
+int64_t epochNs = 0;
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadLog>> registry;
+
+int64_t clockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadLog &threadLog() {
+    thread_local ThreadLog *log = nullptr;
+    if (!log) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadLog>());
+        log = registry.back().get();
+        log->thread = static_cast<int>(registry.size()) - 1;
+    }
+    return *log;
+}
+
+} // namespace
+
+namespace detail {
+
+bool active = false;
+
+int64_t nowNs() { return clockNs() - epochNs; }
+
+void record(const char *stage, int64_t startNs, int64_t endNs) {
+    ThreadLog &log = threadLog();
+    StageTotal *total = nullptr;
+    for (auto &s : log.stages)
+        if (s.stage == stage) { total = &s; break; }
+    if (!total) {
+        log.stages.push_back({stage});
+        total = &log.stages.back();
+    }
+    ++total->calls;
+    total->ns += endNs - startNs;
+    if (keepEvents)
+        log.events.push_back({stage, startNs, endNs});
+}
+
+void add(const char *counter, int64_t n) {
+    ThreadLog &log = threadLog();
+    for (auto &c : log.counters)
+        if (c.name == counter) { c.value += n; return; }
+    log.counters.push_back({counter, n});
+}
+
+} // namespace detail
+
+void enable(bool events) {
+    keepEvents = events;
+    epochNs = clockNs();
+    detail::active = true;
+}
+
+std::string summaryJson(int rank) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ostringstream out;
+    out << "{\"rank\":" << rank << ",\"wall_seconds\":" << detail::nowNs() * 1e-9 << ",\"threads\":[";
+    for (size_t t = 0; t < registry.size(); ++t) {
+        const ThreadLog &log = *registry[t];
+        // The same name may arrive through different literal pointers
+        std::map<std::string, std::pair<int64_t, int64_t>> stages;
+        for (const auto &s : log.stages) {
+            auto &agg = stages[s.stage];
+            agg.first += s.calls;
+            agg.second += s.ns;
+        }
+        std::map<std::string, int64_t> counters;
+        for (const auto &c : log.counters)
+            counters[c.name] += c.value;
+
+        out << (t ? "," : "") << "{\"thread\":" << log.thread << ",\"stages\":{";
+        bool first = true;
+        for (const auto &[name, agg] : stages) {
+            out << (first ? "" : ",") << "\"" << name << "\":{\"calls\":" << agg.first
+                << ",\"seconds\":" << agg.second * 1e-9 << "}";
+            first = false;
+        }
+        out << "},\"counters\":{";
+        first = true;
+        for (const auto &[name, value] : counters) {
+            out << (first ? "" : ",") << "\"" << name << "\":" << value;
+            first = false;
+        }
+        out << "}}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+std::string traceEventsJson(int rank) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed;
+    bool first = true;
+    for (const auto &log : registry) {
+        for (const Event &e : log->events) {
+            out << (first ? "" : ",\n") << "{\"name\":\"" << e.stage << "\",\"ph\":\"X\",\"pid\":" << rank
+                << ",\"tid\":" << log->thread << ",\"ts\":" << e.start * 1e-3
+                << ",\"dur\":" << (e.end - e.start) * 1e-3 << "}";
+            first = false;
+        }
+    }
+    return out.str();
+}
+
+void writeSummary(const std::vector<std::string> &rankSummaries, const std::string &path) {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Cannot write profile: " + path);
+    out << "{\"ranks\":[\n";
+    for (size_t r = 0; r < rankSummaries.size(); ++r)
+        out << (r ? ",\n" : "") << rankSummaries[r];
+    out << "\n]}\n";
+}
+
+void writeChromeTrace(const std::vector<std::string> &rankEvents, const std::string &path) {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Cannot write trace: " + path);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &events : rankEvents) {
+        if (events.empty()) continue;
+        out << (first ? "" : ",\n") << events;
+        first = false;
+    }
+    out << "\n]}\n";
+}
+
+} // namespace Profiler
@@ -0,0 +1,67 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-stage timers and counters for every backend.
+//
+// Disabled by default: a Scope or count() then costs a single branch on a
+// flag. Once enabled, each thread records into its own log, so the hot path
+// takes no locks; logs are only merged when a summary is requested. Stage
+// and counter names must be string literals (they are kept by pointer).
+namespace Profiler {
+
+namespace detail {
+extern bool active;
+int64_t nowNs();
+void record(const char *stage, int64_t startNs, int64_t endNs);
+void add(const char *counter, int64_t n);
+} // namespace detail
+
+// Start recording. With keepEvents every interval is kept for the timeline;
+// otherwise only per-stage totals are. Call before any worker threads start.
+void enable(bool keepEvents);
+
+inline bool enabled() { return detail::active; }
+
+// Times the enclosing block under `stage`
+class Scope {
+public:
+    explicit Scope(const char *stage)
+        : stage_(detail::active ? stage : nullptr), start_(stage_ ? detail::nowNs() : 0) {}
+    ~Scope() {
+        if (stage_) detail::record(stage_, start_, detail::nowNs());
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *stage_;
+    int64_t start_;
+};
+
+// Adds n to a per-thread counter (frames, seeks, bytes_reduced, ...)
+inline void count(const char *counter, int64_t n = 1) {
+    if (detail::active) detail::add(counter, n);
+}
+
+// This process's totals as one JSON object:
+// {"rank":R,"wall_seconds":W,"threads":[{"thread":T,"stages":{"decode":
+// {"calls":N,"seconds":S},...},"counters":{"frames":N,...}},...]}
+std::string summaryJson(int rank);
+
+// This process's intervals as comma-separated Chrome trace "X" events
+// (pid = rank, tid = thread); empty unless enabled with keepEvents
+std::string traceEventsJson(int rank);
+
+// Write per-rank summaries as {"ranks":[...]} / per-rank events as a Chrome
+// trace ({"traceEvents":[...]}, loadable in chrome://tracing or Perfetto).
+// Throw std::runtime_error if the file cannot be written.
+void writeSummary(const std::vector<std::string> &rankSummaries, const std::string &path);
+void writeChromeTrace(const std::vector<std::string> &rankEvents, const std::string &path);
+
+} // namespace Profiler
+
+#endif // PROFILER_H
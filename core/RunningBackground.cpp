@@ -0,0 +1,48 @@
+#include "RunningBackground.h"
+#include "FrameKernels.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <stdexcept>
+
+RunningBackground::RunningBackground(int rows, int cols, double alpha, int warmup)
+    : model_(cv::Mat::zeros(rows, cols, CV_32F)), alpha_(alpha), warmup_(std::max(warmup, 1)) {
+    if (!(alpha >= 0.0 && alpha <= 1.0))
+        throw std::invalid_argument("Learning rate alpha must be in [0, 1]");
+    if (warmup < 0)
+        throw std::invalid_argument("Warm-up frame count must not be negative");
+}
+
+void RunningBackground::update(const cv::Mat &gray) {
+    // Cumulative mean: weight 1/n for the n-th frame (the first frame seeds the model)
+    double rate = 1.0 / (frames_ + 1);
+    if (alpha_ > 0.0 && warmedUp())
+        rate = alpha_;
+    cv::accumulateWeighted(gray, model_, rate);
+    ++frames_;
+}
+
+void RunningBackground::apply(const cv::Mat &gray, double threshold, cv::Mat &mask, int *count) {
+    if (!warmedUp()) {
+        Profiler::Scope scope("model");
+        update(gray);
+        foreground(gray, threshold, mask, count);
+        return;
+    }
+    {
+        Profiler::Scope scope("threshold");
+        foreground(gray, threshold, mask, count);
+    }
+    Profiler::Scope scope("model");
+    update(gray);
+}
+
+void RunningBackground::background(cv::Mat &out) const {
+    model_.convertTo(out, CV_8U);
+}
+
+void RunningBackground::foreground(const cv::Mat &gray, double threshold, cv::Mat &mask,
+                                   int *count) const {
+    cv::Mat bg;
+    background(bg);
+    thresholdDiff(gray, bg, threshold, mask, count);
+}
@@ -0,0 +1,39 @@
+#ifndef RUNNING_BACKGROUND_H
+#define RUNNING_BACKGROUND_H
+
+#include <opencv2/opencv.hpp>
+
+// Single-pass background model updated one grayscale frame at a time.
+//
+// The first frame seeds the model. For the first `warmup` frames (at least
+// one), and for every frame when alpha is 0, the model is the cumulative mean
+// of the frames seen so far; after that it is an exponentially weighted mean
+// with learning rate alpha.
+class RunningBackground {
+public:
+    // Throws std::invalid_argument unless 0 <= alpha <= 1 and warmup >= 0
+    RunningBackground(int rows, int cols, double alpha, int warmup);
+
+    // Fold one CV_8U grayscale frame into the model
+    void update(const cv::Mat &gray);
+    // Threshold one frame and fold it into the model. Once warmed up the mask
+    // is taken against the model before the frame is added; during warm-up
+    // the frame is added first, so the seed frame is not all foreground.
+    void apply(const cv::Mat &gray, double threshold, cv::Mat &mask, int *count = nullptr);
+    // Current estimate rounded to CV_8U
+    void background(cv::Mat &out) const;
+    // Threshold |gray - background| into a 0/255 mask, optionally counting set pixels
+    void foreground(const cv::Mat &gray, double threshold, cv::Mat &mask,
+                    int *count = nullptr) const;
+
+    bool warmedUp() const { return frames_ >= warmup_; }
+    int frames() const { return frames_; }
+
+private:
+    cv::Mat model_;      // CV_32F per-pixel estimate
+    double alpha_;
+    int warmup_;
+    int frames_ = 0;
+};
+
+#endif // RUNNING_BACKGROUND_H
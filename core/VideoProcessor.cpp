@@ -0,0 +1,1281 @@
+#include "VideoProcessor.h"
+#include "FrameKernels.h"
+#include "RunningBackground.h"
+#include "PercentileBackground.h"
+#include "ForegroundPipeline.h"
+#include "MixtureBackground.h"
+#include "LumaCache.h"
+#include "FrameSource.h"
+#include "FrameRegion.h"
+#include "FrameStream.h"
+#include "FrameSampler.h"
+#include "MaskStream.h"
+#include "Profiler.h"
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+namespace {
+
+// Size of the OpenMP team a parallel region would get (1 without OpenMP)
+int teamSize() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Row chunks per frame: a few per thread so dynamic scheduling can balance
+int rowChunks(int rows) {
+    return std::max(1, std::min(rows, 4 * teamSize()));
+}
+
+#ifdef _WIN32
+// One argument quoted for the Windows command line parser
+std::string quoteArgument(const std::string &arg) {
+    std::string out = "\"";
+    size_t slashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            ++slashes;
+            continue;
+        }
+        // Backslashes are literal unless they precede a quote
+        out.append(c == '"' ? 2 * slashes + 1 : slashes, '\\');
+        slashes = 0;
+        out.push_back(c);
+    }
+    out.append(2 * slashes, '\\');
+    return out + "\"";
+}
+#endif
+
+// Run a program found on the PATH with the given arguments (no shell
+// involved) and wait for it. Returns its exit code, or -1 if it could not be
+// started or did not exit normally.
+int runProgram(const std::vector<std::string> &args) {
+#ifdef _WIN32
+    std::vector<std::string> quoted;
+    for (const auto &a : args)
+        quoted.push_back(quoteArgument(a));
+    std::vector<const char *> argv;
+    for (const auto &a : quoted)
+        argv.push_back(a.c_str());
+    argv.push_back(nullptr);
+    return static_cast<int>(_spawnvp(_P_WAIT, args[0].c_str(), argv.data()));
+#else
+    std::vector<char *> argv;
+    for (const auto &a : args)
+        argv.push_back(const_cast<char *>(a.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        return -1;
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+            return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// Path quoted for an ffmpeg concat list: 'it'\''s' for it's
+std::string concatListEntry(const std::string &path) {
+    std::string out = "'";
+    for (char c : path)
+        out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return out + "'";
+}
+
+// Adds frames into a per-pixel sum: BGR frames, or the decoder's luma plane
+// as FrameSource delivers it. A uint32 (CV_32S) sum is updated in place; a
+// CV_64F sum goes through a uint32 scratch accumulator that is folded in at
+// the end, or earlier if it could overflow. Rows of one frame may be
+// added concurrently from several threads (addRows), since each thread only
+// touches its own rows of the single shared accumulator.
+class FrameAccumulator {
+public:
+    explicit FrameAccumulator(cv::Mat &sum) : sum_(sum) {
+        if (sum.type() != CV_32S)
+            scratch_ = cv::Mat::zeros(sum.size(), CV_32S);
+    }
+
+    // Add rows [begin, end) of one frame
+    void addRows(const cv::Mat &frame, int begin, int end) {
+        Profiler::Scope scope("accumulate");
+        cv::Mat acc = (scratch_.empty() ? sum_ : scratch_).rowRange(begin, end);
+        if (frame.channels() == 1)
+            accumulateGray(frame.rowRange(begin, end), acc);
+        else
+            // Gray conversion is fused into the accumulate kernel
+            accumulateGrayBGR(frame.rowRange(begin, end), acc);
+    }
+
+    // Add grayRows as rows [begin, end) of one frame
+    void addGrayRows(const cv::Mat &grayRows, int begin, int end) {
+        Profiler::Scope scope("accumulate");
+        cv::Mat acc = (scratch_.empty() ? sum_ : scratch_).rowRange(begin, end);
+        accumulateGray(grayRows, acc);
+    }
+
+    // Call once per frame after all of its rows were added
+    void frameDone() {
+        if (!scratch_.empty() && ++pending_ == MAX_U32_ACCUMULATED_FRAMES) {
+            Profiler::Scope scope("accumulate");
+            flushAccumulator(scratch_, sum_);
+            pending_ = 0;
+        }
+    }
+
+    // Add a whole frame, rows split across the OpenMP team
+    void add(const cv::Mat &frame) {
+        const int rows = sum_.rows;
+        const int chunks = rowChunks(rows);
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < chunks; ++c)
+            addRows(frame, rows * c / chunks, rows * (c + 1) / chunks);
+        frameDone();
+    }
+
+    void finish() {
+        Profiler::Scope scope("accumulate");
+        if (!scratch_.empty())
+            flushAccumulator(scratch_, sum_);
+        pending_ = 0;
+    }
+
+private:
+    cv::Mat &sum_;
+    cv::Mat scratch_;
+    int pending_ = 0;
+};
+
+// Decode a block of frames with one frame of read-ahead. For each frame the
+// OpenMP team runs chunkFn(frame, rowBegin, rowEnd, chunk) over row chunks
+// while one thread of the team decodes the next frame into the spare buffer,
+// then frameFn(frame) runs on the calling thread. Without OpenMP this is a
+// plain decode-then-process loop. The source must sit on range.begin. With
+// endOk the block ends quietly where the stream does (the frame count is an
+// estimate); otherwise a missing frame throws.
+template <typename ChunkFn, typename FrameFn>
+DecodeStats decodeOverlapped(FrameSource &src, const FrameRange &range,
+                             ChunkFn chunkFn, FrameFn frameFn, bool endOk = false) {
+    DecodeStats stats;
+    cv::Mat buf[2];
+    if (!src.read(buf[0])) {
+        if (endOk)
+            return stats;
+        throw std::runtime_error("Empty frame #" + std::to_string(range.begin));
+    }
+    ++stats.framesDecoded;
+    const int rows = src.size().height;
+    const int chunks = rowChunks(rows);
+
+    for (int i = range.begin; i < range.end; ++i) {
+        const cv::Mat &cur = buf[(i - range.begin) & 1];
+        cv::Mat &next = buf[(i - range.begin + 1) & 1];
+        const bool wantNext = i + 1 < range.end;
+        bool gotNext = false;
+        std::exception_ptr error;
+#pragma omp parallel
+        {
+#pragma omp single nowait
+            if (wantNext)
+                gotNext = src.read(next);
+#pragma omp for schedule(dynamic)
+            for (int c = 0; c < chunks; ++c) {
+                try {
+                    chunkFn(cur, rows * c / chunks, rows * (c + 1) / chunks, c);
+                } catch (...) {
+#pragma omp critical
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        frameFn(cur);
+        if (wantNext) {
+            if (!gotNext && endOk)
+                break;
+            if (!gotNext)
+                throw std::runtime_error("Empty frame #" + std::to_string(i + 1));
+            ++stats.framesDecoded;
+        }
+    }
+    return stats;
+}
+
+// Decode a block of frames (one seek, then sequential reads) and hand each
+// grayscale frame to fn. Like thresholdFrames, stops where the stream ends;
+// stats.framesDecoded is the number of frames fn saw.
+template <typename Fn>
+DecodeStats forEachGrayFrame(const std::string &path, const FrameRange &range, Fn fn) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+
+    FrameSource src(path);
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++stats.seeks;
+    }
+
+    cv::Mat frame, gray;
+    for (int i = range.begin; i < range.end && src.read(frame); ++i) {
+        ++stats.framesDecoded;
+        fn(src.luma(frame, gray));
+    }
+    src.release();
+    return stats;
+}
+
+// Threshold frames [range) of a source sitting on range.begin against meanBg
+// into an open writer. Stops early, without an error, if the stream ends
+// before range.end (CAP_PROP_FRAME_COUNT can overestimate).
+DecodeStats thresholdFrames(FrameSource &src, MaskWriter &writer, const cv::Mat &meanBg,
+                            const FrameRange &range, double threshold, std::vector<int> *fgCounts) {
+    if (teamSize() >= 3) {
+        // Enough threads for separate stages: decode, threshold and encode
+        // overlap in the ordered pipeline
+        int workers = teamSize() - 2;
+        ForegroundPipeline pipeline(workers * SLOTS_PER_WORKER, meanBg, threshold, fgCounts);
+        DecodeStats stats;
+        stats.framesDecoded = pipeline.run(src, writer, teamSize(), range.count());
+        return stats;
+    }
+
+    // Each row chunk converts to grayscale and thresholds |gray - background|
+    // in place in the shared frame buffers, counting its foreground pixels
+    cv::Mat gray(meanBg.size(), CV_8U), mask(meanBg.size(), CV_8U);
+    std::vector<int> chunkFg(rowChunks(meanBg.rows), 0);
+    return decodeOverlapped(src, range,
+        [&](const cv::Mat &frame, int begin, int end, int c) {
+            cv::Mat grayRows = src.lumaRows(frame, begin, end, gray), maskRows = mask.rowRange(begin, end);
+            Profiler::Scope scope("threshold");
+            thresholdDiff(grayRows, meanBg.rowRange(begin, end), threshold, maskRows,
+                          fgCounts ? &chunkFg[c] : nullptr);
+        },
+        [&](const cv::Mat &) {
+            if (fgCounts) {
+                int fg = 0;
+                for (int n : chunkFg) fg += n;
+                fgCounts->push_back(fg);
+            }
+            writer.write(mask);
+        }, true);
+}
+
+// Coarse-to-fine foreground: every frame is thresholded in the frame
+// region's reduced work frame against the coarse background, and only tiles
+// with coarse motion are thresholded again at full resolution, against the
+// background scaled up. Masks are written at full resolution.
+DecodeStats refineForegroundSegment(const std::string &path, const cv::Mat &coarseBg,
+                                    const FrameRange &range, double fps, double threshold,
+                                    const std::string &segOut, std::vector<int> *fgCounts) {
+    DecodeStats stats;
+    const FrameRegion &region = frameRegion();
+    MaskWriter writer(segOut, fps, region.frameSize());
+    FrameSource src(path, true);
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++stats.seeks;
+    }
+    cv::Mat fullBg;
+    region.unpack(coarseBg, fullBg);
+    cv::Mat frame, grayBuf, coarse, coarseMask, mask;
+    // Like thresholdFrames, stop where the stream ends
+    for (int i = range.begin; i < range.end && src.read(frame); ++i) {
+        ++stats.framesDecoded;
+        const cv::Mat gray = src.luma(frame, grayBuf);
+        int fg = 0;
+        {
+            Profiler::Scope scope("threshold");
+            region.pack(gray, coarse);
+            thresholdDiff(coarse, coarseBg, threshold, coarseMask);
+        }
+        {
+            Profiler::Scope scope("refine");
+            region.refine(gray, fullBg, coarseMask, threshold, mask, fgCounts ? &fg : nullptr);
+        }
+        if (fgCounts) fgCounts->push_back(fg);
+        writer.write(mask);
+    }
+    src.release();
+    writer.release();
+    return stats;
+}
+
+} // namespace
+
+// Read video metadata (total frames, fps, width, height)
+VideoMeta readVideoMeta(const std::string &path) {
+    // Open the video file (throws if it cannot be opened)
+    FrameSource src(path);
+
+    VideoMeta m;
+    // Retrieve total number of frames
+    m.totalFrames = src.frameCount();
+    // Retrieve frames per second
+    m.fps         = src.fps();
+    // Retrieve frame width and height
+    m.width       = src.size().width;
+    m.height      = src.size().height;
+
+    // Release the capture object
+    src.release();
+    return m;
+}
+
+// List the indices of keyframes (GOP starts) in the video.
+// Uses the FFmpeg backend in raw mode, so packets are only demuxed, never decoded.
+// Returns an empty list when the backend cannot report keyframes.
+std::vector<int> scanKeyframes(const std::string &path) {
+    std::vector<int> keyframes;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+    cv::VideoCapture cap(path, cv::CAP_FFMPEG);
+    if (!cap.isOpened())
+        throw std::runtime_error("Cannot open video: " + path);
+    // CAP_PROP_FORMAT = -1 switches read() to raw encoded packets
+    if (!cap.set(cv::CAP_PROP_FORMAT, -1))
+        return keyframes;
+
+    cv::Mat packet;
+    for (int i = 0; cap.read(packet); ++i) {
+        if (cap.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0)
+            keyframes.push_back(i);
+    }
+    cap.release();
+#else
+    (void)path;
+#endif
+    return keyframes;
+}
+
+// Split [0, totalFrames) into one contiguous block per rank.
+// Block sizes follow the relative rank weights (equal when the list is empty),
+// and interior boundaries are snapped to the nearest keyframe when a keyframe
+// list is given, so every rank starts decoding on a GOP boundary.
+FrameRange partitionFrames(int totalFrames, int rank, int size,
+                           const std::vector<double> &weights,
+                           const std::vector<int> &keyframes) {
+    if (!weights.empty() && static_cast<int>(weights.size()) != size)
+        throw std::invalid_argument("Expected " + std::to_string(size) +
+                                    " rank weights, got " + std::to_string(weights.size()));
+
+    double totalWeight = 0.0;
+    for (int r = 0; r < size; ++r) {
+        const double w = weights.empty() ? 1.0 : weights[r];
+        if (!std::isfinite(w) || w < 0.0)
+            throw std::invalid_argument("Rank weight " + std::to_string(r) +
+                                        " must be finite and non-negative");
+        totalWeight += w;
+    }
+    if (!(totalWeight > 0.0))
+        throw std::invalid_argument("Rank weights must sum to a positive value");
+
+    // Start frame of rank r's block
+    auto boundary = [&](int r) -> int {
+        if (r <= 0)    return 0;
+        if (r >= size) return totalFrames;
+        double before = 0.0;
+        for (int k = 0; k < r; ++k)
+            before += weights.empty() ? 1.0 : weights[k];
+        int b = static_cast<int>(std::lround(totalFrames * before / totalWeight));
+        if (keyframes.empty())
+            return b;
+        // Snap to the closest keyframe (snapping is monotonic, so blocks never overlap)
+        auto it = std::lower_bound(keyframes.begin(), keyframes.end(), b);
+        int hi = (it == keyframes.end()) ? totalFrames : std::min(*it, totalFrames);
+        int lo = (it == keyframes.begin()) ? 0 : *(it - 1);
+        return (b - lo <= hi - b) ? lo : hi;
+    };
+
+    return FrameRange{boundary(rank), boundary(rank + 1)};
+}
+
+// Compute partial sum of grayscale frames for a given MPI rank (round-robin)
+DecodeStats computeLocalSum(const std::string &path, int rank, int size, cv::Mat &localSum) {
+    // Open the video file (throws if it cannot be opened)
+    FrameSource src(path);
+
+    DecodeStats stats;
+    cv::Mat frame;
+    FrameAccumulator acc(localSum);
+    // Get total frame count
+    int total = src.frameCount();
+    // Iterate over frames assigned to this rank
+    for (int i = rank; i < total; i += size) {
+        // Seek to the i-th frame
+        src.seek(i);
+        ++stats.seeks;
+        if (!src.read(frame))
+            // Error if frame is missing
+            throw std::runtime_error("Empty frame #" + std::to_string(i));
+        ++stats.framesDecoded;
+        // Convert to grayscale and accumulate pixel values in one pass
+        acc.add(frame);
+    }
+    acc.finish();
+    // Release capture when done
+    src.release();
+    return stats;
+}
+
+// Compute partial sum of grayscale frames over a contiguous block of frames.
+// Seeks at most once, then decodes sequentially to the end of the block.
+// With a cache writer, every frame's luma is also stored in the cache (and
+// every frame must exist, since the cache is sized for them).
+DecodeStats computeLocalSum(const std::string &path, const FrameRange &range, cv::Mat &localSum,
+                            LumaCacheWriter *cache, bool endOk) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+
+    FrameSource src(path);
+
+    // Position the decoder on the first frame of the block
+    int seeks = 0;
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++seeks;
+    }
+
+    // The team shares one decode buffer pair and the rank's single accumulator
+    FrameAccumulator acc(localSum);
+    if (cache) {
+        // Luma is materialized for the cache, so convert and add separately
+        cv::Mat gray(localSum.size(), CV_8U);
+        int index = range.begin;
+        stats = decodeOverlapped(src, range,
+            [&](const cv::Mat &frame, int begin, int end, int) {
+                acc.addGrayRows(src.lumaRows(frame, begin, end, gray), begin, end);
+            },
+            [&](const cv::Mat &frame) {
+                acc.frameDone();
+                Profiler::Scope scope("cache_write");
+                // BGR frames were converted into gray row by row
+                cache->write(index++, frame.channels() == 1 ? src.luma(frame, gray) : gray);
+            });
+    } else {
+        stats = decodeOverlapped(src, range,
+            [&](const cv::Mat &frame, int begin, int end, int) { acc.addRows(frame, begin, end); },
+            [&](const cv::Mat &) { acc.frameDone(); }, endOk);
+    }
+    stats.seeks = seeks;
+    acc.finish();
+    src.release();
+    return stats;
+}
+
+// Sampled sum of a block: every round decodes its frames in order with one
+// FrameSource, then the change of the block's estimate goes to agree(). A
+// block without frames yet reports no change, so it never holds up a stop.
+SampleStats sampleLocalSum(const std::string &path, const SamplePlan &plan, const FrameRange &range,
+                           cv::Mat &localSum, const std::function<double(double)> &agree) {
+    SampleStats stats;
+    FrameSource src(path);
+    FrameAccumulator acc(localSum);
+    cv::Mat frame, estimate;
+    int position = 0;   // of the frame the decoder reads next
+    for (int k = 0; k < plan.rounds(); ++k) {
+        for (int t : plan.round(k, range)) {
+            if (t < position || t - position > SAMPLE_GRAB_GAP) {
+                src.seek(t);
+                ++stats.decode.seeks;
+                position = t;
+            }
+            for (; position < t; ++position)
+                if (!src.grab())
+                    throw std::runtime_error("Empty frame #" + std::to_string(position));
+            if (!src.read(frame))
+                throw std::runtime_error("Empty frame #" + std::to_string(t));
+            ++position;
+            ++stats.decode.framesDecoded;
+            ++stats.frames;
+            acc.add(frame);
+        }
+        ++stats.rounds;
+        if (plan.rounds() == 1)
+            break;
+        acc.finish();
+        double change = 0.0;
+        if (stats.frames > 0) {
+            Profiler::Scope scope("converge");
+            change = estimateChange(localSum, stats.frames, estimate);
+        }
+        change = agree(change);
+        if (change < plan.tolerance()) {
+            stats.converged = k + 1 < plan.rounds();
+            break;
+        }
+    }
+    acc.finish();
+    src.release();
+    return stats;
+}
+
+// Partial sum of a block of cached luma frames. Each thread owns a band of
+// rows and walks it through every frame, so its accumulator rows stay in cache.
+void computeLocalSum(const LumaCache &cache, const FrameRange &range, cv::Mat &localSum) {
+    if (range.count() <= 0)
+        return;
+    if (range.begin < 0 || range.end > cache.frames())
+        throw std::out_of_range("Frame range exceeds the luma cache");
+    const int rows = localSum.rows;
+    const int chunks = rowChunks(rows);
+    std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < chunks; ++c) {
+        try {
+            const int begin = rows * c / chunks, end = rows * (c + 1) / chunks;
+            cv::Mat bandSum = localSum.rowRange(begin, end);
+            FrameAccumulator acc(bandSum);
+            for (int i = range.begin; i < range.end; ++i) {
+                acc.addGrayRows(cache.frame(i).rowRange(begin, end), 0, end - begin);
+                acc.frameDone();
+            }
+            acc.finish();
+        } catch (...) {
+#pragma omp critical
+            error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+    Profiler::count("cached_frames", range.count());
+}
+
+// One pass of the two-pass exact percentile over a block of frames
+DecodeStats accumulateHistogram(const std::string &path, const FrameRange &range,
+                                const cv::Mat &coarse, PixelHistogram &hist) {
+    if (coarse.empty())
+        return forEachGrayFrame(path, range, [&](const cv::Mat &gray) {
+            Profiler::Scope scope("model");
+            hist.addCoarse(gray);
+        });
+    return forEachGrayFrame(path, range, [&](const cv::Mat &gray) {
+        Profiler::Scope scope("model");
+        hist.addFine(gray, coarse);
+    });
+}
+
+// Single-pass approximate percentile of a block of frames
+DecodeStats approximatePercentile(const std::string &path, const FrameRange &range,
+                                  cv::Size frameSize, double percentile, cv::Mat &estimate) {
+    ApproxPercentile model(frameSize.height, frameSize.width, percentile);
+    DecodeStats stats = forEachGrayFrame(path, range, [&](const cv::Mat &gray) {
+        Profiler::Scope scope("model");
+        model.update(gray);
+    });
+    model.background(estimate);
+    return stats;
+}
+
+// Mean background (CV_8U) from a CV_64F sum or a uint32 (CV_32S) sum
+cv::Mat meanBackground(const cv::Mat &sum, int totalFrames) {
+    cv::Mat meanBg;
+    const double scale = 1.0 / totalFrames;
+    if (sum.type() != CV_32S) {
+        // Compute mean background by scaling the sum
+        sum.convertTo(meanBg, CV_8U, scale);
+        return meanBg;
+    }
+    // uint32 sums do not fit CV_32S arithmetic; round exactly like convertTo on doubles
+    meanBg.create(sum.rows, sum.cols, CV_8U);
+    for (int y = 0; y < sum.rows; ++y) {
+        const uint32_t *s = reinterpret_cast<const uint32_t *>(sum.ptr<int>(y));
+        uchar *m = meanBg.ptr<uchar>(y);
+        for (int x = 0; x < sum.cols; ++x)
+            m[x] = cv::saturate_cast<uchar>(static_cast<double>(s[x]) * scale);
+    }
+    return meanBg;
+}
+
+// Compute the mean background from the summed frames and write it to bgOut
+cv::Mat writeBackground(const cv::Mat &globalSum, int totalFrames, const std::string &bgOut) {
+    Profiler::Scope scope("write_background");
+    cv::Mat meanBg = meanBackground(globalSum, totalFrames);
+    // Write the background image to file
+    if (!writeFrameImage(bgOut, meanBg))
+        throw std::runtime_error("Cannot write background: " + bgOut);
+    return meanBg;
+}
+
+// Threshold a contiguous block of frames against meanBg and write the masks
+// as a standalone video segment. Seeks once, then decodes sequentially.
+// If fgCounts is given, the foreground pixel count of every frame is appended.
+DecodeStats generateForegroundSegment(const std::string &path,
+                                      const cv::Mat &meanBg,
+                                      const FrameRange &range,
+                                      double fps,
+                                      double threshold,
+                                      const std::string &segOut,
+                                      std::vector<int> *fgCounts) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+    if (frameRegion().scale() > 1)
+        return refineForegroundSegment(path, meanBg, range, fps, threshold, segOut, fgCounts);
+
+    // Foreground masks go to a single-channel video or a lossless mask stream
+    MaskWriter writer(segOut, fps, meanBg.size());
+
+    FrameSource src(path);
+    int seeks = 0;
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++seeks;
+    }
+
+    stats = thresholdFrames(src, writer, meanBg, range, threshold, fgCounts);
+    stats.seeks = seeks;
+    src.release();
+    writer.release();
+    return stats;
+}
+
+// Foreground masks of a block of cached luma frames; no decoding involved.
+// Row chunks of each frame are thresholded by the team, then the mask is encoded.
+void generateForegroundSegment(const LumaCache &cache,
+                               const cv::Mat &meanBg,
+                               const FrameRange &range,
+                               double fps,
+                               double threshold,
+                               const std::string &segOut,
+                               std::vector<int> *fgCounts) {
+    if (range.count() <= 0)
+        return;
+    if (range.begin < 0 || range.end > cache.frames())
+        throw std::out_of_range("Frame range exceeds the luma cache");
+    MaskWriter writer(segOut, fps, meanBg.size());
+
+    cv::Mat mask(meanBg.size(), CV_8U);
+    const int chunks = rowChunks(meanBg.rows);
+    std::vector<int> chunkFg(chunks, 0);
+    for (int i = range.begin; i < range.end; ++i) {
+        const cv::Mat gray = cache.frame(i);
+#pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < chunks; ++c) {
+            const int begin = meanBg.rows * c / chunks, end = meanBg.rows * (c + 1) / chunks;
+            cv::Mat maskRows = mask.rowRange(begin, end);
+            Profiler::Scope scope("threshold");
+            thresholdDiff(gray.rowRange(begin, end), meanBg.rowRange(begin, end), threshold, maskRows,
+                          fgCounts ? &chunkFg[c] : nullptr);
+        }
+        if (fgCounts) {
+            int fg = 0;
+            for (int n : chunkFg) fg += n;
+            fgCounts->push_back(fg);
+        }
+        writer.write(mask);
+    }
+    Profiler::count("cached_frames", range.count());
+    writer.release();
+}
+
+// Single pass over a block of frames: each frame is thresholded against the
+// running background and then folded into it, so masks are emitted as soon as
+// the warm-up window has been seen. Warm-up frames are held back (at most
+// `warmup` of them) and flushed against the warmed-up model. The final model
+// is returned in finalBg. Like thresholdFrames, the block ends where the
+// stream does; stats.framesDecoded holds the frames actually processed.
+DecodeStats streamForegroundSegment(const std::string &path,
+                                    const FrameRange &range,
+                                    double fps,
+                                    double threshold,
+                                    double alpha,
+                                    int warmup,
+                                    const std::string &segOut,
+                                    cv::Mat &finalBg,
+                                    std::vector<int> *fgCounts) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+
+    FrameSource src(path);
+    cv::Size frameSize = src.size();
+
+    MaskWriter writer(segOut, fps, frameSize);
+
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++stats.seeks;
+    }
+
+    RunningBackground model(frameSize.height, frameSize.width, alpha, warmup);
+    std::deque<cv::Mat> pending;   // warm-up frames awaiting their masks
+    cv::Mat frame, grayBuf, mask;
+    auto emit = [&](const cv::Mat &g) {
+        int fg = 0;
+        {
+            Profiler::Scope scope("threshold");
+            model.foreground(g, threshold, mask, fgCounts ? &fg : nullptr);
+        }
+        if (fgCounts) fgCounts->push_back(fg);
+        writer.write(mask);
+    };
+    for (int i = range.begin; i < range.end && src.read(frame); ++i) {
+        ++stats.framesDecoded;
+        const cv::Mat gray = src.luma(frame, grayBuf);
+
+        if (model.warmedUp()) {
+            int fg = 0;
+            model.apply(gray, threshold, mask, fgCounts ? &fg : nullptr);
+            if (fgCounts) fgCounts->push_back(fg);
+            writer.write(mask);
+            continue;
+        }
+
+        // Warm-up frames seed the model now and get their masks once it is seeded
+        {
+            Profiler::Scope scope("model");
+            model.update(gray);
+        }
+        pending.push_back(gray.clone());
+        if (model.warmedUp()) {
+            for (const auto &held : pending)
+                emit(held);
+            pending.clear();
+        }
+    }
+
+    // Block shorter than the warm-up window: flush against what we have
+    for (const auto &held : pending)
+        emit(held);
+
+    model.background(finalBg);
+    src.release();
+    writer.release();
+    return stats;
+}
+
+// Per-pixel Gaussian mixture over a block of frames: every frame is classified
+// against the mixture and then folded into it (rows split across the OpenMP
+// team inside the model).
+DecodeStats mixtureForegroundSegment(const std::string &path,
+                                     const FrameRange &range,
+                                     double fps,
+                                     const MixtureParams &params,
+                                     const std::string &segOut,
+                                     cv::Mat &finalBg,
+                                     double &modelSeconds,
+                                     std::vector<int> *fgCounts) {
+    modelSeconds = 0.0;
+    const cv::Size frameSize = FrameSource(path).size();
+
+    MaskWriter writer(segOut, fps, frameSize);
+
+    MixtureBackground model(frameSize.height, frameSize.width, params);
+    cv::Mat mask;
+    DecodeStats stats = forEachGrayFrame(path, range, [&](const cv::Mat &gray) {
+        int fg = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            Profiler::Scope scope("model");
+            model.apply(gray, mask, fgCounts ? &fg : nullptr);
+        }
+        modelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (fgCounts) fgCounts->push_back(fg);
+        writer.write(mask);
+    });
+    if (model.frames() > 0)
+        model.background(finalBg);
+    writer.release();
+    return stats;
+}
+
+// Stream input: no frame count, no seeking, and no frame kept beyond its own
+// turn, so only the single-pass models apply. Frames are processed straight
+// from the stream's buffers.
+void liveForegroundSegment(FrameStream &stream,
+                           double threshold,
+                           double alpha,
+                           int warmup,
+                           const MixtureParams *mixture,
+                           const std::string &segOut,
+                           cv::Mat &finalBg,
+                           std::vector<int> *fgCounts) {
+    const FrameRegion &region = frameRegion(stream.size());
+    const cv::Size frameSize = region.active() ? region.workSize() : stream.size();
+    MaskWriter writer(segOut, stream.fps(), frameSize);
+
+    RunningBackground running(frameSize.height, frameSize.width, alpha, warmup);
+    std::unique_ptr<MixtureBackground> mog;
+    if (mixture)
+        mog = std::make_unique<MixtureBackground>(frameSize.height, frameSize.width, *mixture);
+    StreamFrame frame;
+    cv::Mat grayBuf, work, mask;
+    int frames = 0;
+    while (stream.next(frame)) {
+        Profiler::count("frames");
+        cv::Mat gray = frame.image;
+        if (gray.channels() != 1) {
+            Profiler::Scope scope("convert");
+            cv::cvtColor(gray, grayBuf, cv::COLOR_BGR2GRAY);
+            gray = grayBuf;
+        }
+        if (region.active()) {
+            Profiler::Scope scope("pack");
+            region.pack(gray, work);
+            gray = work;
+        }
+
+        int fg = 0;
+        if (mog) {
+            Profiler::Scope scope("model");
+            mog->apply(gray, mask, fgCounts ? &fg : nullptr);
+        } else {
+            running.apply(gray, threshold, mask, fgCounts ? &fg : nullptr);
+        }
+        if (fgCounts) fgCounts->push_back(fg);
+        writer.write(mask);
+        stream.release(frame);
+        ++frames;
+    }
+
+    if (frames > 0) {
+        if (mog)
+            mog->background(finalBg);
+        else
+            running.background(finalBg);
+    }
+    writer.release();
+}
+
+// Segment of segmentFrames frames holding frame t (the last one may be shorter)
+FrameRange segmentOf(int t, int segmentFrames, int totalFrames) {
+    const int begin = t - t % segmentFrames;
+    return { begin, std::min(totalFrames, begin + segmentFrames) };
+}
+
+// Sliding-window mean background over a block of frames. The window sum of
+// frame t covers the `window` frames [t - (window-1)/2, t + window/2]
+// clipped to the video (an even window reaches one frame further ahead than
+// back); moving to t + 1 adds the frame entering the window and subtracts
+// the one leaving it, so a step costs one add and one subtract per pixel
+// whatever the window length. The leading source decodes each frame once,
+// priming the first window from frames outside the block (the halo). While
+// the window's gray frames fit WINDOW_RING_BYTES they stay in a ring that
+// also supplies the current and the leaving frame; wider windows run two
+// more sources (current frame, trailing edge) side by side with the leading
+// one instead, decoding every frame three times. The window is clipped to
+// the frames the stream really holds, which may be fewer than totalFrames.
+DecodeStats windowForegroundSegment(const std::string &path,
+                                    const FrameRange &range,
+                                    int totalFrames,
+                                    int window,
+                                    double fps,
+                                    double threshold,
+                                    const std::string &segOut,
+                                    cv::Mat *firstBg,
+                                    std::vector<int> *fgCounts) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+    if (window < 1 || window > MAX_U32_ACCUMULATED_FRAMES)
+        throw std::invalid_argument("Window must hold 1.." + std::to_string(MAX_U32_ACCUMULATED_FRAMES) + " frames");
+    const int before = (window - 1) / 2, after = window / 2;
+    int last = totalFrames - 1;   // last frame of the video, lowered if the stream ends early
+    auto lo = [&](int t) { return std::max(0, t - before); };
+    auto hi = [&](int t) { return std::min(last, t + after); };
+
+    FrameSource lead(path);
+    const cv::Size frameSize = lead.size();
+    MaskWriter writer(segOut, fps, frameSize);
+    // Frame i lives in ring slot i % (window + 1): the window plus the frame leaving it
+    const bool useRing = static_cast<double>(window + 1) * frameSize.area() <= WINDOW_RING_BYTES;
+    std::vector<cv::Mat> ring;
+    std::unique_ptr<FrameSource> cur, trail;
+    if (useRing) {
+        ring.resize(window + 1);
+        for (cv::Mat &slot : ring)
+            slot.create(frameSize, CV_8U);
+    } else {
+        cur = std::make_unique<FrameSource>(path);
+        trail = std::make_unique<FrameSource>(path);
+    }
+    auto slotOf = [&](int i) -> cv::Mat & { return ring[i % ring.size()]; };
+    auto seekTo = [&](FrameSource &src, int first) {
+        if (first > 0) {
+            src.seek(first);
+            ++stats.seeks;
+        }
+    };
+    seekTo(lead, lo(range.begin));
+    if (!useRing) {
+        seekTo(*cur, range.begin);
+        seekTo(*trail, lo(range.begin));
+    }
+
+    cv::Mat sum = cv::Mat::zeros(frameSize, CV_32S);
+    {
+        FrameAccumulator acc(sum);
+        cv::Mat frame;
+        for (int i = lo(range.begin); i <= hi(range.begin); ++i) {
+            if (!lead.read(frame)) {
+                last = i - 1;
+                break;
+            }
+            ++stats.framesDecoded;
+            if (useRing) {
+                cv::Mat &slot = slotOf(i);
+                const cv::Mat gray = lead.luma(frame, slot);
+                if (gray.data != slot.data)
+                    gray.copyTo(slot);
+                acc.add(slot);
+            } else {
+                acc.add(frame);
+            }
+        }
+    }
+
+    const int rows = frameSize.height;
+    const int chunks = rowChunks(rows);
+    std::vector<int> chunkFg(chunks, 0);
+    cv::Mat curFrame, enterFrame, leaveFrame;
+    cv::Mat curGray(frameSize, CV_8U), enterGray(frameSize, CV_8U), leaveGray(frameSize, CV_8U);
+    cv::Mat bg(frameSize, CV_8U), mask(frameSize, CV_8U);
+    for (int t = range.begin; t < range.end && t <= last; ++t) {
+        const int prevHi = t > range.begin ? hi(t - 1) : hi(t);
+        bool enters = t > range.begin && hi(t) > prevHi;
+        const bool leaves = t > range.begin && lo(t) > lo(t - 1);
+        bool gotCur = true, gotEnter = !enters, gotLeave = !leaves;
+        if (useRing) {
+            if (enters) gotEnter = lead.read(enterFrame);
+        } else {
+#pragma omp parallel sections
+            {
+#pragma omp section
+                gotCur = cur->read(curFrame);
+#pragma omp section
+                if (enters) gotEnter = lead.read(enterFrame);
+#pragma omp section
+                if (leaves) gotLeave = trail->read(leaveFrame);
+            }
+        }
+        if (!gotEnter) {
+            // The stream ends here: the window stops growing
+            last = prevHi;
+            enters = false;
+            if (t > last)
+                break;
+        }
+        if (!gotCur || !gotLeave)
+            throw std::runtime_error("Empty frame in the window of #" + std::to_string(t));
+        stats.framesDecoded += enters + (useRing ? 0 : 1 + leaves);
+
+        const int frames = hi(t) - lo(t) + 1;
+        std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < chunks; ++c) {
+            try {
+                const int begin = rows * c / chunks, end = rows * (c + 1) / chunks;
+                cv::Mat sumRows = sum.rowRange(begin, end), bgRows = bg.rowRange(begin, end);
+                cv::Mat maskRows = mask.rowRange(begin, end);
+                cv::Mat enterRows, leaveRows, grayRows;
+                if (useRing) {
+                    if (enters) {
+                        // Keep the entering frame's luma for the steps it stays in the window
+                        cv::Mat &slot = slotOf(hi(t));
+                        cv::Mat slotRows = slot.rowRange(begin, end);
+                        enterRows = lead.lumaRows(enterFrame, begin, end, slot);
+                        if (enterRows.data != slotRows.data)
+                            enterRows.copyTo(slotRows);
+                        enterRows = slotRows;
+                    }
+                    if (leaves)
+                        leaveRows = slotOf(lo(t - 1)).rowRange(begin, end);
+                    grayRows = slotOf(t).rowRange(begin, end);
+                } else {
+                    if (enters) enterRows = lead.lumaRows(enterFrame, begin, end, enterGray);
+                    if (leaves) leaveRows = trail->lumaRows(leaveFrame, begin, end, leaveGray);
+                    grayRows = cur->lumaRows(curFrame, begin, end, curGray);
+                }
+                Profiler::Scope scope("window");
+                slideWindow(enterRows, leaveRows, sumRows);
+                windowMean(sumRows, frames, bgRows);
+                thresholdDiff(grayRows, bgRows, threshold, maskRows, fgCounts ? &chunkFg[c] : nullptr);
+            } catch (...) {
+#pragma omp critical
+                error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        if (firstBg && t == range.begin)
+            bg.copyTo(*firstBg);
+        if (fgCounts) {
+            int fg = 0;
+            for (int n : chunkFg) fg += n;
+            fgCounts->push_back(fg);
+        }
+        writer.write(mask);
+    }
+    Profiler::count("window_frames", stats.framesDecoded);
+    writer.release();
+    return stats;
+}
+
+// Per-segment mean background over a block of frames: each frame is
+// thresholded against the mean of its own segment. A segment's frames are
+// summed, then decoded again for the masks, so every frame is read twice.
+// firstSum / lastSum (CV_64F), when given, are the complete sums of the
+// segments holding range.begin and range.end - 1; a caller that owns only
+// part of those segments passes them in rather than decoding the rest.
+DecodeStats segmentedForegroundSegment(const std::string &path,
+                                       const FrameRange &range,
+                                       int totalFrames,
+                                       int segmentFrames,
+                                       double fps,
+                                       double threshold,
+                                       const std::string &segOut,
+                                       const cv::Mat &firstSum,
+                                       const cv::Mat &lastSum,
+                                       cv::Mat *firstBg,
+                                       std::vector<int> *fgCounts) {
+    DecodeStats stats;
+    if (range.count() <= 0)
+        return stats;
+    if (segmentFrames < 1)
+        throw std::invalid_argument("Segments must hold at least one frame");
+
+    FrameSource src(path);
+    MaskWriter writer(segOut, fps, src.size());
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++stats.seeks;
+    }
+    for (int t = range.begin; t < range.end;) {
+        const FrameRange segment = segmentOf(t, segmentFrames, totalFrames);
+        const FrameRange own{ t, std::min(segment.end, range.end) };
+        cv::Mat sum;
+        if (own.begin == range.begin && !firstSum.empty()) {
+            sum = firstSum;
+        } else if (own.end == range.end && !lastSum.empty()) {
+            sum = lastSum;
+        } else {
+            sum = cv::Mat::zeros(src.size(), CV_64F);
+            Profiler::Scope scope("segment_sum");
+            DecodeStats summed = computeLocalSum(path, segment, sum);
+            stats.framesDecoded += summed.framesDecoded;
+            stats.seeks += summed.seeks;
+        }
+        const cv::Mat bg = meanBackground(sum, segment.count());
+        if (firstBg && own.begin == range.begin)
+            *firstBg = bg;
+        stats.framesDecoded += thresholdFrames(src, writer, bg, own, threshold, fgCounts).framesDecoded;
+        t = own.end;
+    }
+    src.release();
+    writer.release();
+    return stats;
+}
+
+// Threshold sweep over a block of frames: every frame is decoded once and
+// compared against each background. Each row chunk builds one |gray - bg|
+// histogram per background, and the foreground counts of all thresholds
+// follow from it, so the cost hardly grows with the number of thresholds.
+// Masks, if requested, are the only per-threshold work.
+DecodeStats sweepForegroundSegment(const std::string &path,
+                                   const std::vector<cv::Mat> &backgrounds,
+                                   const FrameRange &range,
+                                   double fps,
+                                   const std::vector<double> &thresholds,
+                                   std::vector<int> &counts,
+                                   const std::vector<std::string> &maskOuts) {
+    DecodeStats stats;
+    if (range.count() <= 0 || backgrounds.empty() || thresholds.empty())
+        return stats;
+    const size_t models = backgrounds.size(), pairs = models * thresholds.size();
+    if (!maskOuts.empty() && maskOuts.size() != pairs)
+        throw std::invalid_argument("Sweep needs one mask output per background and threshold");
+    const cv::Size frameSize = backgrounds[0].size();
+    for (const auto &bg : backgrounds)
+        if (bg.size() != frameSize)
+            throw std::invalid_argument("Sweep backgrounds differ in size");
+
+    std::vector<std::unique_ptr<MaskWriter>> writers;
+    std::vector<cv::Mat> masks(maskOuts.size());
+    for (size_t k = 0; k < maskOuts.size(); ++k) {
+        writers.push_back(std::make_unique<MaskWriter>(maskOuts[k], fps, frameSize));
+        masks[k].create(frameSize, CV_8U);
+    }
+
+    FrameSource src(path);
+    int seeks = 0;
+    if (range.begin > 0) {
+        src.seek(range.begin);
+        ++seeks;
+    }
+
+    // 256 bins per row chunk and background, summed once the frame is done
+    const int chunks = rowChunks(frameSize.height);
+    std::vector<uint32_t> hist(static_cast<size_t>(chunks) * models * 256);
+    uint32_t total[256];
+    std::vector<int> frameCounts(pairs);
+    cv::Mat gray(frameSize, CV_8U);
+    stats = decodeOverlapped(src, range,
+        [&](const cv::Mat &frame, int begin, int end, int c) {
+            cv::Mat grayRows = src.lumaRows(frame, begin, end, gray);
+            Profiler::Scope scope("sweep");
+            for (size_t b = 0; b < models; ++b) {
+                uint32_t *h = &hist[(c * models + b) * 256];
+                std::fill(h, h + 256, 0u);
+                const cv::Mat bgRows = backgrounds[b].rowRange(begin, end);
+                diffHistogram(grayRows, bgRows, h);
+                for (size_t t = 0; t < thresholds.size() && !masks.empty(); ++t) {
+                    cv::Mat maskRows = masks[b * thresholds.size() + t].rowRange(begin, end);
+                    thresholdDiff(grayRows, bgRows, thresholds[t], maskRows);
+                }
+            }
+        },
+        [&](const cv::Mat &) {
+            for (size_t b = 0; b < models; ++b) {
+                std::fill(total, total + 256, 0u);
+                for (int c = 0; c < chunks; ++c) {
+                    const uint32_t *h = &hist[(c * models + b) * 256];
+                    for (int v = 0; v < 256; ++v) total[v] += h[v];
+                }
+                foregroundCounts(total, thresholds, &frameCounts[b * thresholds.size()]);
+            }
+            counts.insert(counts.end(), frameCounts.begin(), frameCounts.end());
+            for (size_t k = 0; k < writers.size(); ++k)
+                writers[k]->write(masks[k]);
+        });
+    stats.seeks = seeks;
+    src.release();
+    for (auto &w : writers)
+        w->release();
+    return stats;
+}
+
+// "out/fg.mp4" + "mean_t30" → "out/fg_mean_t30.mp4"
+std::string taggedPath(const std::string &path, const std::string &tag) {
+    std::filesystem::path p(path);
+    return (p.parent_path() / (p.stem().string() + "_" + tag + p.extension().string())).string();
+}
+
+// Tag of one sweep pair: "mean_t30", "p25_t12.5"
+std::string sweepTag(const std::string &model, double threshold) {
+    std::ostringstream tag;
+    tag << model << "_t" << threshold;
+    return tag.str();
+}
+
+// Write sweep counts as CSV, one row per frame, model and threshold
+void writeSweepCsv(const std::vector<std::string> &models, const std::vector<double> &thresholds,
+                   const std::vector<int> &counts, const std::string &csvPath, int pixelsPerFrame) {
+    std::ofstream csv(csvPath);
+    if (!csv)
+        throw std::runtime_error("Cannot write sweep stats: " + csvPath);
+    const size_t pairs = models.size() * thresholds.size();
+    const double pixels = static_cast<double>(pixelsPerFrame);
+    csv << "frame,model,threshold,foreground_pixels,foreground_fraction\n";
+    for (size_t i = 0; pairs > 0 && i + pairs <= counts.size(); i += pairs)
+        for (size_t k = 0; k < pairs; ++k)
+            csv << i / pairs << "," << models[k / thresholds.size()] << "," << thresholds[k % thresholds.size()]
+                << "," << counts[i + k] << "," << counts[i + k] / pixels << "\n";
+}
+
+// Mean and peak foreground fraction of every sweep pair
+void printSweepSummary(const std::vector<std::string> &models, const std::vector<double> &thresholds,
+                       const std::vector<int> &counts, int pixelsPerFrame, std::ostream &out) {
+    const size_t pairs = models.size() * thresholds.size();
+    const size_t frames = pairs > 0 ? counts.size() / pairs : 0;
+    if (frames == 0)
+        return;
+    const double pixels = static_cast<double>(pixelsPerFrame);
+    out << "Sweep over " << frames << " frames (model, threshold: mean / peak foreground fraction)\n";
+    for (size_t k = 0; k < pairs; ++k) {
+        double sum = 0.0;
+        int peak = 0;
+        for (size_t f = 0; f < frames; ++f) {
+            sum += counts[f * pairs + k];
+            peak = std::max(peak, counts[f * pairs + k]);
+        }
+        out << "  " << models[k / thresholds.size()] << ", " << thresholds[k % thresholds.size()] << ": "
+            << sum / (frames * pixels) << " / " << peak / pixels << "\n";
+    }
+}
+
+// Write per-frame foreground pixel counts as CSV
+void writeMotionCsv(const std::vector<int> &counts, const std::string &csvPath, int pixelsPerFrame) {
+    std::ofstream csv(csvPath);
+    if (!csv)
+        throw std::runtime_error("Cannot write motion stats: " + csvPath);
+    const double pixels = static_cast<double>(pixelsPerFrame);
+    csv << "frame,foreground_pixels,foreground_fraction\n";
+    for (size_t i = 0; i < counts.size(); ++i)
+        csv << i << "," << counts[i] << "," << counts[i] / pixels << "\n";
+}
+
+// Join foreground segments (already in frame order) into one video.
+// Tries a stream-copy concat through ffmpeg first; if that is disabled or
+// fails, decodes each segment and re-encodes it into fgOut.
+void stitchSegments(const std::vector<std::string> &segments,
+                    const std::string &fgOut,
+                    double fps,
+                    cv::Size frameSize,
+                    bool allowConcat) {
+    Profiler::Scope scope("stitch");
+    if (isMaskStreamPath(fgOut)) {
+        // Frames are copied without decoding; there is nothing to re-encode
+        concatMaskStreams(segments, fgOut);
+        return;
+    }
+    if (allowConcat) {
+        // Concat demuxer list, one segment per line
+        std::string listPath = fgOut + ".segments.txt";
+        {
+            std::ofstream list(listPath);
+            for (const auto &seg : segments)
+                list << "file " << concatListEntry(std::filesystem::absolute(seg).string()) << "\n";
+        }
+        int rc = runProgram({"ffmpeg", "-y", "-loglevel", "error", "-f", "concat", "-safe", "0",
+                             "-i", listPath, "-c", "copy", fgOut});
+        std::filesystem::remove(listPath);
+        if (rc == 0)
+            return;
+    }
+
+    cv::VideoWriter writer(fgOut, cv::VideoWriter::fourcc('m','p','4','v'), fps, outputSize(frameSize), false);
+    if (!writer.isOpened())
+        throw std::runtime_error("Cannot open writer: " + fgOut);
+
+    cv::Mat frame, gray;
+    for (const auto &seg : segments) {
+        cv::VideoCapture cap(seg);
+        if (!cap.isOpened())
+            throw std::runtime_error("Cannot open segment: " + seg);
+        while (cap.read(frame)) {
+            // Decoders hand back BGR even for grayscale streams
+            if (frame.channels() == 3)
+                cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            else
+                gray = frame;
+            writer.write(gray);
+        }
+    }
+    writer.release();
+}
@@ -0,0 +1,206 @@
+#ifndef VIDEO_PROCESSOR_H
+#define VIDEO_PROCESSOR_H
+
+#include <opencv2/opencv.hpp>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class PixelHistogram;
+class LumaCache;
+class LumaCacheWriter;
+class FrameStream;
+class SamplePlan;
+struct MixtureParams;
+
+struct VideoMeta {
+    int totalFrames, width, height;
+    double fps;
+};
+
+// Half-open interval [begin, end) of frame indices owned by one rank
+struct FrameRange {
+    int begin, end;
+    int count() const { return end - begin; }
+};
+
+// Decode accounting for one rank's pass over the video
+struct DecodeStats {
+    int framesDecoded = 0;   // frames returned by cap.read()
+    int seeks = 0;           // explicit CAP_PROP_POS_FRAMES repositions
+};
+
+VideoMeta readVideoMeta(const std::string &path);
+std::vector<int> scanKeyframes(const std::string &path);
+FrameRange partitionFrames(int totalFrames,
+                           int rank, int size,
+                           const std::vector<double> &weights,
+                           const std::vector<int> &keyframes);
+// localSum is CV_64F, or CV_32S read as uint32 when the caller knows the
+// frame count stays within MAX_U32_ACCUMULATED_FRAMES
+DecodeStats computeLocalSum(const std::string &path,
+                            int rank, int size,
+                            cv::Mat &localSum);
+// With endOk (no cache) the block ends quietly where the stream does;
+// stats.framesDecoded is then the number of frames summed
+DecodeStats computeLocalSum(const std::string &path,
+                            const FrameRange &range,
+                            cv::Mat &localSum,
+                            LumaCacheWriter *cache = nullptr,
+                            bool endOk = false);
+// Outcome of a sampled sum
+struct SampleStats {
+    DecodeStats decode;
+    int frames = 0;          // frames summed
+    int rounds = 0;          // rounds run
+    bool converged = false;  // stopped early on the tolerance
+};
+// Sum of a sample of a block's frames (SamplePlan), round by round. Short
+// gaps between samples are skipped with grab(), long ones by seeking. After
+// every round, agree(change) gets the mean per-pixel change of the block's
+// mean estimate and returns the change to test against the plan's tolerance
+// (the local backend passes it through; MPI ranks agree on the maximum).
+SampleStats sampleLocalSum(const std::string &path,
+                           const SamplePlan &plan,
+                           const FrameRange &range,
+                           cv::Mat &localSum,
+                           const std::function<double(double)> &agree);
+// Same sum over frames already held in a luma cache (no decoding)
+void computeLocalSum(const LumaCache &cache,
+                     const FrameRange &range,
+                     cv::Mat &localSum);
+// Count a block of grayscale frames into hist: the coarse pass when `coarse`
+// is empty, otherwise the fine pass against the selected coarse bins
+DecodeStats accumulateHistogram(const std::string &path,
+                                const FrameRange &range,
+                                const cv::Mat &coarse,
+                                PixelHistogram &hist);
+// Streaming approximate percentile of a block of frames (CV_8U estimate)
+DecodeStats approximatePercentile(const std::string &path,
+                                  const FrameRange &range,
+                                  cv::Size frameSize,
+                                  double percentile,
+                                  cv::Mat &estimate);
+cv::Mat meanBackground(const cv::Mat &sum, int totalFrames);
+cv::Mat writeBackground(const cv::Mat &globalSum,
+                        int totalFrames,
+                        const std::string &bgOut);
+DecodeStats generateForegroundSegment(const std::string &path,
+                                      const cv::Mat &meanBg,
+                                      const FrameRange &range,
+                                      double fps,
+                                      double threshold,
+                                      const std::string &segOut,
+                                      std::vector<int> *fgCounts = nullptr);
+void generateForegroundSegment(const LumaCache &cache,
+                               const cv::Mat &meanBg,
+                               const FrameRange &range,
+                               double fps,
+                               double threshold,
+                               const std::string &segOut,
+                               std::vector<int> *fgCounts = nullptr);
+DecodeStats streamForegroundSegment(const std::string &path,
+                                    const FrameRange &range,
+                                    double fps,
+                                    double threshold,
+                                    double alpha,
+                                    int warmup,
+                                    const std::string &segOut,
+                                    cv::Mat &finalBg,
+                                    std::vector<int> *fgCounts = nullptr);
+// Gaussian-mixture foreground over a block of frames. The final model's
+// background is returned in finalBg and the time spent inside the model
+// (excluding decode and encode) in modelSeconds.
+DecodeStats mixtureForegroundSegment(const std::string &path,
+                                     const FrameRange &range,
+                                     double fps,
+                                     const MixtureParams &params,
+                                     const std::string &segOut,
+                                     cv::Mat &finalBg,
+                                     double &modelSeconds,
+                                     std::vector<int> *fgCounts = nullptr);
+// Foreground of a stream input with a single-pass model: the running
+// background (alpha, warmup), or the Gaussian mixture if mixture is given.
+// Frames are thresholded as they arrive (warm-up frames against the model
+// that already holds them instead of being held back) and handed back to the
+// stream once their mask is written. finalBg gets the last background (left
+// empty if the stream had no frames).
+void liveForegroundSegment(FrameStream &stream,
+                           double threshold,
+                           double alpha,
+                           int warmup,
+                           const MixtureParams *mixture,
+                           const std::string &segOut,
+                           cv::Mat &finalBg,
+                           std::vector<int> *fgCounts = nullptr);
+// Segment of segmentFrames frames holding frame t (segments start at
+// multiples of segmentFrames; the last one may be shorter)
+FrameRange segmentOf(int t, int segmentFrames, int totalFrames);
+// Gray frames a sliding window may keep in memory; a wider window decodes
+// every frame three times (current, leading and trailing edge) instead
+constexpr double WINDOW_RING_BYTES = 512.0 * 1024 * 1024;
+// Foreground against a sliding-window mean: frame t is compared with the mean
+// of the `window` frames [t - (window-1)/2, t + window/2] (clipped to the
+// video), updated incrementally. firstBg, if given, receives the background of range.begin.
+DecodeStats windowForegroundSegment(const std::string &path,
+                                    const FrameRange &range,
+                                    int totalFrames,
+                                    int window,
+                                    double fps,
+                                    double threshold,
+                                    const std::string &segOut,
+                                    cv::Mat *firstBg = nullptr,
+                                    std::vector<int> *fgCounts = nullptr);
+// Foreground against per-segment means. firstSum / lastSum are the full
+// CV_64F sums of the segments holding range.begin / range.end - 1 when the
+// caller has them (empty: summed here, decoding outside range if needed).
+DecodeStats segmentedForegroundSegment(const std::string &path,
+                                       const FrameRange &range,
+                                       int totalFrames,
+                                       int segmentFrames,
+                                       double fps,
+                                       double threshold,
+                                       const std::string &segOut,
+                                       const cv::Mat &firstSum = cv::Mat(),
+                                       const cv::Mat &lastSum = cv::Mat(),
+                                       cv::Mat *firstBg = nullptr,
+                                       std::vector<int> *fgCounts = nullptr);
+// Threshold sweep: decode a block of frames once and count the foreground
+// pixels of every frame against every background at every threshold.
+// counts gets backgrounds.size() * thresholds.size() values appended per
+// frame, background-major. If maskOuts is given (one path per pair, same
+// order), every pair's masks are written too.
+DecodeStats sweepForegroundSegment(const std::string &path,
+                                   const std::vector<cv::Mat> &backgrounds,
+                                   const FrameRange &range,
+                                   double fps,
+                                   const std::vector<double> &thresholds,
+                                   std::vector<int> &counts,
+                                   const std::vector<std::string> &maskOuts = {});
+// "dir/name.ext" → "dir/name_<tag>.ext"
+std::string taggedPath(const std::string &path, const std::string &tag);
+// Tag of one sweep pair, e.g. "mean_t30"
+std::string sweepTag(const std::string &model, double threshold);
+// Sweep counts as CSV (frame, model, threshold, pixels, fraction)
+void writeSweepCsv(const std::vector<std::string> &models,
+                   const std::vector<double> &thresholds,
+                   const std::vector<int> &counts,
+                   const std::string &csvPath,
+                   int pixelsPerFrame);
+void printSweepSummary(const std::vector<std::string> &models,
+                       const std::vector<double> &thresholds,
+                       const std::vector<int> &counts,
+                       int pixelsPerFrame,
+                       std::ostream &out);
+// Write per-frame foreground pixel counts as CSV (frame, pixels, fraction)
+void writeMotionCsv(const std::vector<int> &counts,
+                    const std::string &csvPath,
+                    int pixelsPerFrame);
+void stitchSegments(const std::vector<std::string> &segments,
+                    const std::string &fgOut,
+                    double fps,
+                    cv::Size frameSize,
+                    bool allowConcat);
+
+#endif // VIDEO_PROCESSOR_H